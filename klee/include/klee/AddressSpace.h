@@ -41,6 +41,10 @@ namespace klee {
     /// Epoch counter used to control ownership of objects.
     mutable unsigned cowKey;
 
+    /// Total size of the objects we own. Copying an address space
+    /// disowns all the objects of both spaces.
+    mutable uint64_t ownedBytes;
+
     /// Unsupported, use copy constructor
     AddressSpace &operator=(const AddressSpace&); 
     
@@ -68,9 +72,12 @@ namespace klee {
                                       bool *inBounds);
 
   public:
-    AddressSpace(ExecutionState* _state) : cowKey(1), state(_state) {}
+    AddressSpace(ExecutionState* _state)
+      : cowKey(1), ownedBytes(0), state(_state) {}
     AddressSpace(const AddressSpace &b) :
-            cowKey(++b.cowKey), objects(b.objects), state(NULL) { }
+            cowKey(++b.cowKey), ownedBytes(0), objects(b.objects), state(NULL) {
+      b.ownedBytes = 0;
+    }
     ~AddressSpace() {}
 
     /// Resolve address to an ObjectPair in result.
@@ -134,6 +141,10 @@ namespace klee {
 
     bool isOwnedByUs(const ObjectState *os) const;
 
+    /// Size of the objects that were copied for or bound in this
+    /// address space and are not shared with any other.
+    uint64_t getOwnedBytes() const { return ownedBytes; }
+
     /// Copy the concrete values of all managed ObjectStates into the
     /// actual system memory location they were allocated at.
     void copyOutConcretes();
@@ -37,10 +37,19 @@
 #define KLEE_BITFIELDSIMPLIFIER_H
 
 #include "klee/Expr.h"
+#include "klee/Statistic.h"
 #include "klee/util/ExprHashMap.h"
 
+#include <vector>
+
 namespace klee {
 
+namespace stats {
+    extern Statistic simplifierCacheHits;
+    extern Statistic simplifierCacheMisses;
+    extern Statistic simplifierCacheEvictions;
+}
+
 class BitfieldSimplifier {
 protected:
     struct BitsInfo {
@@ -52,15 +61,38 @@ protected:
     };
     typedef std::pair<ref<Expr>, BitsInfo> ExprBitsInfo;
 
-    /// XXX: this cache will probably grow too large with time
-    ExprHashMap<BitsInfo> m_bitsInfoCache;
+    /// Maps an expression to its simplified form, along with the bits
+    /// information of the simplified form. Simplified expressions are
+    /// mapped to themselves. The number of entries is bounded, the
+    /// entries that were not used since the clock hand last passed them
+    /// are evicted first.
+    struct CacheEntry {
+        ref<Expr> key;
+        ref<Expr> simplified;
+        BitsInfo bits;
+        bool referenced;
+    };
+
+    std::vector<CacheEntry> m_cache;
+    ExprHashMap<unsigned> m_cacheIndex;
+    unsigned m_cacheHand;
+
+    const CacheEntry *cacheLookup(const ref<Expr> &e);
+    void cacheInsert(const ref<Expr> &e, const ref<Expr> &simplified,
+                     const BitsInfo &bits);
+    void cacheErase(const ref<Expr> &e);
 
     ref<Expr> replaceWithConstant(ref<Expr> e, uint64_t value);
 
     ExprBitsInfo doSimplifyBits(ref<Expr> e, uint64_t ignoredBits);
 
 public:
+    BitfieldSimplifier();
+    ~BitfieldSimplifier();
+
     ref<Expr> simplify(ref<Expr> e, uint64_t *knownZeroBits = NULL);
+
+    unsigned getCacheSize() const { return m_cacheIndex.size(); }
 };
 
 } // namespace klee
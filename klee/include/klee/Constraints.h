@@ -11,6 +11,7 @@
 #define KLEE_CONSTRAINTS_H
 
 #include "klee/Expr.h"
+#include "klee/MemoryUsage.h"
 #include <llvm/Support/raw_ostream.h>
 
 // FIXME: Currently we use ConstraintManager for two things: to pass
@@ -27,14 +28,33 @@ public:
   typedef constraints_ty::iterator iterator;
   typedef constraints_ty::const_iterator const_iterator;
 
-  ConstraintManager() {}
+  ConstraintManager() : accountedSize(0) {
+    memory::constraints.allocated(0);
+  }
 
   // create from constraints with no optimization
   explicit
   ConstraintManager(const std::vector< ref<Expr> > &_constraints) :
-    constraints(_constraints) {}
+    constraints(_constraints), accountedSize(0) {
+    memory::constraints.allocated(0);
+    account();
+  }
+
+  ConstraintManager(const ConstraintManager &cs) :
+    constraints(cs.constraints), accountedSize(0) {
+    memory::constraints.allocated(0);
+    account();
+  }
+
+  ~ConstraintManager() {
+    memory::constraints.freed(accountedSize * sizeof(ref<Expr>));
+  }
 
-  ConstraintManager(const ConstraintManager &cs) : constraints(cs.constraints) {}
+  ConstraintManager &operator=(const ConstraintManager &cs) {
+    constraints = cs.constraints;
+    account();
+    return *this;
+  }
 
   typedef std::vector< ref<Expr> >::const_iterator constraint_iterator;
 
@@ -76,6 +96,15 @@ public:
 private:
   std::vector< ref<Expr> > constraints;
 
+  // Number of constraints reported to memory::constraints
+  size_t accountedSize;
+
+  void account() {
+    int64_t delta = (int64_t) constraints.size() - (int64_t) accountedSize;
+    memory::constraints.resized(delta * sizeof(ref<Expr>));
+    accountedSize = constraints.size();
+  }
+
   // returns true iff the constraints were modified
   bool rewriteConstraints(ExprVisitor &visitor);
 
@@ -30,6 +30,12 @@ namespace stats {
   /// The number of process forks.
   extern Statistic forks;
 
+  /// The number of objects (and their total size in bytes) that were
+  /// duplicated because a state wrote to an object it shared with
+  /// another state.
+  extern Statistic copyOnWriteObjects;
+  extern Statistic copyOnWriteBytes;
+
   /// Number of states, this is a "fake" statistic used by istats, it
   /// isn't normally up-to-date.
   extern Statistic states;
@@ -189,6 +189,10 @@ protected:
 
   void executeInstruction(ExecutionState &state, KInstruction *ki);
 
+  /// Evaluates a pre-decoded integer instruction natively when all its
+  /// operands are constants. Returns false if the generic path is needed.
+  bool executeConcreteInstruction(ExecutionState &state, KInstruction *ki);
+
   void printFileLine(ExecutionState &state, KInstruction *ki);
 
   void run(ExecutionState &initialState);
@@ -31,9 +31,13 @@ namespace klee {
 class Array;
 class ConstantExpr;
 class ObjectState;
+class SizeClassPool;
 
 template<class T> class ref;
 
+/// Returns the pool expressions and update nodes are allocated from.
+SizeClassPool &getExprPool();
+
 
 /// Class representing symbolic expressions.
 /**
@@ -174,6 +178,10 @@ public:
   Expr() : refCount(0) { Expr::count++; }
   virtual ~Expr() { Expr::count--; } 
 
+  // The destructor is virtual, the size is the one of the actual class
+  static void *operator new(size_t size);
+  static void operator delete(void *p, size_t size);
+
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
   
@@ -576,6 +584,9 @@ public:
   int compare(const UpdateNode &b) const;  
   unsigned hash() const { return hashValue; }
 
+  static void *operator new(size_t size);
+  static void operator delete(void *p, size_t size);
+
 private:
   UpdateNode() : refCount(0), stpArray(0) {}
   ~UpdateNode();
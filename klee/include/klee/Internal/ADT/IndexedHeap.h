@@ -0,0 +1,166 @@
+//===-- IndexedHeap.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_INDEXEDHEAP_H
+#define KLEE_INDEXEDHEAP_H
+
+#include <cassert>
+#include <functional>
+#include <vector>
+#include <tr1/unordered_map>
+
+namespace klee {
+
+  /// Binary min-heap of distinct items, each with a cached key. Items
+  /// know their position in the heap, so that their key can be changed
+  /// or they can be removed in O(log n) without ever recomputing the
+  /// keys of the other items. Ties are broken on the items themselves,
+  /// which keeps the order deterministic for pointers.
+  template <class T, class Key, class Compare = std::less<Key> >
+  class IndexedHeap {
+    struct Entry {
+      Key key;
+      T item;
+      Entry(const Key &k, T i) : key(k), item(i) {}
+    };
+
+    typedef std::tr1::unordered_map<T, unsigned> positions_ty;
+
+    std::vector<Entry> heap;
+    positions_ty positions;
+    Compare compare;
+
+    bool before(const Entry &a, const Entry &b) const {
+      if (compare(a.key, b.key))
+        return true;
+      if (compare(b.key, a.key))
+        return false;
+      return a.item < b.item;
+    }
+
+    void place(unsigned i, const Entry &e) {
+      heap[i] = e;
+      positions[e.item] = i;
+    }
+
+    void siftUp(unsigned i) {
+      Entry e = heap[i];
+      while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+        if (!before(e, heap[parent]))
+          break;
+        place(i, heap[parent]);
+        i = parent;
+      }
+      place(i, e);
+    }
+
+    void siftDown(unsigned i) {
+      Entry e = heap[i];
+      unsigned size = heap.size();
+      for (;;) {
+        unsigned child = 2 * i + 1;
+        if (child >= size)
+          break;
+        if (child + 1 < size && before(heap[child + 1], heap[child]))
+          ++child;
+        if (!before(heap[child], e))
+          break;
+        place(i, heap[child]);
+        i = child;
+      }
+      place(i, e);
+    }
+
+    void fix(unsigned i) {
+      if (i > 0 && before(heap[i], heap[(i - 1) / 2]))
+        siftUp(i);
+      else
+        siftDown(i);
+    }
+
+  public:
+    explicit IndexedHeap(const Compare &_compare = Compare())
+      : compare(_compare) {}
+
+    bool empty() const { return heap.empty(); }
+    unsigned size() const { return heap.size(); }
+
+    bool contains(T item) const {
+      return positions.find(item) != positions.end();
+    }
+
+    void insert(T item, const Key &key) {
+      assert(!contains(item) && "item already in heap");
+      heap.push_back(Entry(key, item));
+      siftUp(heap.size() - 1);
+    }
+
+    /// Inserts the item or changes its key.
+    void update(T item, const Key &key) {
+      typename positions_ty::iterator it = positions.find(item);
+      if (it == positions.end()) {
+        insert(item, key);
+      } else {
+        unsigned i = it->second;
+        heap[i].key = key;
+        fix(i);
+      }
+    }
+
+    /// Returns false if the item was not in the heap.
+    bool remove(T item) {
+      typename positions_ty::iterator it = positions.find(item);
+      if (it == positions.end())
+        return false;
+
+      unsigned i = it->second;
+      positions.erase(it);
+
+      Entry last = heap.back();
+      heap.pop_back();
+      if (i < heap.size()) {
+        heap[i] = last;
+        positions[last.item] = i;
+        fix(i);
+      }
+      return true;
+    }
+
+    T top() const {
+      assert(!empty());
+      return heap[0].item;
+    }
+
+    const Key &topKey() const {
+      assert(!empty());
+      return heap[0].key;
+    }
+
+    T pop() {
+      T item = top();
+      remove(item);
+      return item;
+    }
+
+    const Key &getKey(T item) const {
+      typename positions_ty::const_iterator it = positions.find(item);
+      assert(it != positions.end() && "item not in heap");
+      return heap[it->second].key;
+    }
+
+    void clear() {
+      heap.clear();
+      positions.clear();
+    }
+  };
+
+}
+
+#endif
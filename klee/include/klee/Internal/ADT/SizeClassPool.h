@@ -0,0 +1,215 @@
+//===-- SizeClassPool.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SIZECLASSPOOL_H
+#define KLEE_SIZECLASSPOOL_H
+
+#include "klee/MemoryUsage.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace klee {
+
+  /// Allocator for many small objects of a few different sizes. Sizes
+  /// are rounded up to a multiple of Granularity, and each of these size
+  /// classes has a free list of objects carved out of large chunks.
+  /// Allocating and freeing are a few instructions when the free list is
+  /// not empty, and objects of one size class do not fragment the rest
+  /// of the heap. Objects larger than MaxSize are handed to the global
+  /// operator new.
+  ///
+  /// Chunks are aligned on ChunkSize and count their live objects, which
+  /// an object finds from its address. Chunks whose objects are all freed
+  /// are given back together once they make up half of the pool, which
+  /// requires removing their objects from the free lists.
+  ///
+  /// The caller must remember the size of the objects it frees, which
+  /// operator delete(void*, size_t) provides for free.
+  class SizeClassPool {
+  public:
+    static const size_t Granularity = 8;
+    static const size_t MaxSize = 256;
+    static const size_t ChunkSize = 64 * 1024;
+
+    /// Empty chunks are only given back when there are at least that many
+    static const size_t MinTrimChunks = 16;
+
+  private:
+    static const unsigned NumClasses = MaxSize / Granularity;
+
+    struct FreeObject {
+      FreeObject *next;
+    };
+
+    /// Header at the start of every chunk
+    struct Chunk {
+      size_t liveObjects;
+    };
+
+    /// Objects start after the header, with the alignment of operator new
+    static const size_t HeaderSize = (sizeof(Chunk) + 15) & ~(size_t) 15;
+
+    FreeObject *freeLists[NumClasses];
+
+    std::vector<Chunk*> chunks;
+    size_t emptyChunks;
+
+    /// Unused part of the last chunk
+    char *chunkCur, *chunkEnd;
+
+    /// Reports the chunks, if not null
+    MemoryCounter *counter;
+
+    static unsigned getClass(size_t size) {
+      return (size + Granularity - 1) / Granularity - 1;
+    }
+
+    static Chunk *getChunk(void *p) {
+      return reinterpret_cast<Chunk*>((uintptr_t) p & ~(uintptr_t) (ChunkSize - 1));
+    }
+
+    static void freeChunk(Chunk *chunk) {
+#ifdef _WIN32
+      _aligned_free(chunk);
+#else
+      free(chunk);
+#endif
+    }
+
+    void *refill(unsigned c) {
+      size_t size = (c + 1) * Granularity;
+      if ((size_t) (chunkEnd - chunkCur) < size) {
+        // The rest of the chunk is lost, it is smaller than one object
+        void *p;
+#ifdef _WIN32
+        p = _aligned_malloc(ChunkSize, ChunkSize);
+#else
+        if (posix_memalign(&p, ChunkSize, ChunkSize))
+          p = 0;
+#endif
+        if (!p)
+          throw std::bad_alloc();
+
+        Chunk *chunk = static_cast<Chunk*>(p);
+        chunk->liveObjects = 0;
+        chunks.push_back(chunk);
+        ++emptyChunks;
+        chunkCur = static_cast<char*>(p) + HeaderSize;
+        chunkEnd = static_cast<char*>(p) + ChunkSize;
+        if (counter)
+          counter->allocated(ChunkSize);
+      }
+      void *p = chunkCur;
+      chunkCur += size;
+      return p;
+    }
+
+    /// Gives back the empty chunks, except the one being carved
+    void trim() {
+      Chunk *current = chunkCur ? getChunk(chunkCur - 1) : 0;
+
+      for (unsigned c = 0; c < NumClasses; ++c) {
+        FreeObject **prev = &freeLists[c];
+        while (FreeObject *o = *prev) {
+          Chunk *chunk = getChunk(o);
+          if (chunk->liveObjects == 0 && chunk != current)
+            *prev = o->next;
+          else
+            prev = &o->next;
+        }
+      }
+
+      size_t kept = 0, freed = 0;
+      for (size_t i = 0; i < chunks.size(); ++i) {
+        Chunk *chunk = chunks[i];
+        if (chunk->liveObjects == 0 && chunk != current) {
+          freeChunk(chunk);
+          ++freed;
+        } else {
+          chunks[kept++] = chunk;
+        }
+      }
+      chunks.resize(kept);
+      emptyChunks -= freed;
+
+      if (counter && freed)
+        counter->freed(freed * ChunkSize, freed);
+    }
+
+    SizeClassPool(const SizeClassPool&);
+    void operator=(const SizeClassPool&);
+
+  public:
+    explicit SizeClassPool(MemoryCounter *_counter = 0)
+      : emptyChunks(0), chunkCur(0), chunkEnd(0), counter(_counter) {
+      for (unsigned i = 0; i < NumClasses; ++i)
+        freeLists[i] = 0;
+    }
+
+    /// All the objects of the pool must have been freed
+    ~SizeClassPool() {
+      for (std::vector<Chunk*>::iterator it = chunks.begin(),
+             ie = chunks.end(); it != ie; ++it)
+        freeChunk(*it);
+      if (counter)
+        counter->freed(chunks.size() * ChunkSize, chunks.size());
+    }
+
+    /// Size of the chunks, used or not
+    size_t getChunkBytes() const { return chunks.size() * ChunkSize; }
+
+    void *allocate(size_t size) {
+      if (size == 0 || size > MaxSize)
+        return ::operator new(size);
+
+      unsigned c = getClass(size);
+      void *p = freeLists[c];
+      if (p)
+        freeLists[c] = freeLists[c]->next;
+      else
+        p = refill(c);
+
+      if (getChunk(p)->liveObjects++ == 0)
+        --emptyChunks;
+      return p;
+    }
+
+    void deallocate(void *p, size_t size) {
+      if (!p)
+        return;
+      if (size == 0 || size > MaxSize) {
+        ::operator delete(p);
+        return;
+      }
+
+      unsigned c = getClass(size);
+      FreeObject *o = static_cast<FreeObject*>(p);
+      o->next = freeLists[c];
+      freeLists[c] = o;
+
+      Chunk *chunk = getChunk(p);
+      assert(chunk->liveObjects && "object freed twice");
+      if (--chunk->liveObjects == 0 && ++emptyChunks >= MinTrimChunks &&
+          emptyChunks * 2 >= chunks.size())
+        trim();
+    }
+  };
+
+}
+
+#endif
@@ -38,8 +38,20 @@ namespace klee {
     /// Destination register index.
     unsigned dest;
 
+    /// Pre-decoded Expr::Kind of integer binary and compare instructions
+    /// whose operands fit in 64 bits, Expr::InvalidKind otherwise. Lets
+    /// the executor evaluate such instructions natively when all their
+    /// operands are constants.
+    int concreteKind;
+    /// Width of the operands of the pre-decoded instruction.
+    unsigned concreteWidth;
+
     /// The function that owns this instruction
     KFunction *owner;
+
+    /// Node of this instruction in the StatsTracker distance graph, -1
+    /// if the instruction is not part of it.
+    unsigned distanceNode;
   public:
     virtual ~KInstruction(); 
   };
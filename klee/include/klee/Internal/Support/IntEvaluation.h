@@ -10,6 +10,7 @@
 #ifndef KLEE_UTIL_INTEVALUATION_H
 #define KLEE_UTIL_INTEVALUATION_H
 
+#include "klee/Expr.h"
 #include "klee/util/Bits.h"
 
 #define MAX_BITS (sizeof(uint64_t) * 8)
@@ -158,6 +159,54 @@ inline uint64_t sge(uint64_t l, uint64_t r, unsigned inWidth) {
   return sl >= sr;
 }
 
+// evaluation of a binary expression kind on concrete operands. returns
+// false when the result is not defined by the native operation (division
+// by zero, overflowing signed division, oversized shifts), in which case
+// the caller must go through the generic Expr path.
+inline bool evaluate(Expr::Kind kind, uint64_t l, uint64_t r,
+                     unsigned inWidth, uint64_t &result) {
+  switch (kind) {
+  case Expr::Add: result = add(l, r, inWidth); return true;
+  case Expr::Sub: result = sub(l, r, inWidth); return true;
+  case Expr::Mul: result = mul(l, r, inWidth); return true;
+  case Expr::UDiv:
+    if (!r) return false;
+    result = udiv(l, r, inWidth); return true;
+  case Expr::URem:
+    if (!r) return false;
+    result = urem(l, r, inWidth); return true;
+  case Expr::SDiv:
+    if (!r || r == bits64::maxValueOfNBits(inWidth)) return false;
+    result = sdiv(l, r, inWidth); return true;
+  case Expr::SRem:
+    if (!r || r == bits64::maxValueOfNBits(inWidth)) return false;
+    result = srem(l, r, inWidth); return true;
+  case Expr::And: result = land(l, r, inWidth); return true;
+  case Expr::Or:  result = lor(l, r, inWidth); return true;
+  case Expr::Xor: result = lxor(l, r, inWidth); return true;
+  case Expr::Shl:
+    if (r >= inWidth) return false;
+    result = shl(l, r, inWidth); return true;
+  case Expr::LShr:
+    if (r >= inWidth) return false;
+    result = lshr(l, r, inWidth); return true;
+  case Expr::AShr:
+    if (r >= inWidth) return false;
+    result = ashr(l, r, inWidth); return true;
+  case Expr::Eq:  result = eq(l, r, inWidth); return true;
+  case Expr::Ne:  result = ne(l, r, inWidth); return true;
+  case Expr::Ult: result = ult(l, r, inWidth); return true;
+  case Expr::Ule: result = ule(l, r, inWidth); return true;
+  case Expr::Ugt: result = ugt(l, r, inWidth); return true;
+  case Expr::Uge: result = uge(l, r, inWidth); return true;
+  case Expr::Slt: result = slt(l, r, inWidth); return true;
+  case Expr::Sle: result = sle(l, r, inWidth); return true;
+  case Expr::Sgt: result = sgt(l, r, inWidth); return true;
+  case Expr::Sge: result = sge(l, r, inWidth); return true;
+  default: return false;
+  }
+}
+
 } // end namespace ints
 } // end namespace klee
 
@@ -178,6 +178,11 @@ private:
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  // Number of bytes cleared in concreteMask. The mask is released
+  // when this drops to zero, so that a null concreteMask always means
+  // that the whole object is concrete.
+  unsigned symbolicBytesCount;
+
 public:
   unsigned size;
 
@@ -214,12 +219,19 @@ public:
     if(object->isSharedConcrete) {
       *v = ((uint8_t*) object->address)[offset]; return true;
     } else if(isByteConcrete(offset)) {
+      loadConcreteStore();
       *v = concreteStore[offset]; return true;
     } else {
       return false;
     }
   }
 
+  // Bulk concrete accesses. readConcrete fails without touching buf
+  // if any byte of the range is symbolic, writeConcrete overwrites
+  // whatever the range contained with concrete data.
+  bool readConcrete(unsigned offset, uint8_t *buf, unsigned count) const;
+  void writeConcrete(unsigned offset, const uint8_t *buf, unsigned count);
+
   // return bytes written.
   void write(unsigned offset, ref<Expr> value);
   void write(ref<Expr> offset, ref<Expr> value);
@@ -232,28 +244,41 @@ public:
   bool isAllConcrete() const;
 
   inline bool isConcrete(unsigned offset, Expr::Width width) const {
-    if (!concreteMask)
-        return true;
+    return isByteRangeConcrete(offset, Expr::getMinBytesForWidth(width));
+  }
 
-    unsigned size = Expr::getMinBytesForWidth(width);
-    for(unsigned i = 0; i < size; ++i) {
-      if(!isByteConcrete(offset + i))
-        return false;
-    }
-    return true;
+  inline bool isByteRangeConcrete(unsigned offset, unsigned count) const {
+    return !concreteMask || concreteMask->isAllOnes(offset, count);
   }
 
   const uint8_t *getConcreteStore(bool allowSymbolic = false) const;
   uint8_t *getConcreteStore(bool allowSymolic = false);
 
+  // Frees the concrete store of an all-concrete object whose contents
+  // are kept elsewhere in the meantime. allocateConcreteStore() gives it
+  // a new, uninitialized store. Accessing the object in between calls
+  // releasedStoreLoader, which must put the contents back.
+  void releaseConcreteStore();
+  uint8_t *allocateConcreteStore();
+  bool isConcreteStoreReleased() const { return !concreteStore; }
+
+  static void (*releasedStoreLoader)(const ObjectState *os);
+
 private:
   const UpdateList &getUpdates() const;
 
+  inline void loadConcreteStore() const {
+    if (!concreteStore)
+      loadReleasedStore();
+  }
+  void loadReleasedStore() const;
+
   void makeConcrete();
 
   void makeSymbolic();
 
   ref<Expr> read8(ref<Expr> offset) const;
+  ref<Expr> readSymbolicRange(unsigned offset, unsigned count) const;
   void write8(unsigned offset, ref<Expr> value);
   void write8(ref<Expr> offset, ref<Expr> value);
 
@@ -275,8 +300,13 @@ private:
   }
 
   inline void markByteConcrete(unsigned offset) {
-      if (concreteMask)
+      if (concreteMask && !concreteMask->get(offset)) {
         concreteMask->set(offset);
+        if (--symbolicBytesCount == 0) {
+          delete concreteMask;
+          concreteMask = 0;
+        }
+      }
   }
 
   void markByteSymbolic(unsigned offset);
@@ -0,0 +1,61 @@
+//===-- MemoryUsage.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_MEMORYUSAGE_H
+#define KLEE_MEMORYUSAGE_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace klee {
+  /// Tracks the number and the size of the live objects of one kind.
+  /// The counters are updated by the constructors and destructors of the
+  /// objects, which is cheap enough to always be done. Counters register
+  /// themselves when they are constructed, so that they can all be
+  /// reported. MemoryCounters must be global variables.
+  class MemoryCounter {
+    const char *name;
+    int64_t count;
+    int64_t bytes;
+
+  public:
+    MemoryCounter(const char *_name);
+
+    const char *getName() const { return name; }
+    int64_t getCount() const { return count; }
+    int64_t getBytes() const { return bytes; }
+
+    /// size is the total size of the objects
+    void allocated(uint64_t size, uint64_t number = 1) {
+      count += number;
+      bytes += size;
+    }
+
+    void freed(uint64_t size, uint64_t number = 1) {
+      count -= number;
+      bytes -= size;
+    }
+
+    /// The size of a live object changed
+    void resized(int64_t delta) { bytes += delta; }
+
+    static const std::vector<MemoryCounter*> &getCounters();
+  };
+
+  namespace memory {
+    extern MemoryCounter objectStates;
+    extern MemoryCounter constraints;
+    extern MemoryCounter updateNodes;
+    extern MemoryCounter exprPool;
+    extern MemoryCounter solverCaches;
+    extern MemoryCounter simplifierCache;
+  }
+}
+
+#endif
@@ -10,6 +10,7 @@
 #ifndef KLEE_SEARCHER_H
 #define KLEE_SEARCHER_H
 
+#include <functional>
 #include <vector>
 #include <set>
 #include <map>
@@ -28,6 +29,7 @@ namespace llvm {
 
 namespace klee {
   template<class T> class DiscretePDF;
+  template<class T, class Key, class Compare> class IndexedHeap;
   class ExecutionState;
   class Executor;
 
@@ -145,6 +147,51 @@ namespace klee {
     }
   };
 
+  /// Base class for searchers that run the state with the lowest
+  /// priority. Priorities are computed by getPriority() and cached, so
+  /// selecting a state and reprioritizing one are O(log n) regardless
+  /// of the number of states. Subclasses must call updatePriority()
+  /// whenever something the priority of a state depends on changes.
+  class PrioritySearcher : public Searcher {
+  public:
+    typedef IndexedHeap<ExecutionState*, double, std::less<double> > heap_ty;
+
+  private:
+    heap_ty *states;
+    bool updateCurrent;
+
+  protected:
+    virtual double getPriority(ExecutionState *es) = 0;
+
+    /// Adds es to the queue, or recomputes its priority if it is
+    /// already queued.
+    void enqueue(ExecutionState *es);
+    void dequeue(ExecutionState *es);
+    bool isQueued(ExecutionState *es) const;
+
+    ExecutionState *topState() const;
+    double topPriority() const;
+
+  public:
+    /// If updateCurrent is set, the priority of the current state is
+    /// recomputed on every update.
+    explicit PrioritySearcher(bool updateCurrent = false);
+    ~PrioritySearcher();
+
+    /// Recomputes the priority of es, if it is queued.
+    void updatePriority(ExecutionState *es);
+
+    ExecutionState &selectState();
+    void update(ExecutionState *current,
+                const std::set<ExecutionState*> &addedStates,
+                const std::set<ExecutionState*> &removedStates);
+    bool empty();
+    unsigned size() const;
+    void printName(llvm::raw_ostream &os) {
+      os << "PrioritySearcher\n";
+    }
+  };
+
   class RandomPathSearcher : public Searcher {
     Executor &executor;
 
@@ -14,6 +14,7 @@
 #include <llvm/Support/raw_ostream.h>
 #include <iostream>
 #include <set>
+#include <vector>
 
 namespace llvm {
   class BranchInst;
@@ -26,6 +27,7 @@ namespace klee {
   class Executor;  
   class InstructionInfoTable;
   class InterpreterHandler;
+  struct KFunction;
   struct KInstruction;
   struct StackFrame;
 
@@ -37,7 +39,7 @@ namespace klee {
     Executor &executor;
     std::string objectFilename;
 
-    llvm::raw_ostream *statsFile, *istatsFile;
+    llvm::raw_ostream *statsFile, *istatsFile, *uncoveredStatsFile;
     double startWallTime;
     
     unsigned numBranches;
@@ -56,6 +58,8 @@ namespace klee {
     virtual void writeStatsLine();
     virtual void writeIStats();
 
+    void addToDistanceGraph(const std::vector<KFunction*> &functions);
+
   public:
     StatsTracker(Executor &_executor, std::string _objectFilename,
                  bool _updateMinDistToUncovered);
@@ -86,6 +90,11 @@ namespace klee {
     double elapsed();
 
     void computeReachableUncovered();
+
+    // called after a function has been added to or before it is removed
+    // from the module during execution
+    void functionAdded(KFunction *kf);
+    void functionRemoved(KFunction *kf);
   };
 
   uint64_t computeMinDistToUncovered(const KInstruction *ki,
@@ -42,6 +42,8 @@ public:
     for(unsigned i = 0; i < size/32; ++i)
       if(bits[i] != 0)
         return false;
+    if (!(size & 0x1F))
+      return true;
     uint32_t mask = (1 << (size&0x1F)) - 1;
     return (bits[size/32] & mask) == 0;
   }
@@ -50,9 +52,28 @@ public:
     for(unsigned i = 0; i < size/32; ++i)
       if(bits[i] != 0xffffffff)
         return false;
+    if (!(size & 0x1F))
+      return true;
     uint32_t mask = (1 << (size&0x1F)) - 1;
     return (bits[size/32] & mask) == mask;
   }
+
+  // Checks whether all bits in [offset, offset+count) are set,
+  // one 32-bit word at a time.
+  bool isAllOnes(unsigned offset, unsigned count) const {
+    unsigned end = offset + count;
+    while (offset < end) {
+      unsigned shift = offset & 0x1F;
+      unsigned n = end - offset;
+      if (n > 32 - shift)
+        n = 32 - shift;
+      uint32_t mask = (0xffffffff >> (32 - n)) << shift;
+      if ((bits[offset/32] & mask) != mask)
+        return false;
+      offset += n;
+    }
+    return true;
+  }
 };
 
 } // End klee namespace
@@ -0,0 +1,30 @@
+//===-- MemoryUsage.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/MemoryUsage.h"
+
+using namespace klee;
+
+// Counters are global objects of several libraries, keep the list in a
+// function so that it exists whatever the initialization order.
+static std::vector<MemoryCounter*> &getCounterList() {
+  static std::vector<MemoryCounter*> counters;
+  return counters;
+}
+
+// count and bytes are not initialized here: counters have static storage
+// and are zeroed before any constructor runs, objects of other libraries
+// created during static initialization must not be lost.
+MemoryCounter::MemoryCounter(const char *_name) : name(_name) {
+  getCounterList().push_back(this);
+}
+
+const std::vector<MemoryCounter*> &MemoryCounter::getCounters() {
+  return getCounterList();
+}
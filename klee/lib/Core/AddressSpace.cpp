@@ -23,18 +23,27 @@ using namespace klee;
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(state);
   const ObjectState *oldOS = findObject(mo);
-  if(oldOS) state->addressSpaceChange(mo, oldOS, NULL);
+  if(oldOS) {
+    state->addressSpaceChange(mo, oldOS, NULL);
+    if (isOwnedByUs(oldOS))
+      ownedBytes -= oldOS->size;
+  }
   state->addressSpaceChange(mo, NULL, os);
 
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
+  ownedBytes += os->size;
   objects = objects.replace(std::make_pair(mo, os));
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
   assert(state);
   const ObjectState *os = findObject(mo);
-  if(os) state->addressSpaceChange(mo, os, NULL);
+  if(os) {
+    state->addressSpaceChange(mo, os, NULL);
+    if (isOwnedByUs(os))
+      ownedBytes -= os->size;
+  }
 
   objects = objects.remove(mo);
 }
@@ -61,6 +70,10 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
     ObjectState *n = new ObjectState(*os);
     n->copyOnWriteOwner = cowKey;
 
+    ++stats::copyOnWriteObjects;
+    stats::copyOnWriteBytes += os->size;
+    ownedBytes += os->size;
+
     assert(state);
     state->addressSpaceChange(mo, os, n);
 
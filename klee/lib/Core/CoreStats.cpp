@@ -12,6 +12,8 @@
 using namespace klee;
 
 Statistic stats::allocations("Allocations", "Alloc");
+Statistic stats::copyOnWriteBytes("CopyOnWriteBytes", "CowBytes");
+Statistic stats::copyOnWriteObjects("CopyOnWriteObjects", "CowObjs");
 Statistic stats::coveredInstructions("CoveredInstructions", "Icov");
 Statistic stats::falseBranches("FalseBranches", "Bf");
 Statistic stats::forkTime("ForkTime", "Ftime");
@@ -0,0 +1,503 @@
+//===-- DistanceGraph.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "DistanceGraph.h"
+
+#include "klee/Internal/System/Time.h"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <queue>
+
+using namespace klee;
+
+typedef std::pair<DistanceGraph::Distance, unsigned> HeapEntry;
+typedef std::priority_queue<HeapEntry, std::vector<HeapEntry>,
+                            std::greater<HeapEntry> > MinHeap;
+
+const DistanceGraph::Distance DistanceGraph::Infinity;
+
+DistanceGraph::DistanceGraph()
+  : liveNodes(0), edgeCount(0), lastAffected(0) {
+}
+
+void DistanceGraph::ensureNode(unsigned n) {
+  if (n >= nodes.size()) {
+    nodes.resize(n + 1);
+    distances.resize(n + 1, Infinity);
+    affected.resize(n + 1, 0);
+  }
+}
+
+void DistanceGraph::addNode(unsigned n, bool target) {
+  ensureNode(n);
+  Node &node = nodes[n];
+  assert(!node.live && "node already exists");
+  node.live = true;
+  node.target = target;
+  distances[n] = Infinity;
+  ++liveNodes;
+  if (target)
+    decreaseSeeds.push_back(n);
+}
+
+void DistanceGraph::removeEdge(std::vector<Edge> &edges, unsigned node) {
+  for (unsigned i = 0; i < edges.size(); ) {
+    if (edges[i].node == node) {
+      edges[i] = edges.back();
+      edges.pop_back();
+    } else {
+      ++i;
+    }
+  }
+}
+
+void DistanceGraph::removeNode(unsigned n) {
+  assert(n < nodes.size() && nodes[n].live);
+  Node &node = nodes[n];
+
+  // Predecessors that reached a target through this node must be
+  // recomputed.
+  for (std::vector<Edge>::iterator it = node.preds.begin(),
+         ie = node.preds.end(); it != ie; ++it) {
+    if (it->node == n)
+      continue;
+    if (distances[n] != Infinity &&
+        distances[it->node] == distances[n] + it->weight)
+      increaseSeeds.push_back(it->node);
+    removeEdge(nodes[it->node].succs, n);
+  }
+
+  for (std::vector<Edge>::iterator it = node.succs.begin(),
+         ie = node.succs.end(); it != ie; ++it) {
+    if (it->node != n)
+      removeEdge(nodes[it->node].preds, n);
+  }
+
+  edgeCount -= node.succs.size();
+  for (std::vector<Edge>::iterator it = node.preds.begin(),
+         ie = node.preds.end(); it != ie; ++it) {
+    if (it->node != n)
+      --edgeCount;
+  }
+
+  std::vector<Edge>().swap(node.succs);
+  std::vector<Edge>().swap(node.preds);
+  node.live = false;
+  node.target = false;
+  distances[n] = Infinity;
+  --liveNodes;
+}
+
+void DistanceGraph::addEdge(unsigned from, unsigned to, unsigned weight) {
+  assert(weight > 0 && "edge weights must be positive");
+  assert(nodes[from].live && nodes[to].live);
+  nodes[from].succs.push_back(Edge(to, weight));
+  nodes[to].preds.push_back(Edge(from, weight));
+  ++edgeCount;
+  decreaseSeeds.push_back(from);
+}
+
+void DistanceGraph::setTarget(unsigned n, bool target) {
+  Node &node = nodes[n];
+  if (node.target == target)
+    return;
+  node.target = target;
+  if (target)
+    decreaseSeeds.push_back(n);
+  else
+    increaseSeeds.push_back(n);
+}
+
+/// Best distance of n given the current distances of its successors.
+DistanceGraph::Distance DistanceGraph::localDistance(unsigned n,
+                                                     bool skipAffected) const {
+  const Node &node = nodes[n];
+  Distance best = node.target ? 1 : Infinity;
+  for (std::vector<Edge>::const_iterator it = node.succs.begin(),
+         ie = node.succs.end(); it != ie; ++it) {
+    if (skipAffected && affected[it->node])
+      continue;
+    Distance d = distances[it->node];
+    if (d != Infinity && d + it->weight < best)
+      best = d + it->weight;
+  }
+  return best;
+}
+
+/// Lost targets and removed nodes can only increase distances. First
+/// collect the nodes left without a successor on a shortest path, in
+/// increasing order of their old distance (successors on a shortest
+/// path are strictly closer, so they are always decided first), then
+/// recompute these nodes from their unaffected successors.
+void DistanceGraph::propagateIncreases() {
+  lastAffected = 0;
+  if (increaseSeeds.empty())
+    return;
+
+  std::vector<unsigned> affectedNodes;
+  MinHeap candidates;
+  for (std::vector<unsigned>::iterator it = increaseSeeds.begin(),
+         ie = increaseSeeds.end(); it != ie; ++it) {
+    if (*it < nodes.size() && nodes[*it].live && distances[*it] != Infinity)
+      candidates.push(HeapEntry(distances[*it], *it));
+  }
+  increaseSeeds.clear();
+
+  while (!candidates.empty()) {
+    unsigned n = candidates.top().second;
+    candidates.pop();
+    if (affected[n])
+      continue;
+
+    Distance d = distances[n];
+    const Node &node = nodes[n];
+    bool supported = node.target && d == 1;
+    for (std::vector<Edge>::const_iterator it = node.succs.begin(),
+           ie = node.succs.end(); !supported && it != ie; ++it) {
+      if (!affected[it->node] && distances[it->node] != Infinity &&
+          distances[it->node] + it->weight == d)
+        supported = true;
+    }
+    if (supported)
+      continue;
+
+    affected[n] = 1;
+    affectedNodes.push_back(n);
+    for (std::vector<Edge>::const_iterator it = node.preds.begin(),
+           ie = node.preds.end(); it != ie; ++it) {
+      if (!affected[it->node] && distances[it->node] == d + it->weight)
+        candidates.push(HeapEntry(distances[it->node], it->node));
+    }
+  }
+
+  lastAffected = affectedNodes.size();
+
+  MinHeap heap;
+  for (std::vector<unsigned>::iterator it = affectedNodes.begin(),
+         ie = affectedNodes.end(); it != ie; ++it)
+    distances[*it] = Infinity;
+  for (std::vector<unsigned>::iterator it = affectedNodes.begin(),
+         ie = affectedNodes.end(); it != ie; ++it) {
+    Distance d = localDistance(*it, true);
+    if (d != Infinity)
+      heap.push(HeapEntry(d, *it));
+  }
+
+  while (!heap.empty()) {
+    HeapEntry e = heap.top();
+    heap.pop();
+    unsigned n = e.second;
+    if (!affected[n] || e.first >= distances[n])
+      continue;
+    distances[n] = e.first;
+
+    const Node &node = nodes[n];
+    for (std::vector<Edge>::const_iterator it = node.preds.begin(),
+           ie = node.preds.end(); it != ie; ++it) {
+      if (affected[it->node] && e.first + it->weight < distances[it->node])
+        heap.push(HeapEntry(e.first + it->weight, it->node));
+    }
+  }
+
+  // Recomputed nodes may have found a path through an edge added in the
+  // same batch and end up closer than some unaffected predecessors.
+  for (std::vector<unsigned>::iterator it = affectedNodes.begin(),
+         ie = affectedNodes.end(); it != ie; ++it) {
+    affected[*it] = 0;
+    decreaseSeeds.push_back(*it);
+  }
+}
+
+/// New targets and edges can only decrease distances, propagate the
+/// improvements backwards from the nodes they touch.
+void DistanceGraph::propagateDecreases() {
+  MinHeap heap;
+  for (std::vector<unsigned>::iterator it = decreaseSeeds.begin(),
+         ie = decreaseSeeds.end(); it != ie; ++it) {
+    if (*it >= nodes.size() || !nodes[*it].live)
+      continue;
+    Distance d = localDistance(*it, false);
+    if (d < distances[*it])
+      distances[*it] = d;
+    // Seeds may have been lowered by the increase phase already, their
+    // predecessors still have to see the new value.
+    if (distances[*it] != Infinity)
+      heap.push(HeapEntry(distances[*it], *it));
+  }
+  decreaseSeeds.clear();
+
+  while (!heap.empty()) {
+    HeapEntry e = heap.top();
+    heap.pop();
+    unsigned n = e.second;
+    if (e.first != distances[n])
+      continue;
+
+    const Node &node = nodes[n];
+    for (std::vector<Edge>::const_iterator it = node.preds.begin(),
+           ie = node.preds.end(); it != ie; ++it) {
+      Distance d = e.first + it->weight;
+      if (d < distances[it->node]) {
+        distances[it->node] = d;
+        heap.push(HeapEntry(d, it->node));
+      }
+    }
+  }
+}
+
+void DistanceGraph::update() {
+  propagateIncreases();
+  propagateDecreases();
+}
+
+void DistanceGraph::computeAll(std::vector<Distance> &result) const {
+  result.assign(nodes.size(), Infinity);
+
+  MinHeap heap;
+  for (unsigned n = 0; n < nodes.size(); ++n) {
+    if (nodes[n].live && nodes[n].target) {
+      result[n] = 1;
+      heap.push(HeapEntry(1, n));
+    }
+  }
+
+  while (!heap.empty()) {
+    HeapEntry e = heap.top();
+    heap.pop();
+    if (e.first != result[e.second])
+      continue;
+
+    const Node &node = nodes[e.second];
+    for (std::vector<Edge>::const_iterator it = node.preds.begin(),
+           ie = node.preds.end(); it != ie; ++it) {
+      Distance d = e.first + it->weight;
+      if (d < result[it->node]) {
+        result[it->node] = d;
+        heap.push(HeapEntry(d, it->node));
+      }
+    }
+  }
+
+  for (unsigned n = 0; n < result.size(); ++n)
+    if (result[n] == Infinity)
+      result[n] = 0;
+}
+
+///
+
+DistanceGraphUpdater *DistanceGraphUpdater::forkInstance = 0;
+
+DistanceGraphUpdater::DistanceGraphUpdater(bool _useThread, bool _checkUpdates)
+  : useThread(_useThread),
+    checkUpdates(_checkUpdates),
+    nextNode(0),
+    current(0),
+    published(0),
+    stopping(false),
+    threadRunning(false) {
+  pthread_mutex_init(&queueLock, NULL);
+  pthread_mutex_init(&graphLock, NULL);
+  pthread_cond_init(&queueCond, NULL);
+
+  if (useThread) {
+    // S2E forks the whole process to run states in parallel: make sure
+    // no update is in progress while forking, the child restarts its
+    // own thread on the next refresh.
+    static bool atForkRegistered = false;
+    if (!atForkRegistered) {
+      pthread_atfork(prepareFork, parentFork, childFork);
+      atForkRegistered = true;
+    }
+    forkInstance = this;
+  }
+}
+
+DistanceGraphUpdater::~DistanceGraphUpdater() {
+  if (threadRunning) {
+    pthread_mutex_lock(&queueLock);
+    stopping = true;
+    pthread_cond_signal(&queueCond);
+    pthread_mutex_unlock(&queueLock);
+    pthread_join(thread, NULL);
+  }
+
+  if (forkInstance == this)
+    forkInstance = 0;
+
+  delete published;
+  delete current;
+  pthread_cond_destroy(&queueCond);
+  pthread_mutex_destroy(&graphLock);
+  pthread_mutex_destroy(&queueLock);
+}
+
+void DistanceGraphUpdater::prepareFork() {
+  if (forkInstance) {
+    // Same order as threadMain
+    pthread_mutex_lock(&forkInstance->queueLock);
+    pthread_mutex_lock(&forkInstance->graphLock);
+  }
+}
+
+void DistanceGraphUpdater::parentFork() {
+  if (forkInstance) {
+    pthread_mutex_unlock(&forkInstance->graphLock);
+    pthread_mutex_unlock(&forkInstance->queueLock);
+  }
+}
+
+void DistanceGraphUpdater::childFork() {
+  if (forkInstance) {
+    pthread_mutex_unlock(&forkInstance->graphLock);
+    pthread_mutex_unlock(&forkInstance->queueLock);
+    // Threads do not survive fork
+    forkInstance->threadRunning = false;
+  }
+}
+
+unsigned DistanceGraphUpdater::allocateNode() {
+  if (!freeNodes.empty()) {
+    unsigned n = freeNodes.back();
+    freeNodes.pop_back();
+    return n;
+  }
+  return nextNode++;
+}
+
+void DistanceGraphUpdater::addNode(unsigned n, bool target) {
+  newEvents.push_back(Event(AddNode, n, target));
+}
+
+void DistanceGraphUpdater::addEdge(unsigned from, unsigned to,
+                                   unsigned weight) {
+  newEvents.push_back(Event(AddEdge, from, to, weight));
+}
+
+void DistanceGraphUpdater::removeNode(unsigned n) {
+  newEvents.push_back(Event(RemoveNode, n));
+  freeNodes.push_back(n);
+}
+
+void DistanceGraphUpdater::setCovered(unsigned n) {
+  newEvents.push_back(Event(SetCovered, n));
+}
+
+void DistanceGraphUpdater::apply(std::vector<Event> &pending,
+                                 DistanceSnapshot &snapshot) {
+  double start = util::getWallTime();
+
+  for (std::vector<Event>::iterator it = pending.begin(),
+         ie = pending.end(); it != ie; ++it) {
+    switch (it->kind) {
+    case AddNode: graph.addNode(it->node, it->other); break;
+    case RemoveNode: graph.removeNode(it->node); break;
+    case AddEdge: graph.addEdge(it->node, it->other, it->weight); break;
+    case SetCovered: graph.setTarget(it->node, false); break;
+    }
+  }
+  graph.update();
+
+  snapshot.updateTime = util::getWallTime() - start;
+  snapshot.events = pending.size();
+  snapshot.nodes = graph.getNodeCount();
+  snapshot.edges = graph.getEdgeCount();
+  snapshot.affected = graph.getLastAffected();
+
+  snapshot.distances.resize(graph.getMaxNode());
+  for (unsigned n = 0; n < graph.getMaxNode(); ++n)
+    snapshot.distances[n] = graph.getDistance(n);
+
+  if (checkUpdates) {
+    std::vector<DistanceGraph::Distance> reference;
+    start = util::getWallTime();
+    graph.computeAll(reference);
+    snapshot.fullTime = util::getWallTime() - start;
+
+    snapshot.mismatches = 0;
+    for (unsigned n = 0; n < reference.size(); ++n)
+      if (reference[n] != snapshot.distances[n])
+        ++snapshot.mismatches;
+  }
+
+  pending.clear();
+}
+
+void *DistanceGraphUpdater::threadMain(void *opaque) {
+  DistanceGraphUpdater *u = static_cast<DistanceGraphUpdater*>(opaque);
+  std::vector<Event> pending;
+
+  pthread_mutex_lock(&u->queueLock);
+  while (!u->stopping) {
+    if (u->events.empty()) {
+      pthread_cond_wait(&u->queueCond, &u->queueLock);
+      continue;
+    }
+
+    pending.swap(u->events);
+    pthread_mutex_lock(&u->graphLock);
+    pthread_mutex_unlock(&u->queueLock);
+
+    DistanceSnapshot *snapshot = new DistanceSnapshot();
+    u->apply(pending, *snapshot);
+    pthread_mutex_unlock(&u->graphLock);
+
+    pthread_mutex_lock(&u->queueLock);
+    delete u->published;
+    u->published = snapshot;
+  }
+  pthread_mutex_unlock(&u->queueLock);
+
+  return NULL;
+}
+
+void DistanceGraphUpdater::startThread() {
+  stopping = false;
+  if (pthread_create(&thread, NULL, threadMain, this) == 0) {
+    threadRunning = true;
+  } else {
+    // Fall back to synchronous updates
+    useThread = false;
+  }
+}
+
+const DistanceSnapshot *DistanceGraphUpdater::refresh() {
+  if (useThread && !threadRunning)
+    startThread();
+
+  if (!useThread) {
+    if (newEvents.empty())
+      return 0;
+    DistanceSnapshot *snapshot = current ? current : new DistanceSnapshot();
+    apply(newEvents, *snapshot);
+    current = snapshot;
+    return current;
+  }
+
+  DistanceSnapshot *snapshot;
+  pthread_mutex_lock(&queueLock);
+  if (!newEvents.empty()) {
+    // The background thread may still be busy with the previous batch,
+    // in which case both batches are applied together.
+    events.insert(events.end(), newEvents.begin(), newEvents.end());
+    newEvents.clear();
+    pthread_cond_signal(&queueCond);
+  }
+  snapshot = published;
+  published = 0;
+  pthread_mutex_unlock(&queueLock);
+
+  if (!snapshot)
+    return 0;
+
+  delete current;
+  current = snapshot;
+  return current;
+}
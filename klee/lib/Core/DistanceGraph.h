@@ -0,0 +1,187 @@
+//===-- DistanceGraph.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_DISTANCEGRAPH_H
+#define KLEE_DISTANCEGRAPH_H
+
+#include <pthread.h>
+#include <vector>
+#include <stdint.h>
+
+namespace klee {
+
+  /// Maintains, for every node of a graph with positive edge weights,
+  /// the length of the shortest path to a target node (targets are at
+  /// distance 1, 0 means that no target is reachable).
+  ///
+  /// Changes are applied incrementally by update(): new targets, nodes
+  /// and edges are propagated backwards Dijkstra-style from the nodes
+  /// they touch, lost targets and removed nodes first invalidate the
+  /// nodes whose shortest path went through them, then recompute only
+  /// those.
+  class DistanceGraph {
+  public:
+    typedef uint64_t Distance;
+
+    struct Edge {
+      unsigned node;
+      unsigned weight;
+      Edge(unsigned n, unsigned w) : node(n), weight(w) {}
+    };
+
+  private:
+    static const Distance Infinity = ~(Distance) 0;
+
+    struct Node {
+      std::vector<Edge> succs, preds;
+      bool target;
+      bool live;
+      Node() : target(false), live(false) {}
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Distance> distances;
+    unsigned liveNodes, edgeCount;
+
+    /// Nodes whose distance may have increased
+    std::vector<unsigned> increaseSeeds;
+    /// Nodes whose distance may have decreased
+    std::vector<unsigned> decreaseSeeds;
+
+    std::vector<char> affected;
+    unsigned lastAffected;
+
+    void ensureNode(unsigned n);
+    void removeEdge(std::vector<Edge> &edges, unsigned node);
+    Distance localDistance(unsigned n, bool skipAffected) const;
+
+    void propagateIncreases();
+    void propagateDecreases();
+
+  public:
+    DistanceGraph();
+
+    void addNode(unsigned n, bool target);
+    void removeNode(unsigned n);
+    void addEdge(unsigned from, unsigned to, unsigned weight);
+    void setTarget(unsigned n, bool target);
+
+    /// Propagates the changes made since the last update.
+    void update();
+
+    /// Computes all distances from scratch, without touching the
+    /// maintained ones (used to check the incremental algorithm).
+    void computeAll(std::vector<Distance> &result) const;
+
+    Distance getDistance(unsigned n) const {
+      if (n >= distances.size() || distances[n] == Infinity)
+        return 0;
+      return distances[n];
+    }
+
+    unsigned getNodeCount() const { return liveNodes; }
+    unsigned getEdgeCount() const { return edgeCount; }
+    unsigned getMaxNode() const { return nodes.size(); }
+
+    /// Number of nodes recomputed because of lost targets during the
+    /// last update.
+    unsigned getLastAffected() const { return lastAffected; }
+  };
+
+  /// Result of a DistanceGraph update, as seen by the executor.
+  struct DistanceSnapshot {
+    /// Indexed by node, 0 is unreachable
+    std::vector<DistanceGraph::Distance> distances;
+
+    unsigned nodes, edges;
+    unsigned events;
+    unsigned affected;
+    /// Wall time of the incremental update, in seconds
+    double updateTime;
+    /// Wall time of a full recomputation, if checking was enabled
+    double fullTime;
+    unsigned mismatches;
+
+    DistanceSnapshot()
+      : nodes(0), edges(0), events(0), affected(0),
+        updateTime(0), fullTime(0), mismatches(0) {}
+  };
+
+  /// Feeds a DistanceGraph with changes made by the execution thread and
+  /// publishes the resulting distances. The updates are either applied
+  /// synchronously by refresh(), or on a background thread, in which
+  /// case refresh() returns the most recent snapshot computed so far.
+  class DistanceGraphUpdater {
+  private:
+    enum EventKind { AddNode, RemoveNode, AddEdge, SetCovered };
+
+    struct Event {
+      EventKind kind;
+      unsigned node, other, weight;
+      Event(EventKind k, unsigned n, unsigned o = 0, unsigned w = 0)
+        : kind(k), node(n), other(o), weight(w) {}
+    };
+
+    DistanceGraph graph;
+    bool useThread;
+    bool checkUpdates;
+
+    // Owned by the execution thread
+    std::vector<Event> newEvents;
+    std::vector<unsigned> freeNodes;
+    unsigned nextNode;
+    DistanceSnapshot *current;
+
+    // Shared with the background thread, protected by queueLock.
+    // queueLock is always taken before graphLock.
+    std::vector<Event> events;
+    DistanceSnapshot *published;
+    bool stopping;
+    bool threadRunning;
+    pthread_t thread;
+    pthread_mutex_t queueLock;
+    pthread_cond_t queueCond;
+
+    /// Held while the graph is being updated
+    pthread_mutex_t graphLock;
+
+    static DistanceGraphUpdater *forkInstance;
+    static void prepareFork();
+    static void parentFork();
+    static void childFork();
+
+    static void *threadMain(void *updater);
+    void startThread();
+    void apply(std::vector<Event> &pending, DistanceSnapshot &snapshot);
+
+  public:
+    DistanceGraphUpdater(bool useThread, bool checkUpdates);
+    ~DistanceGraphUpdater();
+
+    unsigned allocateNode();
+    void addNode(unsigned n, bool target);
+    void addEdge(unsigned from, unsigned to, unsigned weight);
+    /// Frees the node, its number may be reused by allocateNode
+    void removeNode(unsigned n);
+    void setCovered(unsigned n);
+
+    /// Applies or hands over the pending changes. Returns the snapshot
+    /// that became current, or null if the distances did not change.
+    const DistanceSnapshot *refresh();
+
+    DistanceGraph::Distance getDistance(unsigned n) const {
+      if (!current || n >= current->distances.size())
+        return 0;
+      return current->distances[n];
+    }
+  };
+
+} // End klee namespace
+
+#endif
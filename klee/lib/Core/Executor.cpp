@@ -42,6 +42,7 @@
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/Support/FloatEvaluation.h"
+#include "klee/Internal/Support/IntEvaluation.h"
 #include "klee/Internal/System/Time.h"
 
 #include "llvm/Attributes.h"
@@ -849,11 +850,16 @@ Executor::concolicFork(ExecutionState &current, ref<Expr> condition, bool isInte
     notifyBranch(current);
 
     ExecutionState *trueState, *falseState, *branchedState;
+
+    //The branched state gets its own concolic values when it is
+    //resolved, don't copy the ones of the current state.
+    Assignment::bindings_ty concolics;
+    concolics.swap(current.concolics.bindings);
     branchedState = current.branch();
+    current.concolics.bindings.swap(concolics);
     addedStates.insert(branchedState);
 
     branchedState->speculative = true;
-    branchedState->concolics.clear();
 
     //We don't know if the branched state could be valid
     //or not, so we mark it speculative and defer the
@@ -1645,7 +1651,46 @@ static bool isDebugIntrinsic(const Function *f, KModule *KM) {
 #endif
 }
 
+/// Constants for the results of compare instructions, which are
+/// by far the most common ones in concretely executed code.
+static ref<ConstantExpr> s_boolConstants[2] = {
+  ConstantExpr::alloc(0, Expr::Bool),
+  ConstantExpr::alloc(1, Expr::Bool)
+};
+
+bool Executor::executeConcreteInstruction(ExecutionState &state,
+                                          KInstruction *ki) {
+  const ConstantExpr *left = dyn_cast<ConstantExpr>(eval(ki, 0, state).value);
+  if (!left)
+    return false;
+
+  const ConstantExpr *right = dyn_cast<ConstantExpr>(eval(ki, 1, state).value);
+  if (!right)
+    return false;
+
+  Expr::Kind kind = (Expr::Kind) ki->concreteKind;
+  uint64_t result;
+  if (!ints::evaluate(kind, left->getZExtValue(), right->getZExtValue(),
+                      ki->concreteWidth, result))
+    return false;
+
+  // Constants do not need to go through the simplifier
+  Cell &dest = getDestCell(state, ki);
+  if (kind >= Expr::CmpKindFirst && kind <= Expr::CmpKindLast) {
+    dest.value = s_boolConstants[result];
+  } else {
+    dest.value = ConstantExpr::alloc(result, ki->concreteWidth);
+  }
+  return true;
+}
+
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
+  // Most instructions of guest code operate on concrete values,
+  // bypass the Expr builders for them.
+  if (ki->concreteKind != Expr::InvalidKind &&
+      executeConcreteInstruction(state, ki))
+    return;
+
   Instruction *i = ki->inst;
   switch (i->getOpcode()) {
     // Control flow
@@ -13,6 +13,7 @@
 
 #include "klee/Context.h"
 #include "klee/Expr.h"
+#include "klee/MemoryUsage.h"
 #include "klee/Solver.h"
 #include "klee/util/BitArray.h"
 
@@ -37,6 +38,9 @@ namespace {
                     cl::init(true));
 }
 
+// Concrete stores and known symbolics are counted, the bit masks are not
+MemoryCounter klee::memory::objectStates("ObjectStates");
+
 /***/
 
 ObjectHolder::ObjectHolder(const ObjectHolder &b) : os(b.os) { 
@@ -98,9 +102,12 @@ ObjectState::ObjectState(const MemoryObject *mo)
     flushMask(0),
     knownSymbolics(0),
     updates(0, 0),
+    symbolicBytesCount(0),
     size(mo->size),
     readOnly(false)
      {
+  memory::objectStates.allocated(sizeof(*this) + size);
+
   if (!UseConstantArrays) {
     // FIXME: Leaked.
     static unsigned id = 0;
@@ -119,9 +126,11 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
     flushMask(0),
     knownSymbolics(0),
     updates(array, 0),
+    symbolicBytesCount(0),
     size(mo->size),
     readOnly(false)
  {
+  memory::objectStates.allocated(sizeof(*this) + size);
   makeSymbolic();
 }
 
@@ -134,10 +143,12 @@ ObjectState::ObjectState(const ObjectState &os)
     flushMask(os.flushMask ? new BitArray(*os.flushMask, os.size) : 0),
     knownSymbolics(0),
     updates(os.updates),
+    symbolicBytesCount(os.symbolicBytesCount),
     size(os.size),
     readOnly(false)
      {
   assert(!os.readOnly && "no need to copy read only object?");
+  os.loadConcreteStore();
 
   if (os.knownSymbolics) {
     knownSymbolics = new ref<Expr>[size];
@@ -145,10 +156,16 @@ ObjectState::ObjectState(const ObjectState &os)
       knownSymbolics[i] = os.knownSymbolics[i];
   }
 
+  memory::objectStates.allocated(sizeof(*this) + size +
+                                 (knownSymbolics ? size * sizeof(ref<Expr>) : 0));
+
   memcpy(concreteStore, os.concreteStore, size*sizeof(*concreteStore));
 }
 
 ObjectState::~ObjectState() {
+  memory::objectStates.freed(sizeof(*this) + (concreteStore ? size : 0) +
+                             (knownSymbolics ? size * sizeof(ref<Expr>) : 0));
+
   if (concreteMask) delete concreteMask;
   if (flushMask) delete flushMask;
   if (knownSymbolics) delete[] knownSymbolics;
@@ -216,10 +233,14 @@ const UpdateList &ObjectState::getUpdates() const {
 void ObjectState::makeConcrete() {
   if (concreteMask) delete concreteMask;
   if (flushMask) delete flushMask;
-  if (knownSymbolics) delete[] knownSymbolics;
+  if (knownSymbolics) {
+    memory::objectStates.resized(-(int64_t) (size * sizeof(ref<Expr>)));
+    delete[] knownSymbolics;
+  }
   concreteMask = 0;
   flushMask = 0;
   knownSymbolics = 0;
+  symbolicBytesCount = 0;
 }
 
 void ObjectState::makeSymbolic() {
@@ -236,11 +257,13 @@ void ObjectState::makeSymbolic() {
 
 void ObjectState::initializeToZero() {
   makeConcrete();
+  loadConcreteStore();
   memset(concreteStore, 0, size);
 }
 
 void ObjectState::initializeToRandom() {  
   makeConcrete();
+  loadConcreteStore();
   for (unsigned i=0; i<size; i++) {
     // randomly selected by 256 sided die
     concreteStore[i] = 0xAB;
@@ -265,6 +288,7 @@ void ObjectState::fastRangeCheckOffset(ref<Expr> offset,
 void ObjectState::flushRangeForRead(unsigned rangeBase, 
                                     unsigned rangeSize) const {
   if (!flushMask) flushMask = new BitArray(size, true);
+  loadConcreteStore();
  
   for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
     if (!isByteFlushed(offset)) {
@@ -285,6 +309,7 @@ void ObjectState::flushRangeForRead(unsigned rangeBase,
 void ObjectState::flushRangeForWrite(unsigned rangeBase, 
                                      unsigned rangeSize) {
   if (!flushMask) flushMask = new BitArray(size, true);
+  loadConcreteStore();
 
   for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
     if (!isByteFlushed(offset)) {
@@ -313,7 +338,7 @@ void ObjectState::flushRangeForWrite(unsigned rangeBase,
 }
 
 bool ObjectState::isAllConcrete() const {
-  return !concreteMask || concreteMask->isAllOnes(size);
+  return !concreteMask;
 }
 
 
@@ -323,6 +348,7 @@ const uint8_t *ObjectState::getConcreteStore(bool allowSymbolic) const
     if (!allowSymbolic && !isAllConcrete()) {
         return NULL;
     }
+    loadConcreteStore();
     return concreteStore;
 }
 
@@ -331,14 +357,43 @@ uint8_t *ObjectState::getConcreteStore(bool allowSymbolic)
     if (!allowSymbolic && !isAllConcrete()) {
         return NULL;
     }
+    loadConcreteStore();
+    return concreteStore;
+}
+
+void ObjectState::releaseConcreteStore()
+{
+    assert(isAllConcrete() && concreteStore);
+    delete[] concreteStore;
+    concreteStore = NULL;
+    memory::objectStates.resized(-(int64_t) size);
+}
+
+uint8_t *ObjectState::allocateConcreteStore()
+{
+    assert(!concreteStore);
+    concreteStore = new uint8_t[size];
+    memory::objectStates.resized(size);
     return concreteStore;
 }
 
+void (*ObjectState::releasedStoreLoader)(const ObjectState *os) = 0;
+
+void ObjectState::loadReleasedStore() const
+{
+    assert(releasedStoreLoader && "accessing a released object");
+    releasedStoreLoader(this);
+    assert(concreteStore && "released object was not loaded");
+}
+
 
 void ObjectState::markByteSymbolic(unsigned offset) {
   if (!concreteMask)
     concreteMask = new BitArray(size, true);
-  concreteMask->unset(offset);
+  if (concreteMask->get(offset)) {
+    concreteMask->unset(offset);
+    ++symbolicBytesCount;
+  }
 }
 
 
@@ -357,6 +412,7 @@ inline void ObjectState::setKnownSymbolic(unsigned offset,
   } else {
     if (value) {
       knownSymbolics = new ref<Expr>[size];
+      memory::objectStates.resized(size * sizeof(ref<Expr>));
       knownSymbolics[offset] = value;
     }
   }
@@ -367,6 +423,7 @@ inline void ObjectState::setKnownSymbolic(unsigned offset,
 ref<Expr> ObjectState::read8(unsigned offset) const {
   if (!object->isSharedConcrete) {
     if (isByteConcrete(offset)) {
+      loadConcreteStore();
       return ConstantExpr::create(concreteStore[offset], Expr::Int8);
     } else if (isByteKnownSymbolic(offset)) {
       return knownSymbolics[offset];
@@ -381,6 +438,46 @@ ref<Expr> ObjectState::read8(unsigned offset) const {
   }
 }
 
+/// Builds the concatenation of the reads of count flushed symbolic bytes
+/// at offset at once, as read8 and ConcatExpr::create would, but walking
+/// the update list only once. Returns null if a byte has a concrete or
+/// known symbolic value, or if the update list has a write to the range
+/// that ReadExpr::create would fold.
+ref<Expr> ObjectState::readSymbolicRange(unsigned offset,
+                                         unsigned count) const {
+  if (object->isSharedConcrete || !concreteMask || !flushMask)
+    return 0;
+
+  for (unsigned i = 0; i != count; ++i) {
+    if (isByteConcrete(offset + i) || isByteKnownSymbolic(offset + i) ||
+        !isByteFlushed(offset + i))
+      return 0;
+  }
+
+  const UpdateList &ul = getUpdates();
+  for (const UpdateNode *un = ul.head; un; un = un->next) {
+    ConstantExpr *CE = dyn_cast<ConstantExpr>(un->index);
+    if (!CE)
+      break;
+    uint64_t index = CE->getZExtValue();
+    if (index >= offset && index < offset + count)
+      return 0;
+  }
+
+  // Bytes are added from the least significant one, each read is
+  // neither a constant nor an extract, so ConcatExpr::create would not
+  // simplify anything.
+  ref<Expr> Res(0);
+  for (unsigned i = 0; i != count; ++i) {
+    unsigned idx = Context::get().isLittleEndian() ? i : (count - i - 1);
+    ref<Expr> Byte = ReadExpr::alloc(ul, ConstantExpr::alloc(offset + idx,
+                                                             Expr::Int32));
+    Res = i ? ConcatExpr::alloc(Byte, Res) : Byte;
+  }
+
+  return Res;
+}
+
 ref<Expr> ObjectState::read8(ref<Expr> offset) const {
   assert(!isa<ConstantExpr>(offset) && "constant offset passed to symbolic read8");
   assert(!object->isSharedConcrete &&
@@ -403,6 +500,7 @@ ref<Expr> ObjectState::read8(ref<Expr> offset) const {
 void ObjectState::write8(unsigned offset, uint8_t value) {
   //assert(read_only == false && "writing to read-only object!");
   if(!object->isSharedConcrete) {
+    loadConcreteStore();
     concreteStore[offset] = value;
     setKnownSymbolic(offset, 0);
 
@@ -413,6 +511,40 @@ void ObjectState::write8(unsigned offset, uint8_t value) {
   }
 }
 
+bool ObjectState::readConcrete(unsigned offset, uint8_t *buf,
+                               unsigned count) const {
+  assert(offset + count <= size && "out of bounds concrete read");
+  if (object->isSharedConcrete) {
+    memcpy(buf, (uint8_t*) object->address + offset, count);
+  } else if (isByteRangeConcrete(offset, count)) {
+    loadConcreteStore();
+    memcpy(buf, concreteStore + offset, count);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void ObjectState::writeConcrete(unsigned offset, const uint8_t *buf,
+                                unsigned count) {
+  assert(offset + count <= size && "out of bounds concrete write");
+  if (object->isSharedConcrete) {
+    memcpy((uint8_t*) object->address + offset, buf, count);
+  } else if (isByteRangeConcrete(offset, count)) {
+    // Concrete bytes never have a known symbolic value,
+    // only the flush state needs to be maintained.
+    loadConcreteStore();
+    memcpy(concreteStore + offset, buf, count);
+    if (flushMask) {
+      for (unsigned i = 0; i < count; ++i)
+        flushMask->set(offset + i);
+    }
+  } else {
+    for (unsigned i = 0; i < count; ++i)
+      write8(offset + i, buf[i]);
+  }
+}
+
 void ObjectState::write8(unsigned offset, ref<Expr> value) {
   // can happen when ExtractExpr special cases
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
@@ -463,12 +595,26 @@ ref<Expr> ObjectState::read(ref<Expr> offset, Expr::Width width) const {
   // Otherwise, follow the slow general case.
   unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid write size!");
+
+  // The first read8 flushes the range given by fastRangeCheckOffset,
+  // the other bytes need no flush only if that range is the whole object.
+#ifndef NDEBUG
+  unsigned flushBase, flushSize;
+  fastRangeCheckOffset(offset, &flushBase, &flushSize);
+  assert(flushBase == 0 && flushSize == size &&
+         "symbolic read does not flush the whole object");
+#endif
+
   ref<Expr> Res(0);
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    ref<Expr> Byte = read8(AddExpr::create(offset, 
-                                           ConstantExpr::create(idx, 
-                                                                Expr::Int32)));
+    ref<Expr> ByteOffset = AddExpr::create(offset,
+                                           ConstantExpr::create(idx,
+                                                                Expr::Int32));
+    ref<Expr> Byte = i ? ReadExpr::create(getUpdates(),
+                                          ZExtExpr::create(ByteOffset,
+                                                           Expr::Int32))
+                       : read8(ByteOffset);
     Res = idx ? ConcatExpr::create(Byte, Res) : Byte;
   }
 
@@ -480,9 +626,18 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
-  // Otherwise, follow the slow general case.
   unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid write size!");
+
+  // Loads of symbolic data that has not been overwritten since it was
+  // made symbolic (or since a write at a symbolic offset).
+  if (NumBytes > 1) {
+    ref<Expr> Res = readSymbolicRange(offset, NumBytes);
+    if (!Res.isNull())
+      return Res;
+  }
+
+  // Otherwise, follow the slow general case.
   ref<Expr> Res(0);
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
@@ -22,6 +22,7 @@
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/ADT/DiscretePDF.h"
+#include "klee/Internal/ADT/IndexedHeap.h"
 #include "klee/Internal/ADT/RNG.h"
 #include "klee/Internal/Support/ModuleUtil.h"
 #include "klee/Internal/System/Time.h"
@@ -224,6 +225,72 @@ bool WeightedRandomSearcher::empty() {
 
 ///
 
+PrioritySearcher::PrioritySearcher(bool _updateCurrent)
+  : states(new heap_ty()),
+    updateCurrent(_updateCurrent) {
+}
+
+PrioritySearcher::~PrioritySearcher() {
+  delete states;
+}
+
+void PrioritySearcher::enqueue(ExecutionState *es) {
+  states->update(es, getPriority(es));
+}
+
+void PrioritySearcher::dequeue(ExecutionState *es) {
+  states->remove(es);
+}
+
+bool PrioritySearcher::isQueued(ExecutionState *es) const {
+  return states->contains(es);
+}
+
+ExecutionState *PrioritySearcher::topState() const {
+  return states->top();
+}
+
+double PrioritySearcher::topPriority() const {
+  return states->topKey();
+}
+
+void PrioritySearcher::updatePriority(ExecutionState *es) {
+  if (states->contains(es))
+    states->update(es, getPriority(es));
+}
+
+ExecutionState &PrioritySearcher::selectState() {
+  return *states->top();
+}
+
+void PrioritySearcher::update(ExecutionState *current,
+                              const std::set<ExecutionState*> &addedStates,
+                              const std::set<ExecutionState*> &removedStates) {
+  for (std::set<ExecutionState*>::const_iterator it = removedStates.begin(),
+         ie = removedStates.end(); it != ie; ++it) {
+    bool ok = states->remove(*it);
+    assert(ok && "invalid state removed");
+    (void) ok;
+  }
+
+  for (std::set<ExecutionState*>::const_iterator it = addedStates.begin(),
+         ie = addedStates.end(); it != ie; ++it)
+    states->insert(*it, getPriority(*it));
+
+  if (current && updateCurrent && !removedStates.count(current))
+    updatePriority(current);
+}
+
+bool PrioritySearcher::empty() {
+  return states->empty();
+}
+
+unsigned PrioritySearcher::size() const {
+  return states->size();
+}
+
+///
+
 RandomPathSearcher::RandomPathSearcher(Executor &_executor)
   : executor(_executor) {
 }
@@ -22,6 +22,7 @@
 #include "klee/CallPathManager.h"
 #include "klee/CoreStats.h"
 #include "klee/Executor.h"
+#include "DistanceGraph.h"
 #include "MemoryManager.h"
 #include "klee/UserSearcher.h"
 #include "klee/SolverStats.h"
@@ -40,6 +41,7 @@
 #include "llvm/Support/PathV2.h"
 #include "llvm/Support/FileSystem.h"
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 
@@ -85,6 +87,16 @@ namespace {
   cl::opt<double>
   UncoveredUpdateInterval("uncovered-update-interval",
                           cl::init(30.));
+
+  cl::opt<bool>
+  UncoveredUpdateThread("uncovered-update-thread",
+                        cl::desc("Update distances to uncovered instructions on a background thread"),
+                        cl::init(false));
+
+  cl::opt<bool>
+  CheckUncoveredDistances("check-uncovered-distances",
+                          cl::desc("Check incremental updates of distances to uncovered instructions against a full recomputation (slow)"),
+                          cl::init(false));
   
   cl::opt<bool>
   UseCallPaths("use-call-paths",
@@ -156,12 +168,29 @@ static bool instructionIsCoverable(Instruction *i) {
   return true;
 }
 
+/// Distances to uncovered instructions, updated incrementally as
+/// instructions get covered and functions are added to the module.
+static DistanceGraphUpdater *distanceUpdater = 0;
+/// Distance from each node to the return of its function, 0 is
+/// unreachable.
+static std::vector<uint64_t> distToReturn;
+/// Nodes that are not (or no longer) uncovered
+static std::vector<char> nodeCovered;
+
+static inline void markNodeCovered(unsigned node) {
+  if (node < nodeCovered.size() && !nodeCovered[node]) {
+    nodeCovered[node] = 1;
+    distanceUpdater->setCovered(node);
+  }
+}
+
 StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
                            bool _updateMinDistToUncovered)
   : executor(_executor),
     objectFilename(_objectFilename),
     statsFile(0),
     istatsFile(0),
+    uncoveredStatsFile(0),
     startWallTime(util::getWallTime()),
     numBranches(0),
     fullBranches(0),
@@ -202,6 +231,12 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
       }
     }
   }
+
+  if (updateMinDistToUncovered) {
+    distanceUpdater = new DistanceGraphUpdater(UncoveredUpdateThread,
+                                               CheckUncoveredDistances);
+    addToDistanceGraph(km->functions);
+  }
 }
 
 void StatsTracker::writeHeaders()
@@ -214,8 +249,24 @@ void StatsTracker::writeHeaders()
 
     executor.addTimer(new WriteStatsTimer(this), StatsWriteInterval);
 
-    if (updateMinDistToUncovered)
+    if (updateMinDistToUncovered) {
+      uncoveredStatsFile =
+        executor.interpreterHandler->openOutputFile("uncovered.stats");
+      assert(uncoveredStatsFile && "unable to open uncovered stats file");
+      *uncoveredStatsFile << "('WallTime',"
+                          << "'Nodes',"
+                          << "'Edges',"
+                          << "'Events',"
+                          << "'Affected',"
+                          << "'UpdateTime',"
+                          << "'FullTime',"
+                          << "'Mismatches',"
+                          << ")\n";
+      uncoveredStatsFile->flush();
+
+      computeReachableUncovered();
       executor.addTimer(new UpdateReachableTimer(this), UncoveredUpdateInterval);
+    }
   }
 
   if (OutputIStats) {
@@ -231,6 +282,11 @@ StatsTracker::~StatsTracker() {
     delete statsFile;
   if (istatsFile)
     delete istatsFile;
+  if (uncoveredStatsFile)
+    delete uncoveredStatsFile;
+
+  delete distanceUpdater;
+  distanceUpdater = 0;
 }
 
 void StatsTracker::done() {
@@ -241,6 +297,9 @@ void StatsTracker::done() {
 }
 
 void StatsTracker::stepInstruction(ExecutionState &es) {
+  if (updateMinDistToUncovered)
+    markNodeCovered(es.pc->distanceNode);
+
   if (OutputIStats) {
     if (TrackInstructionTime) {
       static sys::TimeValue lastNowTime(0,0),lastUserTime(0,0);
@@ -294,26 +353,25 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
 
 /* Should be called _after_ the es->pushFrame() */
 void StatsTracker::framePushed(ExecutionState &es, StackFrame *parentFrame) {
-  if (OutputIStats) {
-    StackFrame &sf = es.stack.back();
+  StackFrame &sf = es.stack.back();
+
+  if (OutputIStats && UseCallPaths) {
+    CallPathNode *parent = parentFrame ? parentFrame->callPathNode : 0;
+    CallPathNode *cp = callPathManager.getCallPath(parent, 
+                                                   sf.caller ? sf.caller->inst : 0, 
+                                                   sf.kf->function);
+    sf.callPathNode = cp;
+    cp->count++;
+  }
 
-    if (UseCallPaths) {
-      CallPathNode *parent = parentFrame ? parentFrame->callPathNode : 0;
-      CallPathNode *cp = callPathManager.getCallPath(parent, 
-                                                     sf.caller ? sf.caller->inst : 0, 
-                                                     sf.kf->function);
-      sf.callPathNode = cp;
-      cp->count++;
-    }
+  // Distances no longer depend on the indexed statistics
+  if (updateMinDistToUncovered) {
+    uint64_t minDistAtRA = 0;
+    if (parentFrame)
+      minDistAtRA = parentFrame->minDistToUncoveredOnReturn;
 
-    if (updateMinDistToUncovered) {
-      uint64_t minDistAtRA = 0;
-      if (parentFrame)
-        minDistAtRA = parentFrame->minDistToUncoveredOnReturn;
-      
-      sf.minDistToUncoveredOnReturn = sf.caller ?
-        computeMinDistToUncovered(sf.caller, minDistAtRA) : 0;
-    }
+    sf.minDistToUncoveredOnReturn = sf.caller ?
+      computeMinDistToUncovered(sf.caller, minDistAtRA) : 0;
   }
 }
 
@@ -558,247 +616,295 @@ static calltargets_ty callTargets;
 static std::map<Function*, std::vector<Instruction*> > functionCallers;
 static std::map<Function*, unsigned> functionShortestPath;
 
-static std::vector<Instruction*> getSuccs(Instruction *i) {
-  BasicBlock *bb = i->getParent();
-  std::vector<Instruction*> res;
+static void initFunctionShortestPath(Function *f) {
+  if (functionShortestPath.count(f))
+    return;
 
-  if (i==bb->getTerminator()) {
-    for (succ_iterator it = succ_begin(bb), ie = succ_end(bb); it != ie; ++it)
-      res.push_back(it->begin());
+  // 0 is unreachable
+  if (f->isDeclaration()) {
+    if (f->doesNotReturn()) {
+      functionShortestPath[f] = 0;
+    } else {
+      functionShortestPath[f] = 1; // whatever
+    }
   } else {
-    res.push_back(++BasicBlock::iterator(i));
+    functionShortestPath[f] = 0;
   }
-
-  return res;
 }
 
-uint64_t klee::computeMinDistToUncovered(const KInstruction *ki,
-                                         uint64_t minDistAtRA) {
-  StatisticManager &sm = *theStatisticManager;
-  if (minDistAtRA==0) { // unreachable on return, best is local
-    return sm.getIndexedValue(stats::minDistToUncovered,
-                              ki->info->id);
+/// Compute call targets. It would be nice to use alias information
+/// instead of assuming all indirect calls hit all escaping functions,
+/// eh?
+static void computeCallTargets(KModule *km, Instruction *inst) {
+  std::vector<Function*> &targets = callTargets[inst];
+
+  if (isa<InlineAsm>(inst->getOperand(0))) {
+    // We can never call through here so assume no targets (which
+    // should be correct anyhow).
+  } else if (Function *target = getDirectCallTarget(inst)) {
+    targets.push_back(target);
   } else {
-    uint64_t minDistLocal = sm.getIndexedValue(stats::minDistToUncovered,
-                                               ki->info->id);
-    uint64_t distToReturn = sm.getIndexedValue(stats::minDistToReturn,
-                                               ki->info->id);
-
-    if (distToReturn==0) { // return unreachable, best is local
-      return minDistLocal;
-    } else if (!minDistLocal) { // no local reachable
-      return distToReturn + minDistAtRA;
-    } else {
-      return std::min(minDistLocal, distToReturn + minDistAtRA);
-    }
+    targets.assign(km->escapingFunctions.begin(),
+                   km->escapingFunctions.end());
+  }
+
+  // Function callers are the reflexion of callTargets
+  for (std::vector<Function*>::iterator it = targets.begin(),
+         ie = targets.end(); it != ie; ++it) {
+    functionCallers[*it].push_back(inst);
+    initFunctionShortestPath(*it);
   }
 }
 
-void StatsTracker::computeReachableUncovered() {
-  KModule *km = executor.kmodule;
-  Module *m = km->module;
-  static bool init = true;
-  const InstructionInfoTable &infos = *km->infos;
-  StatisticManager &sm = *theStatisticManager;
-  
-  if (init) {
-    init = false;
-
-    // Compute call targets. It would be nice to use alias information
-    // instead of assuming all indirect calls hit all escaping
-    // functions, eh?
-    for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
-         fnIt != fn_ie; ++fnIt) {
-      for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
-           bbIt != bb_ie; ++bbIt) {
-        for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-             it != ie; ++it) {
-          if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
-            if (isa<InlineAsm>(it->getOperand(0))) {
-              // We can never call through here so assume no targets
-              // (which should be correct anyhow).
-              callTargets.insert(std::make_pair(it,
-                                                std::vector<Function*>()));
-            } else if (Function *target = getDirectCallTarget(it)) {
-              callTargets[it].push_back(target);
-            } else {
-              callTargets[it] = 
-                std::vector<Function*>(km->escapingFunctions.begin(),
-                                       km->escapingFunctions.end());
-            }
-          }
-        }
-      }
+/// Cost of executing ki itself on a path to its successors, 0 if the
+/// successors cannot be reached (calls to functions that never return).
+static unsigned getBestThrough(KInstruction *ki) {
+  if (!isa<CallInst>(ki->inst) && !isa<InvokeInst>(ki->inst))
+    return 1;
+
+  unsigned bestThrough = 0;
+  std::vector<Function*> &targets = callTargets[ki->inst];
+  for (std::vector<Function*>::iterator fnIt = targets.begin(),
+         ie = targets.end(); fnIt != ie; ++fnIt) {
+    uint64_t dist = functionShortestPath[*fnIt];
+    if (dist) {
+      dist = 1+dist; // count instruction itself
+      if (bestThrough==0 || dist<bestThrough)
+        bestThrough = dist;
     }
+  }
+  return bestThrough;
+}
 
-    // Compute function callers as reflexion of callTargets.
-    for (calltargets_ty::iterator it = callTargets.begin(), 
-           ie = callTargets.end(); it != ie; ++it)
-      for (std::vector<Function*>::iterator fit = it->second.begin(), 
-             fie = it->second.end(); fit != fie; ++fit) 
-        functionCallers[*fit].push_back(it->first);
-
-    // Initialize minDistToReturn to shortest paths through
-    // functions. 0 is unreachable.
-    std::vector<Instruction *> instructions;
-    for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
-         fnIt != fn_ie; ++fnIt) {
-      if (fnIt->isDeclaration()) {
-        if (fnIt->doesNotReturn()) {
-          functionShortestPath[fnIt] = 0;
-        } else {
-          functionShortestPath[fnIt] = 1; // whatever
-        }
-      } else {
-        functionShortestPath[fnIt] = 0;
-      }
+static void getSuccs(KFunction *kf, unsigned index,
+                     std::vector<unsigned> &succs) {
+  Instruction *i = kf->instructions[index]->inst;
+  BasicBlock *bb = i->getParent();
 
-      // Not sure if I should bother to preorder here. XXX I should.
-      for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
-           bbIt != bb_ie; ++bbIt) {
-        for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-             it != ie; ++it) {
-          instructions.push_back(it);
-          unsigned id = infos.getInfo(it).id;
-          sm.setIndexedValue(stats::minDistToReturn, 
-                             id, 
-                             isa<ReturnInst>(it));
-        }
-      }
-    }
-  
-    std::reverse(instructions.begin(), instructions.end());
-    
-    // I'm so lazy it's not even worklisted.
-    bool changed;
-    do {
-      changed = false;
-      for (std::vector<Instruction*>::iterator it = instructions.begin(),
-             ie = instructions.end(); it != ie; ++it) {
-        Instruction *inst = *it;
-        unsigned bestThrough = 0;
-
-        if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
-          std::vector<Function*> &targets = callTargets[inst];
-          for (std::vector<Function*>::iterator fnIt = targets.begin(),
-                 ie = targets.end(); fnIt != ie; ++fnIt) {
-            uint64_t dist = functionShortestPath[*fnIt];
-            if (dist) {
-              dist = 1+dist; // count instruction itself
-              if (bestThrough==0 || dist<bestThrough)
-                bestThrough = dist;
-            }
-          }
-        } else {
-          bestThrough = 1;
-        }
-       
-        if (bestThrough) {
-          unsigned id = infos.getInfo(*it).id;
-          uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToReturn, id);
-          std::vector<Instruction*> succs = getSuccs(*it);
-          for (std::vector<Instruction*>::iterator it2 = succs.begin(),
-                 ie = succs.end(); it2 != ie; ++it2) {
-            uint64_t dist = sm.getIndexedValue(stats::minDistToReturn,
-                                               infos.getInfo(*it2).id);
-            if (dist) {
-              uint64_t val = bestThrough + dist;
-              if (best==0 || val<best)
-                best = val;
-            }
-          }
-          if (best != cur) {
-            sm.setIndexedValue(stats::minDistToReturn, id, best);
-            changed = true;
-
-            // Update shortest path if this is the entry point.
-            Function *f = inst->getParent()->getParent();
-            if (inst==f->begin()->begin())
-              functionShortestPath[f] = best;
-          }
-        }
-      }
-    } while (changed);
+  succs.clear();
+  if (i==bb->getTerminator()) {
+    for (succ_iterator it = succ_begin(bb), ie = succ_end(bb); it != ie; ++it)
+      succs.push_back(kf->instructions[kf->basicBlockEntry[*it]]->distanceNode);
+  } else {
+    succs.push_back(kf->instructions[index + 1]->distanceNode);
   }
+}
+
+/// Initialize distToReturn to shortest paths through functions. Only
+/// the given functions are recomputed, the ones they call are assumed
+/// to be up to date.
+static void computeDistToReturn(const std::vector<KFunction*> &functions) {
+  std::vector<unsigned> succs;
 
-  // compute minDistToUncovered, 0 is unreachable
-  std::vector<Instruction *> instructions;
-  for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
-       fnIt != fn_ie; ++fnIt) {
-    // Not sure if I should bother to preorder here.
-    for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
-         bbIt != bb_ie; ++bbIt) {
-      for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-           it != ie; ++it) {
-        unsigned id = infos.getInfo(it).id;
-        instructions.push_back(&*it);
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           id, 
-                           sm.getIndexedValue(stats::uncoveredInstructions, id));
-      }
-    }
-  }
-  
-  std::reverse(instructions.begin(), instructions.end());
-  
   // I'm so lazy it's not even worklisted.
   bool changed;
   do {
     changed = false;
-    for (std::vector<Instruction*>::iterator it = instructions.begin(),
-           ie = instructions.end(); it != ie; ++it) {
-      Instruction *inst = *it;
-      uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToUncovered, 
-                                                     infos.getInfo(inst).id);
-      unsigned bestThrough = 0;
-      
-      if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
-        std::vector<Function*> &targets = callTargets[inst];
-        for (std::vector<Function*>::iterator fnIt = targets.begin(),
-               ie = targets.end(); fnIt != ie; ++fnIt) {
-          uint64_t dist = functionShortestPath[*fnIt];
-          if (dist) {
-            dist = 1+dist; // count instruction itself
-            if (bestThrough==0 || dist<bestThrough)
-              bestThrough = dist;
-          }
-
-          if (!(*fnIt)->isDeclaration()) {
-            uint64_t calleeDist = sm.getIndexedValue(stats::minDistToUncovered,
-                                                     infos.getFunctionInfo(*fnIt).id);
-            if (calleeDist) {
-              calleeDist = 1+calleeDist; // count instruction itself
-              if (best==0 || calleeDist<best)
-                best = calleeDist;
-            }
-          }
-        }
-      } else {
-        bestThrough = 1;
-      }
-      
-      if (bestThrough) {
-        std::vector<Instruction*> succs = getSuccs(inst);
-        for (std::vector<Instruction*>::iterator it2 = succs.begin(),
-               ie = succs.end(); it2 != ie; ++it2) {
-          uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered,
-                                             infos.getInfo(*it2).id);
+    for (std::vector<KFunction*>::const_reverse_iterator
+           fit = functions.rbegin(), fie = functions.rend();
+         fit != fie; ++fit) {
+      KFunction *kf = *fit;
+      for (unsigned i = kf->numInstructions; i != 0; --i) {
+        KInstruction *ki = kf->instructions[i - 1];
+        unsigned bestThrough = getBestThrough(ki);
+        if (!bestThrough)
+          continue;
+
+        uint64_t best, cur = best = distToReturn[ki->distanceNode];
+        getSuccs(kf, i - 1, succs);
+        for (std::vector<unsigned>::iterator it = succs.begin(),
+               ie = succs.end(); it != ie; ++it) {
+          uint64_t dist = distToReturn[*it];
           if (dist) {
             uint64_t val = bestThrough + dist;
             if (best==0 || val<best)
               best = val;
           }
         }
-      }
+        if (best != cur) {
+          distToReturn[ki->distanceNode] = best;
+          changed = true;
 
-      if (best != cur) {
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           infos.getInfo(inst).id, 
-                           best);
-        changed = true;
+          // Update shortest path if this is the entry point.
+          if (i == 1)
+            functionShortestPath[kf->function] = best;
+        }
       }
     }
   } while (changed);
+}
+
+void StatsTracker::addToDistanceGraph(const std::vector<KFunction*> &functions) {
+  KModule *km = executor.kmodule;
+
+  for (std::vector<KFunction*>::const_iterator fit = functions.begin(),
+         fie = functions.end(); fit != fie; ++fit) {
+    KFunction *kf = *fit;
+    initFunctionShortestPath(kf->function);
+
+    for (unsigned i=0; i<kf->numInstructions; ++i) {
+      KInstruction *ki = kf->instructions[i];
+      unsigned node = distanceUpdater->allocateNode();
+      ki->distanceNode = node;
+      if (node >= distToReturn.size()) {
+        distToReturn.resize(node + 1);
+        nodeCovered.resize(node + 1);
+      }
+
+      bool target = kf->trackCoverage && instructionIsCoverable(ki->inst);
+      distToReturn[node] = isa<ReturnInst>(ki->inst);
+      nodeCovered[node] = !target;
+      distanceUpdater->addNode(node, target);
+
+      if (isa<CallInst>(ki->inst) || isa<InvokeInst>(ki->inst))
+        computeCallTargets(km, ki->inst);
+    }
+  }
+
+  computeDistToReturn(functions);
+
+  std::vector<unsigned> succs;
+  for (std::vector<KFunction*>::const_iterator fit = functions.begin(),
+         fie = functions.end(); fit != fie; ++fit) {
+    KFunction *kf = *fit;
+    for (unsigned i=0; i<kf->numInstructions; ++i) {
+      KInstruction *ki = kf->instructions[i];
+
+      if (isa<CallInst>(ki->inst) || isa<InvokeInst>(ki->inst)) {
+        std::vector<Function*> &targets = callTargets[ki->inst];
+        for (std::vector<Function*>::iterator it = targets.begin(),
+               ie = targets.end(); it != ie; ++it) {
+          std::map<Function*, KFunction*>::iterator kfIt =
+            km->functionMap.find(*it);
+          if (kfIt == km->functionMap.end())
+            continue;
+          KInstruction *entry = kfIt->second->instructions[0];
+          if (entry->distanceNode != (unsigned) -1)
+            distanceUpdater->addEdge(ki->distanceNode, entry->distanceNode, 1);
+        }
+      }
+
+      unsigned bestThrough = getBestThrough(ki);
+      if (!bestThrough)
+        continue;
+
+      getSuccs(kf, i, succs);
+      for (std::vector<unsigned>::iterator it = succs.begin(),
+             ie = succs.end(); it != ie; ++it)
+        distanceUpdater->addEdge(ki->distanceNode, *it, bestThrough);
+    }
+  }
+}
+
+void StatsTracker::functionAdded(KFunction *kf) {
+  if (!distanceUpdater)
+    return;
+
+  // Indirect calls in the rest of the module keep the targets they had
+  // when they were added.
+  addToDistanceGraph(std::vector<KFunction*>(1, kf));
+}
+
+void StatsTracker::functionRemoved(KFunction *kf) {
+  if (!distanceUpdater)
+    return;
+
+  for (unsigned i=0; i<kf->numInstructions; ++i) {
+    KInstruction *ki = kf->instructions[i];
+    if (ki->distanceNode == (unsigned) -1)
+      continue;
+
+    distanceUpdater->removeNode(ki->distanceNode);
+    ki->distanceNode = (unsigned) -1;
+
+    calltargets_ty::iterator ctIt = callTargets.find(ki->inst);
+    if (ctIt == callTargets.end())
+      continue;
+    for (std::vector<Function*>::iterator it = ctIt->second.begin(),
+           ie = ctIt->second.end(); it != ie; ++it) {
+      std::vector<Instruction*> &callers = functionCallers[*it];
+      callers.erase(std::remove(callers.begin(), callers.end(), ki->inst),
+                    callers.end());
+    }
+    callTargets.erase(ctIt);
+  }
+
+  Function *f = kf->function;
+  std::vector<Instruction*> &callers = functionCallers[f];
+  for (std::vector<Instruction*>::iterator it = callers.begin(),
+         ie = callers.end(); it != ie; ++it) {
+    std::vector<Function*> &targets = callTargets[*it];
+    targets.erase(std::remove(targets.begin(), targets.end(), f),
+                  targets.end());
+  }
+  functionCallers.erase(f);
+  functionShortestPath.erase(f);
+}
+
+uint64_t klee::computeMinDistToUncovered(const KInstruction *ki,
+                                         uint64_t minDistAtRA) {
+  uint64_t minDistLocal, distToReturnLocal;
+  if (distanceUpdater) {
+    unsigned node = ki->distanceNode;
+    minDistLocal = distanceUpdater->getDistance(node);
+    distToReturnLocal = node < distToReturn.size() ? distToReturn[node] : 0;
+  } else {
+    StatisticManager &sm = *theStatisticManager;
+    minDistLocal = sm.getIndexedValue(stats::minDistToUncovered,
+                                      ki->info->id);
+    distToReturnLocal = sm.getIndexedValue(stats::minDistToReturn,
+                                           ki->info->id);
+  }
+
+  if (minDistAtRA==0) { // unreachable on return, best is local
+    return minDistLocal;
+  } else if (distToReturnLocal==0) { // return unreachable, best is local
+    return minDistLocal;
+  } else if (!minDistLocal) { // no local reachable
+    return distToReturnLocal + minDistAtRA;
+  } else {
+    return std::min(minDistLocal, distToReturnLocal + minDistAtRA);
+  }
+}
+
+void StatsTracker::computeReachableUncovered() {
+  // Only the changes since the last call are propagated, possibly on a
+  // background thread, in which case the distances computed so far are
+  // used until the next call.
+  const DistanceSnapshot *snapshot = distanceUpdater->refresh();
+  if (!snapshot)
+    return;
+
+  if (uncoveredStatsFile) {
+    *uncoveredStatsFile << "(" << elapsed()
+                        << "," << snapshot->nodes
+                        << "," << snapshot->edges
+                        << "," << snapshot->events
+                        << "," << snapshot->affected
+                        << "," << snapshot->updateTime
+                        << "," << snapshot->fullTime
+                        << "," << snapshot->mismatches
+                        << ")\n";
+    uncoveredStatsFile->flush();
+  }
+
+  if (OutputIStats) {
+    StatisticManager &sm = *theStatisticManager;
+    KModule *km = executor.kmodule;
+    for (std::vector<KFunction*>::iterator fit = km->functions.begin(),
+           fie = km->functions.end(); fit != fie; ++fit) {
+      KFunction *kf = *fit;
+      for (unsigned i=0; i<kf->numInstructions; ++i) {
+        KInstruction *ki = kf->instructions[i];
+        if (ki->distanceNode == (unsigned) -1)
+          continue;
+        sm.setIndexedValue(stats::minDistToUncovered, ki->info->id,
+                           distanceUpdater->getDistance(ki->distanceNode));
+        sm.setIndexedValue(stats::minDistToReturn, ki->info->id,
+                           distToReturn[ki->distanceNode]);
+      }
+    }
+  }
 
   for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
          ie = executor.states.end(); it != ie; ++it) {
@@ -815,9 +921,9 @@ void StatsTracker::computeReachableUncovered() {
         kii = next->caller;
         ++kii;
       }
-      
+
       sfIt->minDistToUncoveredOnReturn = currentFrameMinDist;
-      
+
       currentFrameMinDist = computeMinDistToUncovered(kii, currentFrameMinDist);
     }
   }
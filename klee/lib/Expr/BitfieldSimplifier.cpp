@@ -36,11 +36,18 @@
 #include "klee/BitfieldSimplifier.h"
 
 #include <klee/Common.h>
+#include <klee/MemoryUsage.h>
 #include "llvm/Support/CommandLine.h"
 
 using namespace klee;
 using namespace llvm;
 
+Statistic stats::simplifierCacheHits("SimplifierCacheHits", "SChits");
+Statistic stats::simplifierCacheMisses("SimplifierCacheMisses", "SCmisses");
+Statistic stats::simplifierCacheEvictions("SimplifierCacheEvictions", "SCevict");
+
+MemoryCounter memory::simplifierCache("SimplifierCache");
+
 namespace {
     inline uint64_t zeroMask(uint64_t w) {
         if(w < 64)
@@ -56,6 +63,90 @@ namespace {
     cl::opt<bool>
     PrintSimplifier("print-expr-simplifier",
                 cl::init(false));
+
+    cl::opt<unsigned>
+    SimplifierCacheSize("expr-simplifier-cache-size",
+                cl::desc("Maximum number of expressions remembered by the "
+                         "expression simplifier, 0 for no limit (default: 100000)"),
+                cl::init(100000));
+}
+
+BitfieldSimplifier::BitfieldSimplifier() : m_cacheHand(0)
+{
+}
+
+BitfieldSimplifier::~BitfieldSimplifier()
+{
+    memory::simplifierCache.freed(m_cache.size() * sizeof(CacheEntry) +
+            m_cacheIndex.size() * sizeof(ExprHashMap<unsigned>::value_type),
+            m_cache.size());
+}
+
+const BitfieldSimplifier::CacheEntry *BitfieldSimplifier::cacheLookup(
+                                                    const ref<Expr> &e)
+{
+    ExprHashMap<unsigned>::iterator it = m_cacheIndex.find(e);
+    if (it == m_cacheIndex.end())
+        return NULL;
+
+    CacheEntry &entry = m_cache[it->second];
+    entry.referenced = true;
+    return &entry;
+}
+
+/// Existing entries are left unchanged
+void BitfieldSimplifier::cacheInsert(const ref<Expr> &e,
+                                     const ref<Expr> &simplified,
+                                     const BitsInfo &bits)
+{
+    if (m_cacheIndex.count(e))
+        return;
+
+    unsigned slot;
+    if (SimplifierCacheSize == 0 || m_cache.size() < SimplifierCacheSize) {
+        slot = m_cache.size();
+        m_cache.push_back(CacheEntry());
+        memory::simplifierCache.allocated(sizeof(CacheEntry) +
+                sizeof(ExprHashMap<unsigned>::value_type));
+    } else {
+        // Give a second chance to the entries used since the last pass
+        while (m_cache[m_cacheHand].referenced) {
+            m_cache[m_cacheHand].referenced = false;
+            m_cacheHand = (m_cacheHand + 1) % m_cache.size();
+        }
+        slot = m_cacheHand;
+        m_cacheHand = (m_cacheHand + 1) % m_cache.size();
+        m_cacheIndex.erase(m_cache[slot].key);
+        ++stats::simplifierCacheEvictions;
+    }
+
+    CacheEntry &entry = m_cache[slot];
+    entry.key = e;
+    entry.simplified = simplified;
+    entry.bits = bits;
+    entry.referenced = false;
+    m_cacheIndex.insert(std::make_pair(e, slot));
+}
+
+void BitfieldSimplifier::cacheErase(const ref<Expr> &e)
+{
+    ExprHashMap<unsigned>::iterator it = m_cacheIndex.find(e);
+    if (it == m_cacheIndex.end())
+        return;
+
+    // Move the last entry to the freed slot
+    unsigned slot = it->second;
+    m_cacheIndex.erase(it);
+    if (slot != m_cache.size() - 1) {
+        m_cache[slot] = m_cache.back();
+        m_cacheIndex[m_cache[slot].key] = slot;
+    }
+    m_cache.pop_back();
+    if (m_cacheHand >= m_cache.size())
+        m_cacheHand = 0;
+
+    memory::simplifierCache.freed(sizeof(CacheEntry) +
+            sizeof(ExprHashMap<unsigned>::value_type));
 }
 
 ref<Expr> BitfieldSimplifier::replaceWithConstant(ref<Expr> e, uint64_t value)
@@ -67,10 +158,10 @@ ref<Expr> BitfieldSimplifier::replaceWithConstant(ref<Expr> e, uint64_t value)
     // Remove kids from cache
     unsigned numKids = e->getNumKids();
     for(unsigned i = 0; i < numKids; ++i)
-        m_bitsInfoCache.erase(e->getKid(i));
+        cacheErase(e->getKid(i));
 
     // Remove e from cache
-    m_bitsInfoCache.erase(e);
+    cacheErase(e);
 
     return ConstantExpr::create(value & ~zeroMask(e->getWidth()), e->getWidth());
 }
@@ -78,16 +169,31 @@ ref<Expr> BitfieldSimplifier::replaceWithConstant(ref<Expr> e, uint64_t value)
 BitfieldSimplifier::ExprBitsInfo BitfieldSimplifier::doSimplifyBits(
                                     ref<Expr> e, uint64_t ignoredBits)
 {
-    ExprHashMap<BitsInfo>::iterator it = m_bitsInfoCache.find(e);
-    if(it != m_bitsInfoCache.end()) {
+    if (const CacheEntry *entry = cacheLookup(e)) {
         /* This expression was already visited before */
-        if((ignoredBits & ~it->second.ignoredBits) == 0) {
+        uint64_t cachedIgnoredBits = entry->bits.ignoredBits;
+        bool valid;
+        if (entry->simplified.get() == e.get()) {
             /* ignoredBits is not more restrictive then before,
                there is no point in reoptimizing the expression */
-            return *it;
+            valid = (ignoredBits & ~cachedIgnoredBits) == 0;
+        } else {
+            /* The simplified form may differ from e in the bits that
+               were ignored, these bits must be ignored now too */
+            valid = (cachedIgnoredBits & ~ignoredBits) == 0;
+        }
+
+        if (valid) {
+            ++stats::simplifierCacheHits;
+            return std::make_pair(entry->simplified, entry->bits);
         }
     }
 
+    if (e->getNumKids() > 1)
+        ++stats::simplifierCacheMisses;
+
+    ref<Expr> original = e;
+
     ref<Expr> kids[8];
     BitsInfo bits[8];
     uint64_t oldIgnoredBits[8];
@@ -362,9 +468,12 @@ BitfieldSimplifier::ExprBitsInfo BitfieldSimplifier::doSimplifyBits(
         }
     }
 
-    /* Cache knownBits information, but only for complex expressions */
+    /* Cache knownBits information and the simplified form of the
+       original expression, but only for complex expressions */
     if(e->getNumKids() > 1)
-        m_bitsInfoCache.insert(std::make_pair(e, rbits));
+        cacheInsert(e, e, rbits);
+    if(original.get() != e.get() && original->getNumKids() > 1)
+        cacheInsert(original, e, rbits);
 
     return std::make_pair(e, rbits);
 }
@@ -17,6 +17,9 @@
 
 using namespace klee;
 
+// The expressions are shared, only the references are counted
+MemoryCounter klee::memory::constraints("Constraints");
+
 class ExprReplaceVisitor : public ExprVisitor {
 private:
   ref<Expr> src, dst;
@@ -153,4 +156,5 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
 void ConstraintManager::addConstraint(ref<Expr> e) {
   e = simplifyExpr(e);
   addConstraintInternal(e);
+  account();
 }
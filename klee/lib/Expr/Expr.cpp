@@ -8,6 +8,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/Expr.h"
+#include "klee/MemoryUsage.h"
+#include "klee/Internal/ADT/SizeClassPool.h"
 #include <llvm/ADT/Hashing.h>
 
 #include "llvm/Support/CommandLine.h"
@@ -35,6 +37,23 @@ namespace {
 
 unsigned Expr::count = 0;
 
+// Counts the chunks of the pool, live expressions are in Expr::count
+MemoryCounter klee::memory::exprPool("ExprPool");
+
+SizeClassPool &klee::getExprPool() {
+  // Never deleted, expressions may be freed by static destructors
+  static SizeClassPool *pool = new SizeClassPool(&memory::exprPool);
+  return *pool;
+}
+
+void *Expr::operator new(size_t size) {
+  return getExprPool().allocate(size);
+}
+
+void Expr::operator delete(void *p, size_t size) {
+  getExprPool().deallocate(p, size);
+}
+
 ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
   UpdateList ul(array, 0);
 
@@ -8,11 +8,15 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/Expr.h"
+#include "klee/MemoryUsage.h"
+#include "klee/Internal/ADT/SizeClassPool.h"
 
 #include <cassert>
 
 using namespace klee;
 
+MemoryCounter klee::memory::updateNodes("UpdateNodes");
+
 ///
 
 UpdateNode::UpdateNode(const UpdateNode *_next, 
@@ -31,16 +35,28 @@ UpdateNode::UpdateNode(const UpdateNode *_next,
     size = 1 + next->size;
   }
   else size = 1;
+
+  memory::updateNodes.allocated(sizeof(*this));
 }
 
 extern "C" void vc_DeleteExpr(void*);
 
 UpdateNode::~UpdateNode() {
+  memory::updateNodes.freed(sizeof(*this));
+
   // XXX gross
   if (stpArray)
     ::vc_DeleteExpr(stpArray);
 }
 
+void *UpdateNode::operator new(size_t size) {
+  return getExprPool().allocate(size);
+}
+
+void UpdateNode::operator delete(void *p, size_t size) {
+  getExprPool().deallocate(p, size);
+}
+
 int UpdateNode::compare(const UpdateNode &b) const {
   if (int i = index.compare(b.index)) 
     return i;
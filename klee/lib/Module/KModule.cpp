@@ -646,6 +646,51 @@ static int getOperandNum(Value *v,
 }
 
 
+/// Returns the Expr::Kind that computes the given integer instruction
+/// natively, or Expr::InvalidKind if there is none.
+static Expr::Kind getConcreteKind(Instruction *inst, unsigned &width) {
+  if (!isa<BinaryOperator>(inst) && !isa<ICmpInst>(inst))
+    return Expr::InvalidKind;
+
+  IntegerType *type = dyn_cast<IntegerType>(inst->getOperand(0)->getType());
+  if (!type || type->getBitWidth() > 64)
+    return Expr::InvalidKind;
+  width = type->getBitWidth();
+
+  if (ICmpInst *ii = dyn_cast<ICmpInst>(inst)) {
+    switch (ii->getPredicate()) {
+    case ICmpInst::ICMP_EQ: return Expr::Eq;
+    case ICmpInst::ICMP_NE: return Expr::Ne;
+    case ICmpInst::ICMP_UGT: return Expr::Ugt;
+    case ICmpInst::ICMP_UGE: return Expr::Uge;
+    case ICmpInst::ICMP_ULT: return Expr::Ult;
+    case ICmpInst::ICMP_ULE: return Expr::Ule;
+    case ICmpInst::ICMP_SGT: return Expr::Sgt;
+    case ICmpInst::ICMP_SGE: return Expr::Sge;
+    case ICmpInst::ICMP_SLT: return Expr::Slt;
+    case ICmpInst::ICMP_SLE: return Expr::Sle;
+    default: return Expr::InvalidKind;
+    }
+  }
+
+  switch (inst->getOpcode()) {
+  case Instruction::Add: return Expr::Add;
+  case Instruction::Sub: return Expr::Sub;
+  case Instruction::Mul: return Expr::Mul;
+  case Instruction::UDiv: return Expr::UDiv;
+  case Instruction::SDiv: return Expr::SDiv;
+  case Instruction::URem: return Expr::URem;
+  case Instruction::SRem: return Expr::SRem;
+  case Instruction::And: return Expr::And;
+  case Instruction::Or: return Expr::Or;
+  case Instruction::Xor: return Expr::Xor;
+  case Instruction::Shl: return Expr::Shl;
+  case Instruction::LShr: return Expr::LShr;
+  case Instruction::AShr: return Expr::AShr;
+  default: return Expr::InvalidKind;
+  }
+}
+
 KFunction::KFunction(llvm::Function *_function,
                      KModule *km) 
   : function(_function),
@@ -697,6 +742,9 @@ KFunction::KFunction(llvm::Function *_function,
 
       ki->inst = it;
       ki->dest = registerMap[it];
+      ki->concreteWidth = 0;
+      ki->concreteKind = getConcreteKind(it, ki->concreteWidth);
+      ki->distanceNode = (unsigned) -1;
 
       if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
         CallSite cs(it);
@@ -16,6 +16,7 @@
 #include "klee/SolverImpl.h"
 
 #include "klee/SolverStats.h"
+#include "klee/MemoryUsage.h"
 
 #include <tr1/unordered_map>
 
@@ -68,7 +69,12 @@ private:
 
 public:
   CachingSolver(Solver *s) : solver(s) {}
-  ~CachingSolver() { cache.clear(); delete solver; }
+  ~CachingSolver() {
+    memory::solverCaches.freed(cache.size() * sizeof(cache_map::value_type),
+                               cache.size());
+    cache.clear();
+    delete solver;
+  }
 
   bool computeValidity(const Query&, Solver::Validity &result);
   bool computeTruth(const Query&, bool &isValid);
@@ -131,7 +137,8 @@ void CachingSolver::cacheInsert(const Query& query,
   IncompleteSolver::PartialValidity cachedResult = 
     (negationUsed ? IncompleteSolver::negatePartialValidity(result) : result);
   
-  cache.insert(std::make_pair(ce, cachedResult));
+  if (cache.insert(std::make_pair(ce, cachedResult)).second)
+    memory::solverCaches.allocated(sizeof(cache_map::value_type));
 }
 
 bool CachingSolver::computeValidity(const Query& query,
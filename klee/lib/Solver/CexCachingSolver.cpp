@@ -19,6 +19,7 @@
 #include "klee/Internal/ADT/MapOfSets.h"
 
 #include "klee/SolverStats.h"
+#include "klee/MemoryUsage.h"
 
 #include "llvm/Support/CommandLine.h"
 
@@ -59,6 +60,16 @@ class CexCachingSolver : public SolverImpl {
   // memo table
   assignmentsTable_ty assignmentsTable;
 
+  /// What this solver accounts for in memory::solverCaches, the keys
+  /// of the cache and the memoized assignments.
+  uint64_t accountedEntries, accountedBytes;
+
+  void account(uint64_t size) {
+    ++accountedEntries;
+    accountedBytes += size;
+    memory::solverCaches.allocated(size);
+  }
+
   bool searchForAssignment(KeyType &key, 
                            Assignment *&result);
   
@@ -72,7 +83,8 @@ class CexCachingSolver : public SolverImpl {
   bool getAssignment(const Query& query, Assignment *&result);
   
 public:
-  CexCachingSolver(Solver *_solver) : solver(_solver) {}
+  CexCachingSolver(Solver *_solver)
+    : solver(_solver), accountedEntries(0), accountedBytes(0) {}
   ~CexCachingSolver();
   
   bool computeTruth(const Query&, bool &isValid);
@@ -217,6 +229,12 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
     if (!res.second) {
       delete binding;
       binding = *res.first;
+    } else {
+      uint64_t size = sizeof(Assignment);
+      for (Assignment::bindings_ty::iterator it = binding->bindings.begin(),
+             ie = binding->bindings.end(); it != ie; ++it)
+        size += sizeof(*it) + it->second.size();
+      account(size);
     }
     
     if (DebugCexCacheCheckBinding)
@@ -228,6 +246,7 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
   
   result = binding;
   cache.insert(key, binding);
+  account(key.size() * sizeof(ref<Expr>));
 
   return true;
 }
@@ -235,6 +254,7 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
 ///
 
 CexCachingSolver::~CexCachingSolver() {
+  memory::solverCaches.freed(accountedBytes, accountedEntries);
   cache.clear();
   delete solver;
   for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
@@ -455,6 +455,42 @@ ExprHandle STPBuilder::construct(ref<Expr> e, int *width_out) {
 }
 
 
+/** Constructs the concatenation of byte reads of a single update list
+    that multi-byte loads produce, looking up the array once and without
+    constructing and caching every intermediate concatenation. Returns a
+    null handle if ce is not such a concatenation. */
+ExprHandle STPBuilder::constructReadSequence(const ConcatExpr *ce) {
+  std::vector<const ReadExpr*> reads;
+  ref<Expr> cur = const_cast<ConcatExpr*>(ce);
+  while (const ConcatExpr *c = dyn_cast<ConcatExpr>(cur)) {
+    const ReadExpr *re = dyn_cast<ReadExpr>(c->getKid(0));
+    if (!re)
+      return ExprHandle();
+    reads.push_back(re);
+    cur = c->getKid(1);
+  }
+
+  const ReadExpr *last = dyn_cast<ReadExpr>(cur);
+  if (!last)
+    return ExprHandle();
+  reads.push_back(last);
+
+  const UpdateList &ul = last->updates;
+  for (std::vector<const ReadExpr*>::iterator it = reads.begin(),
+         ie = reads.end(); it != ie; ++it) {
+    if ((*it)->updates.root != ul.root || (*it)->updates.head != ul.head)
+      return ExprHandle();
+  }
+
+  ::VCExpr array = getArrayForUpdate(ul.root, ul.head);
+  ExprHandle res = vc_readExpr(vc, array, construct(last->index, 0));
+  for (int i = reads.size() - 2; i >= 0; --i) {
+    ExprHandle byte = vc_readExpr(vc, array, construct(reads[i]->index, 0));
+    res = vc_bvConcatExpr(vc, byte, res);
+  }
+  return res;
+}
+
 /** if *width_out!=1 then result is a bitvector,
     otherwise it is a bool */
 ExprHandle STPBuilder::constructActual(ref<Expr> e, int *width_out) {
@@ -514,6 +550,11 @@ ExprHandle STPBuilder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::Concat: {
     ConcatExpr *ce = cast<ConcatExpr>(e);
+    if (ExprHandle res = constructReadSequence(ce)) {
+      *width_out = ce->getWidth();
+      return res;
+    }
+
     unsigned numKids = ce->getNumKids();
     ExprHandle res = construct(ce->getKid(numKids-1), 0);
     for (int i=numKids-2; i>=0; i--) {
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/SolverStats.h"
+#include "klee/MemoryUsage.h"
 
 using namespace klee;
 
@@ -21,3 +22,5 @@ Statistic stats::queryConstructTime("QueryConstructTime", "QBtime") ;
 Statistic stats::queryConstructs("QueriesConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
 Statistic stats::queryTime("QueryTime", "Qtime");
+
+MemoryCounter memory::solverCaches("SolverCaches");
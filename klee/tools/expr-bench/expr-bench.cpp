@@ -0,0 +1,160 @@
+//===-- expr-bench.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures the cost of building and freeing expressions and update lists
+// the way symbolic loads and stores do, and compares the allocator of
+// expressions with the global operator new on the same object sizes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Common.h"
+
+#include "klee/Expr.h"
+#include "klee/MemoryUsage.h"
+#include "klee/Internal/ADT/RNG.h"
+#include "klee/Internal/ADT/SizeClassPool.h"
+#include "klee/Internal/System/Time.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+  cl::opt<unsigned>
+  Operations("operations",
+             cl::desc("Number of loads and stores to build (default: 1000000)"),
+             cl::init(1000000));
+
+  cl::opt<unsigned>
+  StoresPerList("stores-per-list",
+                cl::desc("Stores after which the update list is dropped (default: 8)"),
+                cl::init(8));
+
+  cl::opt<unsigned>
+  LiveObjects("live-objects",
+              cl::desc("Objects kept alive by the allocator benchmark (default: 10000)"),
+              cl::init(10000));
+
+  cl::opt<unsigned>
+  Seed("seed", cl::init(1));
+}
+
+/// Builds a 32-bit little-endian load at offset, as ObjectState::read does
+static ref<Expr> buildLoad(const UpdateList &ul, unsigned offset) {
+  return ConcatExpr::create4(
+    ReadExpr::create(ul, ConstantExpr::alloc(offset + 3, Expr::Int32)),
+    ReadExpr::create(ul, ConstantExpr::alloc(offset + 2, Expr::Int32)),
+    ReadExpr::create(ul, ConstantExpr::alloc(offset + 1, Expr::Int32)),
+    ReadExpr::create(ul, ConstantExpr::alloc(offset, Expr::Int32)));
+}
+
+/// Writes the bytes of value at offset, as ObjectState::write does
+static void buildStore(UpdateList &ul, unsigned offset,
+                       const ref<Expr> &value) {
+  for (unsigned i = 0; i < 4; ++i)
+    ul.extend(ConstantExpr::alloc(offset + i, Expr::Int32),
+              ExtractExpr::create(value, 8 * i, Expr::Int8));
+}
+
+static void runExprs() {
+  RNG rng(Seed);
+  const unsigned size = 4096;
+  Array *array = new Array("mem", size);
+  int64_t chunkBytes = memory::exprPool.getBytes();
+
+  double start = util::getWallTime();
+  UpdateList *ul = new UpdateList(array, 0);
+  unsigned stores = 0;
+  for (unsigned i = 0; i < Operations; ++i) {
+    unsigned offset = rng.getInt32() % (size - 4);
+    ref<Expr> value = buildLoad(*ul, offset);
+    value = AddExpr::create(value, ConstantExpr::alloc(1, Expr::Int32));
+
+    offset = rng.getInt32() % (size - 4);
+    buildStore(*ul, offset, value);
+    if (++stores == StoresPerList) {
+      delete ul;
+      ul = new UpdateList(array, 0);
+      stores = 0;
+    }
+  }
+  delete ul;
+  double time = util::getWallTime() - start;
+
+  llvm::outs() << "Expr::create: " << Operations << " loads and stores in "
+               << time << "s (" << (time * 1e9 / Operations) << " ns/op), "
+               << (memory::exprPool.getBytes() - chunkBytes) / 1024
+               << " KB of new pool chunks\n";
+
+  delete array;
+}
+
+/// Allocates objects of the sizes of the common expressions, keeping
+/// LiveObjects of them alive and freeing the most recent ones more
+/// often, as reference counting does.
+template <class Allocator>
+static void runAllocator(const char *name, Allocator &allocator) {
+  const size_t sizes[] = {
+    sizeof(ConstantExpr), sizeof(ReadExpr), sizeof(ConcatExpr),
+    sizeof(ExtractExpr), sizeof(AddExpr), sizeof(UpdateNode)
+  };
+  const unsigned numSizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  RNG rng(Seed);
+  std::vector<std::pair<void*, size_t> > live;
+  live.reserve(LiveObjects + 1);
+
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < Operations; ++i) {
+    size_t size = sizes[rng.getInt32() % numSizes];
+    live.push_back(std::make_pair(allocator.allocate(size), size));
+    if (live.size() <= LiveObjects)
+      continue;
+
+    unsigned index = rng.getInt32() % live.size();
+    if (rng.getBool()) {
+      unsigned recent = std::min(8U, (unsigned) live.size());
+      index = live.size() - 1 - rng.getInt32() % recent;
+    }
+    allocator.deallocate(live[index].first, live[index].second);
+    live[index] = live.back();
+    live.pop_back();
+  }
+  for (unsigned i = 0; i < live.size(); ++i)
+    allocator.deallocate(live[i].first, live[i].second);
+  double time = util::getWallTime() - start;
+
+  llvm::outs() << name << ": " << Operations << " allocations in "
+               << time << "s (" << (time * 1e9 / Operations) << " ns/op)\n";
+}
+
+/// The allocation path expressions used before the pool
+struct GlobalAllocator {
+  void *allocate(size_t size) { return ::operator new(size); }
+  void deallocate(void *p, size_t) { ::operator delete(p); }
+};
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, " expression allocation benchmark\n");
+
+  runExprs();
+
+  GlobalAllocator global;
+  runAllocator("operator new", global);
+
+  SizeClassPool pool;
+  runAllocator("SizeClassPool", pool);
+
+  return 0;
+}
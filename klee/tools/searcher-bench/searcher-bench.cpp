@@ -0,0 +1,211 @@
+//===-- searcher-bench.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Drives priority-based searchers with synthetic state populations, to
+// measure the cost of selecting and reprioritizing states as the number
+// of live states grows. States are never executed, only their addresses
+// are used.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Common.h"
+
+#include "klee/Searcher.h"
+#include "klee/Internal/ADT/RNG.h"
+#include "klee/Internal/System/Time.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+  cl::list<unsigned>
+  Populations("states",
+              cl::desc("Number of live states to benchmark with (default: 1000,10000,100000)"),
+              cl::CommaSeparated);
+
+  cl::opt<unsigned>
+  Operations("operations",
+             cl::desc("Number of scheduling steps per population (default: 1000000)"),
+             cl::init(1000000));
+
+  cl::opt<double>
+  ForkRate("fork-rate",
+           cl::desc("Probability that a step forks the selected state (default: 0.05)"),
+           cl::init(0.05));
+
+  cl::opt<unsigned>
+  Seed("seed", cl::init(1));
+}
+
+/// Stands for the per-state data searchers look up to compute
+/// priorities (e.g. plugin states in S2E).
+typedef std::map<ExecutionState*, double> Metrics;
+
+/// Orders states on their metric, looking it up in every comparison,
+/// as searchers based on std::set and a comparator do.
+struct MetricSorter {
+  const Metrics *metrics;
+
+  MetricSorter(const Metrics *_metrics) : metrics(_metrics) {}
+
+  bool operator()(ExecutionState *a, ExecutionState *b) const {
+    double ma = metrics->find(a)->second;
+    double mb = metrics->find(b)->second;
+    if (ma == mb)
+      return a < b;
+    return ma < mb;
+  }
+};
+
+class MetricSearcher : public PrioritySearcher {
+  const Metrics &metrics;
+
+protected:
+  double getPriority(ExecutionState *es) {
+    return metrics.find(es)->second;
+  }
+
+public:
+  MetricSearcher(const Metrics &_metrics) : metrics(_metrics) {}
+};
+
+/// Interface shared by the benchmarked implementations
+class Scheduler {
+public:
+  virtual ~Scheduler() {}
+  virtual ExecutionState *select() = 0;
+  virtual void add(ExecutionState *es) = 0;
+  virtual void remove(ExecutionState *es) = 0;
+  /// The metric of es is about to change
+  virtual void beginChange(ExecutionState *es) = 0;
+  /// The metric of es has changed
+  virtual void endChange(ExecutionState *es) = 0;
+};
+
+class SetScheduler : public Scheduler {
+  std::set<ExecutionState*, MetricSorter> states;
+
+public:
+  SetScheduler(const Metrics &metrics) : states(MetricSorter(&metrics)) {}
+
+  ExecutionState *select() { return *states.begin(); }
+  void add(ExecutionState *es) { states.insert(es); }
+  void remove(ExecutionState *es) { states.erase(es); }
+  void beginChange(ExecutionState *es) { states.erase(es); }
+  void endChange(ExecutionState *es) { states.insert(es); }
+};
+
+class HeapScheduler : public Scheduler {
+  MetricSearcher searcher;
+
+public:
+  HeapScheduler(const Metrics &metrics) : searcher(metrics) {}
+
+  ExecutionState *select() { return &searcher.selectState(); }
+  void add(ExecutionState *es) { searcher.addState(es); }
+  void remove(ExecutionState *es) { searcher.removeState(es); }
+  void beginChange(ExecutionState *es) {}
+  void endChange(ExecutionState *es) { searcher.updatePriority(es); }
+};
+
+/// Fake state addresses, never dereferenced
+static ExecutionState *makeState(uintptr_t n) {
+  return reinterpret_cast<ExecutionState*>((n + 1) * 16);
+}
+
+static void run(const char *name, Scheduler *(*create)(const Metrics &),
+                unsigned population) {
+  RNG rng(Seed);
+  Metrics metrics;
+  Scheduler *scheduler = create(metrics);
+  std::vector<ExecutionState*> live;
+  uintptr_t next = 0;
+
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < population; ++i) {
+    ExecutionState *es = makeState(next++);
+    metrics[es] = rng.getInt32() % 1024;
+    scheduler->add(es);
+    live.push_back(es);
+  }
+  double populateTime = util::getWallTime() - start;
+
+  unsigned forks = 0, kills = 0;
+  start = util::getWallTime();
+  for (unsigned i = 0; i < Operations; ++i) {
+    ExecutionState *current = scheduler->select();
+    double p = rng.getDoubleL();
+
+    if (p < ForkRate) {
+      // Fork: the child is added, the parent's metric changes
+      ExecutionState *es = makeState(next++);
+      metrics[es] = rng.getInt32() % 1024;
+      scheduler->add(es);
+      live.push_back(es);
+      ++forks;
+    } else if (p < 2 * ForkRate && live.size() > 1) {
+      // Kill a random state to keep the population stable
+      unsigned index = rng.getInt32() % live.size();
+      ExecutionState *es = live[index];
+      live[index] = live.back();
+      live.pop_back();
+      scheduler->remove(es);
+      metrics.erase(es);
+      ++kills;
+      continue;
+    }
+
+    scheduler->beginChange(current);
+    metrics[current] += 1 + rng.getInt32() % 64;
+    scheduler->endChange(current);
+  }
+  double stepTime = util::getWallTime() - start;
+
+  llvm::outs() << name << ": " << population << " states, "
+               << "populate " << populateTime << "s, "
+               << Operations << " steps in " << stepTime << "s ("
+               << (stepTime * 1e9 / Operations) << " ns/step), "
+               << forks << " forks, " << kills << " kills\n";
+
+  delete scheduler;
+}
+
+static Scheduler *createSet(const Metrics &metrics) {
+  return new SetScheduler(metrics);
+}
+
+static Scheduler *createHeap(const Metrics &metrics) {
+  return new HeapScheduler(metrics);
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, " searcher benchmark\n");
+
+  std::vector<unsigned> populations(Populations.begin(), Populations.end());
+  if (populations.empty()) {
+    populations.push_back(1000);
+    populations.push_back(10000);
+    populations.push_back(100000);
+  }
+
+  for (std::vector<unsigned>::iterator it = populations.begin(),
+         ie = populations.end(); it != ie; ++it) {
+    run("std::set", createSet, *it);
+    run("PrioritySearcher", createHeap, *it);
+  }
+
+  return 0;
+}
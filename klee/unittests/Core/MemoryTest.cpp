@@ -0,0 +1,180 @@
+//===-- MemoryTest.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Context.h"
+#include "klee/Expr.h"
+#include "klee/Memory.h"
+
+using namespace klee;
+
+namespace {
+
+/// Checks that every read in e indexes its array with 32 bits
+void checkReadIndices(const ref<Expr> &e) {
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e))
+    EXPECT_EQ(32U, re->index->getWidth());
+  for (unsigned i = 0; i < e->getNumKids(); ++i)
+    checkReadIndices(e->getKid(i));
+}
+
+TEST(MemoryTest, SymbolicOffsetRead) {
+  Context::initialize(true, Expr::Int64);
+
+  MemoryObject *mo = new MemoryObject(0x1000, 16, false, false, false, 0);
+  ObjectState *os = new ObjectState(mo);
+  os->initializeToZero();
+
+  Array *array = new Array("offset", 8);
+  ref<Expr> offset = Expr::createTempRead(array, Expr::Int64);
+  ASSERT_EQ(64U, offset->getWidth());
+
+  // Empty update list
+  ref<Expr> res = os->read(offset, Expr::Int32);
+  EXPECT_EQ(32U, res->getWidth());
+  checkReadIndices(res);
+
+  // Non-empty update list, with a symbolic index
+  os->write(offset, ConstantExpr::alloc(0xab, Expr::Int8));
+  res = os->read(offset, Expr::Int32);
+  EXPECT_EQ(32U, res->getWidth());
+  checkReadIndices(res);
+
+  delete os;
+  delete mo;
+  delete array;
+}
+
+/// Reads width bits at offset one byte at a time, as ObjectState::read
+/// does when it cannot read the whole range at once
+ref<Expr> readBytes(const ObjectState *os, unsigned offset,
+                    Expr::Width width) {
+  unsigned NumBytes = width / 8;
+  ref<Expr> Res(0);
+  for (unsigned i = 0; i != NumBytes; ++i) {
+    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+    ref<Expr> Byte = os->read8(offset + idx);
+    Res = i ? ConcatExpr::create(Byte, Res) : Byte;
+  }
+  return Res;
+}
+
+/// Checks that the bytes of e are reads at consecutive constant indices
+bool isReadSequence(const ref<Expr> &e) {
+  ref<Expr> cur = e;
+  while (const ConcatExpr *ce = dyn_cast<ConcatExpr>(cur)) {
+    if (!isa<ReadExpr>(ce->getKid(0)))
+      return false;
+    cur = ce->getKid(1);
+  }
+  return isa<ReadExpr>(cur);
+}
+
+TEST(MemoryTest, ConstantOffsetSymbolicRead) {
+  MemoryObject *mo = new MemoryObject(0x1000, 16, false, false, false, 0);
+  Array *array = new Array("object", 16);
+  Array *offsetArray = new Array("offset", 8);
+  Array *valueArray = new Array("value", 1);
+  ref<Expr> offset = Expr::createTempRead(offsetArray, Expr::Int64);
+  ref<Expr> value = Expr::createTempRead(valueArray, Expr::Int8);
+
+  // Fully symbolic object
+  ObjectState *os = new ObjectState(mo, array);
+  ref<Expr> res = os->read(4, Expr::Int32);
+  EXPECT_TRUE(isReadSequence(res));
+  EXPECT_EQ(readBytes(os, 4, Expr::Int32), res);
+
+  // Write at a constant index inside the range, flushed by a read at a
+  // symbolic offset: the written byte must be folded
+  os->write(5, value);
+  os->read(offset, Expr::Int8);
+  res = os->read(4, Expr::Int32);
+  EXPECT_EQ(readBytes(os, 4, Expr::Int32), res);
+  EXPECT_EQ(value, os->read8(5));
+
+  // Write at a symbolic index ahead of the constant ones: nothing can be
+  // folded any more, the whole range is read from the update list
+  os->write(offset, ConstantExpr::alloc(0xab, Expr::Int8));
+  res = os->read(4, Expr::Int32);
+  EXPECT_TRUE(isReadSequence(res));
+  EXPECT_EQ(readBytes(os, 4, Expr::Int32), res);
+  delete os;
+
+  // Concrete and known symbolic bytes in the range
+  os = new ObjectState(mo, array);
+  os->write8(9, 0x12);
+  os->write(10, value);
+  for (unsigned i = 6; i != 12; ++i) {
+    res = os->read(i, Expr::Int32);
+    EXPECT_EQ(readBytes(os, i, Expr::Int32), res);
+  }
+  res = os->read(8, Expr::Int16);
+  EXPECT_EQ(readBytes(os, 8, Expr::Int16), res);
+  EXPECT_FALSE(isReadSequence(res));
+
+  // Same after a write at a symbolic index flushed them
+  os->write(offset, value);
+  for (unsigned i = 6; i != 12; ++i) {
+    res = os->read(i, Expr::Int32);
+    EXPECT_TRUE(isReadSequence(res));
+    EXPECT_EQ(readBytes(os, i, Expr::Int32), res);
+  }
+
+  delete os;
+  delete mo;
+  delete valueArray;
+  delete offsetArray;
+  delete array;
+}
+
+const ObjectState *loadedObject;
+
+void loadObject(const ObjectState *os) {
+  loadedObject = os;
+  uint8_t *store = const_cast<ObjectState*>(os)->allocateConcreteStore();
+  for (unsigned i = 0; i < os->size; ++i)
+    store[i] = i;
+}
+
+TEST(MemoryTest, ReleasedStoreLoader) {
+  MemoryObject *mo = new MemoryObject(0x1000, 16, false, false, false, 0);
+  ObjectState *os = new ObjectState(mo);
+  os->initializeToZero();
+
+  ObjectState::releasedStoreLoader = &loadObject;
+  loadedObject = 0;
+
+  // Reads reload the contents
+  os->releaseConcreteStore();
+  EXPECT_TRUE(os->isConcreteStoreReleased());
+  uint8_t value;
+  EXPECT_TRUE(os->readConcrete8(5, &value));
+  EXPECT_EQ(os, loadedObject);
+  EXPECT_EQ(5U, value);
+
+  // So do writes and copies
+  os->releaseConcreteStore();
+  os->write8(0, 0xff);
+  EXPECT_FALSE(os->isConcreteStoreReleased());
+  EXPECT_EQ(0xffU, os->getConcreteStore()[0]);
+  EXPECT_EQ(1U, os->getConcreteStore()[1]);
+
+  os->releaseConcreteStore();
+  ObjectState *copy = new ObjectState(*os);
+  EXPECT_FALSE(os->isConcreteStoreReleased());
+  EXPECT_EQ(15U, copy->getConcreteStore()[15]);
+
+  ObjectState::releasedStoreLoader = 0;
+  delete copy;
+  delete os;
+  delete mo;
+}
+
+}
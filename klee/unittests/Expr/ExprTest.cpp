@@ -8,9 +8,12 @@
 //===----------------------------------------------------------------------===//
 
 #include <iostream>
+#include <vector>
 #include "gtest/gtest.h"
 
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/SizeClassPool.h"
+#include "klee/Internal/Support/IntEvaluation.h"
 
 using namespace klee;
 
@@ -110,4 +113,89 @@ TEST(ExprTest, ExtractConcat) {
   EXPECT_EQ(Expr::Extract, concat2->getKid(1)->getKind());
 }
 
+TEST(ExprTest, NativeEvaluation) {
+  const Expr::Width widths[] = { 1, 8, 16, 32, 64 };
+  const uint64_t values[] = { 0, 1, 2, 7, 0x80, 0xff, 0x8000, 0x80000000,
+                              0x123456789abcdefULL, 0x8000000000000000ULL,
+                              ~0ULL };
+  const unsigned numValues = sizeof(values) / sizeof(values[0]);
+
+  for (unsigned w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+    Expr::Width width = widths[w];
+    for (unsigned i = 0; i < numValues; ++i) {
+      for (unsigned j = 0; j < numValues; ++j) {
+        ref<ConstantExpr> l = ConstantExpr::create(
+            bits64::truncateToNBits(values[i], width), width);
+        ref<ConstantExpr> r = ConstantExpr::create(
+            bits64::truncateToNBits(values[j], width), width);
+
+        for (int k = Expr::BinaryKindFirst; k <= Expr::BinaryKindLast; ++k) {
+          if (k == Expr::Not)
+            continue;
+
+          uint64_t result;
+          if (!ints::evaluate((Expr::Kind) k, l->getZExtValue(),
+                              r->getZExtValue(), width, result))
+            continue;
+
+          std::vector<Expr::CreateArg> args;
+          args.push_back(Expr::CreateArg(l));
+          args.push_back(Expr::CreateArg(r));
+          ref<Expr> expected = Expr::createFromKind((Expr::Kind) k, args);
+
+          ASSERT_EQ(Expr::Constant, expected->getKind());
+          EXPECT_EQ(cast<ConstantExpr>(expected)->getZExtValue(), result);
+        }
+      }
+    }
+  }
+}
+
+TEST(ExprTest, PoolReuse) {
+  SizeClassPool pool;
+
+  // Objects of the same size class are reused, in LIFO order
+  void *a = pool.allocate(20);
+  void *b = pool.allocate(24);
+  EXPECT_NE(a, b);
+  pool.deallocate(a, 20);
+  EXPECT_EQ(a, pool.allocate(17));
+  pool.deallocate(b, 24);
+  EXPECT_NE(b, pool.allocate(32));
+  EXPECT_EQ(b, pool.allocate(24));
+
+  // Large objects bypass the pool
+  void *large = pool.allocate(SizeClassPool::MaxSize + 1);
+  pool.deallocate(large, SizeClassPool::MaxSize + 1);
+  EXPECT_EQ((size_t) SizeClassPool::ChunkSize, pool.getChunkBytes());
+
+  // Empty chunks are given back, and their objects are not reused
+  std::vector<void*> objects;
+  while (pool.getChunkBytes() < 4 * SizeClassPool::MinTrimChunks *
+                                SizeClassPool::ChunkSize)
+    objects.push_back(pool.allocate(SizeClassPool::MaxSize));
+  for (unsigned i = 0; i < objects.size(); ++i)
+    pool.deallocate(objects[i], SizeClassPool::MaxSize);
+  EXPECT_GE((SizeClassPool::MinTrimChunks + 1) * SizeClassPool::ChunkSize,
+            pool.getChunkBytes());
+
+  size_t chunkBytes = pool.getChunkBytes();
+  objects.clear();
+  for (unsigned i = 0; i < 100; ++i)
+    objects.push_back(pool.allocate(SizeClassPool::MaxSize));
+  EXPECT_EQ(chunkBytes, pool.getChunkBytes());
+  for (unsigned i = 0; i < objects.size(); ++i)
+    pool.deallocate(objects[i], SizeClassPool::MaxSize);
+
+  // Expressions come from the expression pool
+  unsigned count = Expr::count;
+  Array *array = new Array("arr", 256);
+  {
+    ref<Expr> read = Expr::createTempRead(array, 32);
+    EXPECT_LT(count, Expr::count);
+    EXPECT_LT(0U, getExprPool().getChunkBytes());
+  }
+  EXPECT_EQ(count, Expr::count);
+}
+
 }
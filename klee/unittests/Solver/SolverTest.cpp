@@ -123,6 +123,87 @@ void testOpcode(Solver &solver, bool tryBool = true, bool tryZero = true,
   }
 }
 
+/// Builds the concatenation of the reads of the 4 bytes of ul at offset
+/// that ObjectState produces for a load of symbolic data. With
+/// notOptimized, the bytes are hidden from the read sequence lowering of
+/// STPBuilder, which then lowers the concatenation one kid at a time.
+ref<Expr> readSequence(const UpdateList &ul, unsigned offset,
+                       bool notOptimized) {
+  ref<Expr> res(0);
+  for (unsigned i = 0; i != 4; ++i) {
+    ref<Expr> byte = ReadExpr::alloc(ul, ConstantExpr::alloc(offset + i,
+                                                             Expr::Int32));
+    if (notOptimized)
+      byte = NotOptimizedExpr::create(byte);
+    res = i ? ConcatExpr::create(byte, res) : byte;
+  }
+  return res;
+}
+
+void testReadSequence(Solver &solver, const UpdateList &ul) {
+  ref<Expr> seq = readSequence(ul, 2, false);
+  ref<Expr> generic = readSequence(ul, 2, true);
+  ConstraintManager noConstraints;
+  bool res;
+
+  bool success = solver.mustBeTrue(Query(noConstraints,
+                                         EqExpr::create(seq, generic)), res);
+  EXPECT_EQ(true, success) << "Constraint solving failed";
+  if (success)
+    EXPECT_EQ(true, res) << "Lowerings differ for " << seq;
+
+  const uint64_t values[] = { 0, 0x1234ab78 };
+  for (unsigned i = 0; i < sizeof(values)/sizeof(values[0]); i++) {
+    ref<Expr> value = ConstantExpr::alloc(values[i], Expr::Int32);
+
+    bool seqRes, genericRes;
+    ASSERT_TRUE(solver.mayBeTrue(Query(noConstraints,
+                                       EqExpr::create(value, seq)), seqRes));
+    ASSERT_TRUE(solver.mayBeTrue(Query(noConstraints,
+                                       EqExpr::create(value, generic)),
+                                 genericRes));
+    EXPECT_EQ(seqRes, genericRes) << "query " << seq << " == " << value;
+    if (!seqRes)
+      continue;
+
+    // A value of one lowering is a value of the other one (the
+    // evaluator cannot fold the NotOptimizedExpr of the generic one)
+    ConstraintManager constraints;
+    constraints.addConstraint(EqExpr::create(value, generic));
+    ref<ConstantExpr> result;
+    ASSERT_TRUE(solver.getValue(Query(constraints, seq), result));
+    EXPECT_EQ(values[i], result->getZExtValue());
+  }
+}
+
+TEST(SolverTest, ReadSequence) {
+  STPSolver *solver = new STPSolver(true);
+  Array *array = new Array("mem", 8);
+  Array *indexArray = new Array("index", 4);
+
+  // The STP expressions cached in the arrays and the update nodes must
+  // be freed before the solver.
+  {
+    // Untouched symbolic data
+    UpdateList ul(array, 0);
+    testReadSequence(*solver, ul);
+
+    // A write at a constant index inside the range
+    ul.extend(ConstantExpr::alloc(3, Expr::Int32),
+              ConstantExpr::alloc(0xab, Expr::Int8));
+    testReadSequence(*solver, ul);
+
+    // A write at a symbolic index ahead of it
+    ul.extend(Expr::createTempRead(indexArray, Expr::Int32),
+              ConstantExpr::alloc(0xcd, Expr::Int8));
+    testReadSequence(*solver, ul);
+  }
+
+  delete indexArray;
+  delete array;
+  delete solver;
+}
+
 TEST(SolverTest, Evaluation) {
   STPSolver *stpSolver = new STPSolver(true); 
   Solver *solver = stpSolver;
@@ -289,6 +289,8 @@ extern unsigned long reserved_va;
 
 #else /* CONFIG_S2E */
 
+/* The concrete mask of an ObjectState is null as long as the whole object
+   is concrete, which makes the common case a single test. */
 static inline int _s2e_check_concrete(void *objectState,
                                       target_ulong offset, int size)
 {
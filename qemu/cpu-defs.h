@@ -159,11 +159,15 @@ typedef struct S2ETLBEntry {
     uintptr_t addend;
 } S2ETLBEntry;
 
+/* The table is large enough for the smallest RAM objects, only the
+   first CPU_S2E_TLB_SIZE entries are used for the chosen ones. */
 #define CPU_S2E_TLB_BITS (CPU_TLB_BITS + TARGET_PAGE_BITS - S2E_RAM_OBJECT_BITS)
 #define CPU_S2E_TLB_SIZE (1 << CPU_S2E_TLB_BITS)
+#define CPU_S2E_TLB_MAX_SIZE \
+    (1 << (CPU_TLB_BITS + TARGET_PAGE_BITS - S2E_RAM_OBJECT_MIN_BITS))
 
 #define _CPU_COMMON_S2E_TLB_TABLE \
-    S2ETLBEntry s2e_tlb_table[NB_MMU_MODES][CPU_S2E_TLB_SIZE];
+    S2ETLBEntry s2e_tlb_table[NB_MMU_MODES][CPU_S2E_TLB_MAX_SIZE];
 
 #else
 #define _CPU_COMMON_S2E_TLB_TABLE
@@ -1140,6 +1140,10 @@ TranslationBlock *tb_gen_code(CPUArchState *env,
         phys_page2 = get_page_addr_code(env, virt_page2);
     }
     tb_link_page(tb, phys_pc, phys_page2);
+
+#ifdef CONFIG_S2E
+    s2e_on_translation_complete(g_s2e, env, tb);
+#endif
     return tb;
 }
 
@@ -693,7 +693,7 @@ int S2ELUAExecutionState::writeMemorySymb(lua_State *L)
 }
 
 #ifdef TARGET_ARM
-static bool RegNameToIndex(const std::string &regstr, uint32_t &regIndex, uint32 &size)
+bool RegNameToIndex(const std::string &regstr, uint32_t &regIndex, uint32_t &size)
 {
     if (regstr == "r0") {
         regIndex = 0;
@@ -758,7 +758,7 @@ static bool RegNameToIndex(const std::string &regstr, uint32_t &regIndex, uint32
     return true;
 }
 #elif defined(TARGET_I386)
-static bool RegNameToIndex(const std::string &regstr, uint32_t &regIndex, uint32 &size)
+bool RegNameToIndex(const std::string &regstr, uint32_t &regIndex, uint32_t &size)
 {
     if (regstr == "eax") {
         regIndex = R_EAX;
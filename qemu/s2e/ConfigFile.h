@@ -382,6 +382,10 @@ public:
 
 };
 
+/** Maps a register name used in Lua scripts (e.g., "eax") to its
+    index in the CPU register file and its size in bytes */
+bool RegNameToIndex(const std::string &regstr, uint32_t &regIndex, uint32_t &size);
+
 } // namespace s2e
 
 #endif
@@ -0,0 +1,157 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2E_COW_CONTAINERS_H
+#define S2E_COW_CONTAINERS_H
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace s2e {
+
+/**
+ *  Wraps a standard container so that copies share the same content until
+ *  one of them is modified. Copying a wrapper is O(1), which makes it
+ *  suitable for the fields of plugin states that are cloned on every fork.
+ *
+ *  Reads go through get() or operator->() and never copy.
+ *  Modifications must go through write(), which first makes a private
+ *  copy of the content if it is shared with another wrapper.
+ *  References and iterators obtained from get() are invalidated by
+ *  the next call to write().
+ */
+template <typename Container>
+class CowContainer
+{
+private:
+    struct Body {
+        unsigned refCount;
+        Container data;
+
+        Body(): refCount(1) {}
+        Body(const Container &c): refCount(1), data(c) {}
+    };
+
+    Body *m_body;
+
+    void release() {
+        assert(m_body->refCount > 0);
+        if (--m_body->refCount == 0) {
+            delete m_body;
+        }
+    }
+
+public:
+    CowContainer(): m_body(new Body()) {}
+
+    CowContainer(const Container &c): m_body(new Body(c)) {}
+
+    CowContainer(const CowContainer &other): m_body(other.m_body) {
+        ++m_body->refCount;
+    }
+
+    ~CowContainer() {
+        release();
+    }
+
+    CowContainer &operator=(const CowContainer &other) {
+        ++other.m_body->refCount;
+        release();
+        m_body = other.m_body;
+        return *this;
+    }
+
+    const Container &get() const {
+        return m_body->data;
+    }
+
+    const Container *operator->() const {
+        return &m_body->data;
+    }
+
+    Container &write() {
+        if (m_body->refCount > 1) {
+            Body *body = new Body(m_body->data);
+            release();
+            m_body = body;
+        }
+        return m_body->data;
+    }
+
+    bool isShared() const {
+        return m_body->refCount > 1;
+    }
+};
+
+template <typename T>
+class CowVector: public CowContainer<std::vector<T> >
+{
+public:
+    CowVector() {}
+
+    CowVector(const std::vector<T> &v):
+        CowContainer<std::vector<T> >(v) {}
+
+    explicit CowVector(size_t count, const T &value = T()):
+        CowContainer<std::vector<T> >(std::vector<T>(count, value)) {}
+};
+
+template <typename K, typename V, typename Compare = std::less<K> >
+class CowMap: public CowContainer<std::map<K, V, Compare> >
+{
+public:
+    CowMap() {}
+
+    CowMap(const std::map<K, V, Compare> &m):
+        CowContainer<std::map<K, V, Compare> >(m) {}
+};
+
+template <typename K, typename Compare = std::less<K> >
+class CowSet: public CowContainer<std::set<K, Compare> >
+{
+public:
+    CowSet() {}
+
+    CowSet(const std::set<K, Compare> &s):
+        CowContainer<std::set<K, Compare> >(s) {}
+};
+
+}
+
+#endif
@@ -9,17 +9,24 @@
 
 namespace s2e {
 
-template <class T, unsigned OBJSIZE_BITS, unsigned PAGESIZE_BITS, unsigned SUPERPAGESIZE_BITS>
+//Maps the objects of a host memory region. The object size is given
+//when the region is registered, so that it can be chosen at startup.
+template <class T, unsigned PAGESIZE_BITS, unsigned SUPERPAGESIZE_BITS>
 class MemoryCache
 {
 private:
     struct ThirdLevel {
-        T level3[1<<(PAGESIZE_BITS-OBJSIZE_BITS)];
-        ThirdLevel() {
-            for (unsigned i=0; i<(1<<(PAGESIZE_BITS-OBJSIZE_BITS)); ++i) {
+        T *level3;
+        ThirdLevel(unsigned count) {
+            level3 = new T[count];
+            for (unsigned i=0; i<count; ++i) {
                 level3[i] = T();
             }
         }
+
+        ~ThirdLevel() {
+            delete [] level3;
+        }
     };
 
     struct SecondLevel {
@@ -45,6 +52,7 @@ private:
     uint64_t m_hostAddrStart;
     uint64_t m_size;
     unsigned m_pagecount;
+    unsigned m_objSizeBits;
 
     inline void resize()
     {
@@ -62,10 +70,12 @@ private:
     }
 
 public:
-    MemoryCache(uint64_t hostAddrStart, uint64_t size)
+    MemoryCache(uint64_t hostAddrStart, uint64_t size, unsigned objSizeBits)
     {
+        assert(objSizeBits <= PAGESIZE_BITS);
         m_hostAddrStart = hostAddrStart;
         m_size = size;
+        m_objSizeBits = objSizeBits;
         resize();
     }
 
@@ -73,6 +83,7 @@ public:
     MemoryCache(const MemoryCache &one) {
         m_hostAddrStart = one.m_hostAddrStart;
         m_size = one.m_size;
+        m_objSizeBits = one.m_objSizeBits;
         resize();
     }
 
@@ -106,7 +117,7 @@ public:
         uint64_t offset = hostAddress - m_hostAddrStart;
         uint64_t level1 = offset >> SUPERPAGESIZE_BITS;
         uint64_t level2 = (offset & ((1<<SUPERPAGESIZE_BITS)-1)) >> PAGESIZE_BITS;
-        uint64_t level3 = (offset >> OBJSIZE_BITS) & ((1<<(PAGESIZE_BITS-OBJSIZE_BITS))-1);
+        uint64_t level3 = (offset >> m_objSizeBits) & ((1<<(PAGESIZE_BITS-m_objSizeBits))-1);
 
         SecondLevel *ptrLevel2;
         if (!(ptrLevel2 = m_level1[level1])) {
@@ -116,11 +127,11 @@ public:
 
         ThirdLevel *ptrLevel3;
         if (!(ptrLevel3 = ptrLevel2->level2[level2])) {
-            ptrLevel3 = new ThirdLevel();
+            ptrLevel3 = new ThirdLevel(1<<(PAGESIZE_BITS-m_objSizeBits));
             ptrLevel2->level2[level2] = ptrLevel3;
         }
 
-        assert(level3 < (1<<(PAGESIZE_BITS-OBJSIZE_BITS)));
+        assert(level3 < (1<<(PAGESIZE_BITS-m_objSizeBits)));
 
         ptrLevel3->level3[level3] = obj;
     }
@@ -130,7 +141,7 @@ public:
         uint64_t offset = hostAddress - m_hostAddrStart;
         uint64_t level1 = offset >> SUPERPAGESIZE_BITS;
         uint64_t level2 = (offset & ((1<<SUPERPAGESIZE_BITS)-1)) >> PAGESIZE_BITS;
-        uint64_t level3 = (offset >> OBJSIZE_BITS) & ((1<<(PAGESIZE_BITS-OBJSIZE_BITS))-1);
+        uint64_t level3 = (offset >> m_objSizeBits) & ((1<<(PAGESIZE_BITS-m_objSizeBits))-1);
 
         SecondLevel *ptrLevel2;
         if (!(ptrLevel2 = m_level1[level1])) {
@@ -165,11 +176,11 @@ public:
     }
 };
 
-template <class T, unsigned OBJSIZE_BITS, unsigned PAGESIZE_BITS, unsigned SUPERPAGESIZE_BITS>
+template <class T, unsigned PAGESIZE_BITS, unsigned SUPERPAGESIZE_BITS>
 class MemoryCachePool
 {
 private:
-    typedef MemoryCache<T,OBJSIZE_BITS,PAGESIZE_BITS,SUPERPAGESIZE_BITS> MemoryCacheT;
+    typedef MemoryCache<T,PAGESIZE_BITS,SUPERPAGESIZE_BITS> MemoryCacheT;
     typedef llvm::SmallVector<MemoryCacheT*, 10> Caches;
     Caches m_caches;
 
@@ -204,10 +215,10 @@ public:
     //We sort the cache be decreasing size.
     //The idea is that most accesses fall in the RAM, so it will
     //be found first in the list.
-    void registerPool(uint64_t hostAddrStart, uint64_t size)
+    void registerPool(uint64_t hostAddrStart, uint64_t size, unsigned objSizeBits)
     {
         assert((hostAddrStart & ((1<<PAGESIZE_BITS)-1)) == 0);
-        MemoryCacheT *mc = new MemoryCacheT(hostAddrStart, size);
+        MemoryCacheT *mc = new MemoryCacheT(hostAddrStart, size, objSizeBits);
         if (m_caches.size() == 0) {
             m_caches.push_back(mc);
             return;
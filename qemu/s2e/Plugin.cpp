@@ -47,6 +47,8 @@ using namespace std;
 
 CompiledPlugin::CompiledPlugins* CompiledPlugin::s_compiledPlugins = NULL;
 
+klee::MemoryCounter memory::pluginStates("PluginStates");
+
 void Plugin::initialize()
 {
 }
@@ -42,9 +42,15 @@
 #include <map>
 #include <set>
 #include <s2e/Signals/Signals.h>
+#include <klee/MemoryUsage.h>
 
 namespace s2e {
 
+namespace memory {
+    /** Plugin states are only counted, their size is not known */
+    extern klee::MemoryCounter pluginStates;
+}
+
 class S2E;
 struct PluginInfo;
 class PluginState;
@@ -103,7 +109,9 @@ public:
 class PluginState
 {
 public:
-    virtual ~PluginState() {};
+    PluginState() { memory::pluginStates.allocated(0); }
+    PluginState(const PluginState&) { memory::pluginStates.allocated(0); }
+    virtual ~PluginState() { memory::pluginStates.freed(0); };
     virtual PluginState *clone() const = 0;
 };
 
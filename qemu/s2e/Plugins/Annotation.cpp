@@ -46,6 +46,9 @@ extern "C" {
 #include <s2e/ConfigFile.h>
 #include <s2e/Utils.h>
 
+#include <klee/Internal/System/Time.h>
+
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -103,7 +106,14 @@ void Annotation::initialize()
 
 Annotation::~Annotation()
 {
+    llvm::raw_ostream &os = s2e()->getMessagesStream();
     foreach2(it, m_entries.begin(), m_entries.end()) {
+        const AnnotationCfgEntry *e = *it;
+        if (e->hitCount) {
+            os << "Annotation: " << e->cfgname << " hits=" << e->hitCount
+               << " luaCalls=" << e->luaCallCount
+               << " time=" << e->totalTime << "s\n";
+        }
         delete *it;
     }
 }
@@ -190,6 +200,7 @@ bool Annotation::initSection(const std::string &entry, const std::string &cfgnam
 
     // Check if this is a call or an instruction annotation
     e.annotation = "";
+    ok = false;
     if (std::find(cfgkeys.begin(), cfgkeys.end(), "callAnnotation") != cfgkeys.end())	{
         e.annotation = cfg->getString(entry + ".callAnnotation", e.annotation, &ok);
         e.isCallAnnotation = true;
@@ -198,12 +209,23 @@ bool Annotation::initSection(const std::string &entry, const std::string &cfgnam
         e.isCallAnnotation = false;
     }
 
-    // Assert that this is a properly attached annotation
-    if (!ok || e.annotation=="") {
+    // Assert that this is a properly attached annotation.
+    // The Lua function may be left empty if native actions do all the work.
+    if (!ok) {
         os << "You must specify either " << entry << ".callAnnotation or .instructionAnnotation!" << '\n';
         return false;
     }
 
+    if (!initActions(entry, e)) {
+        //initActions reported the error
+        return false;
+    }
+
+    if (e.annotation=="" && e.actions.empty()) {
+        os << "You must specify a Lua function or " << entry << ".actions!" << '\n';
+        return false;
+    }
+
     // Get additional annotation-specific options
     e.paramCount = 0;
     e.beforeInstruction = false;
@@ -227,6 +249,150 @@ bool Annotation::initSection(const std::string &entry, const std::string &cfgnam
     return true;
 }
 
+/**
+ *  Parses the optional actions table of an annotation:
+ *
+ *  actions = {
+ *      a1 = { type="symbolicRegister", register="eax", name="ret", onReturn=true },
+ *      a2 = { type="symbolicMemory", register="ecx", size=16, name="buf" },
+ *      a3 = { type="concretizeRegister", register="edx" },
+ *      a4 = { type="kill", register="eax", value=0, message="failed" },
+ *      a5 = { type="skip", returnValue=0 },
+ *  }
+ *
+ *  Actions are executed in the order of their keys.
+ */
+bool Annotation::initActions(const std::string &entry, AnnotationCfgEntry &e)
+{
+    ConfigFile *cfg = s2e()->getConfig();
+    llvm::raw_ostream &os  = s2e()->getWarningsStream();
+    std::string actionsKey = entry + ".actions";
+    bool ok;
+
+    if (!cfg->hasKey(actionsKey)) {
+        return true;
+    }
+
+    std::vector<std::string> keys = cfg->getListKeys(actionsKey, &ok);
+    if (!ok) {
+        os << actionsKey << " must be a table!" << '\n';
+        return false;
+    }
+
+    std::sort(keys.begin(), keys.end());
+
+    foreach2(it, keys.begin(), keys.end()) {
+        std::string ak = actionsKey + "." + *it;
+        AnnotationAction a;
+
+        std::string type = cfg->getString(ak + ".type", "", &ok);
+        if (!ok) {
+            os << "You must specify the type of " << ak << '\n';
+            return false;
+        }
+
+        if (type == "symbolicRegister") {
+            a.type = AnnotationAction::SYMBOLIC_REGISTER;
+        } else if (type == "symbolicMemory") {
+            a.type = AnnotationAction::SYMBOLIC_MEMORY;
+        } else if (type == "concretizeRegister") {
+            a.type = AnnotationAction::CONCRETIZE_REGISTER;
+        } else if (type == "skip") {
+            a.type = AnnotationAction::SKIP;
+        } else if (type == "kill") {
+            a.type = AnnotationAction::KILL;
+        } else {
+            os << "Unknown action type " << type << " in " << ak << '\n';
+            return false;
+        }
+
+        if (cfg->hasKey(ak + ".register")) {
+            std::string reg = cfg->getString(ak + ".register");
+            if (!RegNameToIndex(reg, a.regIndex, a.regSize)) {
+                os << "Invalid register " << reg << " in " << ak << '\n';
+                return false;
+            }
+            if (CPU_REG_OFFSET(a.regIndex) >= CPU_CONC_LIMIT) {
+                os << "The program counter cannot be used in " << ak << '\n';
+                return false;
+            }
+            a.hasRegister = true;
+        }
+
+        if (cfg->hasKey(ak + ".onReturn")) {
+            a.onReturn = cfg->getBool(ak + ".onReturn");
+        }
+
+        if (a.onReturn && !e.isCallAnnotation) {
+            os << ak << ".onReturn is only valid for call annotations" << '\n';
+            return false;
+        }
+
+        switch (a.type) {
+            case AnnotationAction::SYMBOLIC_REGISTER:
+            case AnnotationAction::CONCRETIZE_REGISTER:
+                if (!a.hasRegister) {
+                    os << "You must specify " << ak << ".register" << '\n';
+                    return false;
+                }
+                break;
+
+            case AnnotationAction::SYMBOLIC_MEMORY:
+                if (!a.hasRegister) {
+                    a.address = cfg->getInt(ak + ".address", 0, &ok);
+                    if (!ok) {
+                        os << "You must specify either " << ak << ".address or .register" << '\n';
+                        return false;
+                    }
+                }
+                a.size = cfg->getInt(ak + ".size", 0, &ok);
+                if (!ok || a.size == 0) {
+                    os << "You must specify a valid size for " << ak << '\n';
+                    return false;
+                }
+                break;
+
+            case AnnotationAction::SKIP:
+                if (a.onReturn || !e.isCallAnnotation) {
+                    os << ak << ": functions can only be skipped on call" << '\n';
+                    return false;
+                }
+                if (cfg->hasKey(ak + ".returnValue")) {
+                    a.value = cfg->getInt(ak + ".returnValue");
+                    a.hasValue = true;
+                }
+                break;
+
+            case AnnotationAction::KILL:
+                if (cfg->hasKey(ak + ".value")) {
+                    if (!a.hasRegister) {
+                        os << "You must specify the register compared with " << ak << ".value" << '\n';
+                        return false;
+                    }
+                    a.value = cfg->getInt(ak + ".value");
+                    a.hasValue = true;
+                }
+                if (cfg->hasKey(ak + ".message")) {
+                    a.name = cfg->getString(ak + ".message");
+                }
+                break;
+        }
+
+        if (a.type == AnnotationAction::SYMBOLIC_REGISTER ||
+            a.type == AnnotationAction::SYMBOLIC_MEMORY) {
+            a.name = e.cfgname + "_" + *it;
+            if (cfg->hasKey(ak + ".name")) {
+                a.name = cfg->getString(ak + ".name");
+            }
+        }
+
+        e.hasReturnActions |= a.onReturn;
+        e.actions.push_back(a);
+    }
+
+    return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 void Annotation::onStateKill(S2EExecutionState* state)
 {
@@ -364,7 +530,7 @@ void Annotation::onTranslateInstruction(
     s2e()->getDebugStream() << hexval(pc) << " linked to annotation " << (*it)->cfgname << '\n';
 
     signal->connect(
-        sigc::mem_fun(*this, &Annotation::onInstruction)
+        sigc::bind(sigc::mem_fun(*this, &Annotation::onInstruction), *it)
     );
 }
 
@@ -413,32 +579,51 @@ void Annotation::invokeAnnotation(
         bool isCall, bool isInstruction
     )
 {
-    lua_State *L = s2e()->getConfig()->getState();
+    double startTime = klee::util::getWallTime();
+    bool doSkip = false, doKill = false;
 
-    S2ELUAExecutionState lua_s2e_state(state);
-    LUAAnnotation luaAnnotation(this, state);
+    ++entry->hitCount;
 
-    luaAnnotation.m_isReturn = !isCall;
-    luaAnnotation.m_isInstruction = isInstruction;
+    if (!entry->actions.empty()) {
+        runActions(state, entry, !isCall && !isInstruction, doSkip, doKill);
+    }
 
-    lua_getfield(L, LUA_GLOBALSINDEX, entry->annotation.c_str());
-    Lunar<S2ELUAExecutionState>::push(L, &lua_s2e_state);
-    Lunar<LUAAnnotation>::push(L, &luaAnnotation);
-    lua_call(L, 2, 0);
+    if (!doKill && entry->annotation.size() > 0) {
+        lua_State *L = s2e()->getConfig()->getState();
+
+        S2ELUAExecutionState lua_s2e_state(state);
+        LUAAnnotation luaAnnotation(this, state);
+
+        luaAnnotation.m_isReturn = !isCall;
+        luaAnnotation.m_isInstruction = isInstruction;
+
+        ++entry->luaCallCount;
+        lua_getfield(L, LUA_GLOBALSINDEX, entry->annotation.c_str());
+        Lunar<S2ELUAExecutionState>::push(L, &lua_s2e_state);
+        Lunar<LUAAnnotation>::push(L, &luaAnnotation);
+        lua_call(L, 2, 0);
+
+        doSkip |= luaAnnotation.m_doSkip;
+        doKill |= luaAnnotation.m_doKill;
+    }
+
+    //Killing and skipping do not return
+    entry->totalTime += klee::util::getWallTime() - startTime;
 
-    if (luaAnnotation.m_doKill) {
+    if (doKill) {
         std::stringstream ss;
         ss << "Annotation " << entry->cfgname << " killed us";
         s2e()->getExecutor()->terminateStateEarly(*state, ss.str());
         return;
     }
 
-    if (luaAnnotation.m_doSkip) {
+    if (doSkip) {
         state->bypassFunction(entry->paramCount);
         throw CpuExitException();
     }
 
-    if (fns) {
+    //Return annotations only matter if there is something to run
+    if (fns && (entry->annotation.size() > 0 || entry->hasReturnActions)) {
         assert(isCall);
         FunctionMonitor::ReturnSignal returnSignal;
         returnSignal.connect(sigc::bind(sigc::mem_fun(*this, &Annotation::onFunctionRet), entry));
@@ -446,36 +631,129 @@ void Annotation::invokeAnnotation(
     }
 }
 
-void Annotation::onInstruction(S2EExecutionState *state, uint64_t pc)
+/**
+ *  Runs the native actions of the annotation.
+ *  Kill and skip requests are returned to the caller, which handles them
+ *  the same way as those coming from Lua.
+ */
+void Annotation::runActions(
+        S2EExecutionState* state,
+        AnnotationCfgEntry *entry,
+        bool isReturn,
+        bool &doSkip, bool &doKill
+    )
+{
+    foreach2(it, entry->actions.begin(), entry->actions.end()) {
+        const AnnotationAction &a = *it;
+        if (a.onReturn != isReturn) {
+            continue;
+        }
+
+        unsigned regOffset = CPU_REG_OFFSET(a.regIndex);
+        klee::Expr::Width regBits = a.regSize << 3;
+
+        switch (a.type) {
+            case AnnotationAction::SYMBOLIC_REGISTER: {
+                uint64_t value = 0;
+                if (!state->readCpuRegisterConcrete(regOffset, &value, a.regSize)) {
+                    //Already symbolic, do not overwrite
+                    break;
+                }
+
+                std::vector<unsigned char> buf;
+                for (unsigned i = 0; i < a.regSize; ++i) {
+                    buf.push_back((value >> (i * 8)) & 0xFF);
+                }
+
+                state->writeCpuRegister(regOffset, state->createConcolicValue(a.name, regBits, buf));
+            } break;
+
+            case AnnotationAction::SYMBOLIC_MEMORY: {
+                uint64_t address = a.address;
+                if (a.hasRegister) {
+                    if (!state->readCpuRegisterConcrete(regOffset, &address, a.regSize)) {
+                        s2e()->getDebugStream() << "Annotation: " << entry->cfgname
+                                << " pointer register is symbolic, skipping action\n";
+                        break;
+                    }
+                }
+
+                std::vector<unsigned char> buf(a.size);
+                if (!state->readMemoryConcrete(address, &buf[0], a.size)) {
+                    s2e()->getDebugStream() << "Annotation: " << hexval(address)
+                            << " already contains symbolic data, not overwriting\n";
+                    break;
+                }
+
+                std::vector<klee::ref<klee::Expr> > bytes = state->createConcolicArray(a.name, a.size, buf);
+                for (unsigned i = 0; i < a.size; ++i) {
+                    if (!state->writeMemory(address + i, bytes[i])) {
+                        s2e()->getDebugStream() << "Annotation: could not write to " << hexval(address + i) << '\n';
+                        break;
+                    }
+                }
+            } break;
+
+            case AnnotationAction::CONCRETIZE_REGISTER: {
+                klee::ref<klee::Expr> expr = state->readCpuRegister(regOffset, regBits);
+                if (!isa<klee::ConstantExpr>(expr)) {
+                    expr = s2e()->getExecutor()->toConstant(*state, expr, "Annotation concretizeRegister");
+                    state->writeCpuRegister(regOffset, expr);
+                }
+            } break;
+
+            case AnnotationAction::SKIP: {
+                if (a.hasValue) {
+                    state->setReturnValue(a.value);
+                }
+                doSkip = true;
+            } break;
+
+            case AnnotationAction::KILL: {
+                if (a.hasValue) {
+                    uint64_t value = 0;
+                    if (!state->readCpuRegisterConcrete(regOffset, &value, a.regSize) || value != a.value) {
+                        break;
+                    }
+                }
+
+                if (a.name.size() > 0) {
+                    s2e()->getMessagesStream(state) << "Annotation: " << a.name << '\n';
+                }
+                doKill = true;
+                return;
+            }
+        }
+    }
+}
+
+void Annotation::onInstruction(S2EExecutionState *state, uint64_t pc,
+                               AnnotationCfgEntry *entry)
 {
+    //Translated code may be run by another process mapping the same address
     const ModuleDescriptor *md = m_moduleExecutionDetector->getModule(state, pc, true);
     if (!md) {
         return;
     }
 
-    AnnotationCfgEntry e;
-    e.isCallAnnotation = false;
-    e.module = *m_moduleExecutionDetector->getModuleId(*md);
-    e.address = md->ToNativeBase(pc);
-
-    CfgEntries::iterator it = m_entries.find(&e);
-
-    if (it == m_entries.end()) {
+    //or by a different module loaded there
+    const std::string *moduleId = m_moduleExecutionDetector->getModuleId(*md);
+    if (!moduleId || *moduleId != entry->module || md->ToNativeBase(pc) != entry->address) {
         return;
     }
 
-    if (!(*it)->isActive) {
+    if (!entry->isActive) {
         return;
     }
 
-    if ((*it)->switchInstructionToSymbolic) {
+    if (entry->switchInstructionToSymbolic) {
        state->jumpToSymbolicCpp();
     }
 
 
-    s2e()->getDebugStream() << "Annotation: Invoking instruction annotation " << (*it)->cfgname <<
-            " at " << hexval(e.address) << '\n';
-    invokeAnnotation(state, NULL, *it, false, true);
+    s2e()->getDebugStream() << "Annotation: Invoking instruction annotation " << entry->cfgname <<
+            " at " << hexval(entry->address) << '\n';
+    invokeAnnotation(state, NULL, entry, false, true);
 
 }
 
@@ -48,6 +48,49 @@
 namespace s2e {
 namespace plugins {
 
+    /**
+     *  Declarative action attached to an annotation.
+     *  Actions run natively every time the annotation is hit, which avoids
+     *  entering the Lua interpreter for the common cases.
+     */
+    struct AnnotationAction
+    {
+        enum Type {
+            SYMBOLIC_REGISTER, SYMBOLIC_MEMORY, CONCRETIZE_REGISTER,
+            SKIP, KILL
+        };
+
+        Type type;
+
+        //Run on function return instead of on call
+        bool onReturn;
+
+        //Name of the symbolic value or kill message
+        std::string name;
+
+        //Register operand (for memory actions, holds the pointer)
+        bool hasRegister;
+        uint32_t regIndex, regSize;
+
+        uint64_t address;
+        unsigned size;
+
+        //Return value for skip, expected register value for kill
+        bool hasValue;
+        uint64_t value;
+
+        AnnotationAction() {
+            type = SKIP;
+            onReturn = false;
+            hasRegister = false;
+            regIndex = regSize = 0;
+            address = 0;
+            size = 0;
+            hasValue = false;
+            value = 0;
+        }
+    };
+
     struct AnnotationCfgEntry
     {
         std::string cfgname;
@@ -63,6 +106,13 @@ namespace plugins {
         bool beforeInstruction;
         bool switchInstructionToSymbolic;
 
+        std::vector<AnnotationAction> actions;
+        bool hasReturnActions;
+
+        //Profiling information
+        uint64_t hitCount, luaCallCount;
+        double totalTime;
+
         AnnotationCfgEntry() {
             isCallAnnotation = true;
             address = 0;
@@ -70,6 +120,10 @@ namespace plugins {
             isActive = false;
             beforeInstruction = false;
             switchInstructionToSymbolic = false;
+            hasReturnActions = false;
+            hitCount = 0;
+            luaCallCount = 0;
+            totalTime = 0;
         }
 
         bool operator()(const AnnotationCfgEntry *a1, const AnnotationCfgEntry *a2) const {
@@ -114,6 +168,7 @@ private:
     std::string m_onTimer;
 
     bool initSection(const std::string &entry, const std::string &cfgname);
+    bool initActions(const std::string &entry, AnnotationCfgEntry &e);
 
     std::string checkCoreSignal(const std::string &cfgname,
                                 const std::string &name);
@@ -173,7 +228,15 @@ private:
             bool staticTarget,
             uint64_t targetPc);
 
-    void onInstruction(S2EExecutionState *state, uint64_t pc);
+    void onInstruction(S2EExecutionState *state, uint64_t pc,
+                       AnnotationCfgEntry *entry);
+
+    void runActions(
+            S2EExecutionState* state,
+            AnnotationCfgEntry *entry,
+            bool isReturn,
+            bool &doSkip, bool &doKill
+        );
 
     void invokeAnnotation(
             S2EExecutionState* state,
@@ -0,0 +1,297 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2E_PLUGINS_CACHEMODEL_H
+#define S2E_PLUGINS_CACHEMODEL_H
+
+#include <s2e/CowContainers.h>
+
+#include <cassert>
+#include <string>
+#include <inttypes.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace s2e {
+namespace plugins {
+
+/** Returns the floor form of binary logarithm for a 32 bit integer.
+    (unsigned) -1 is returned if n is 0. */
+static inline uint64_t floorLog2(uint64_t n) {
+    int pos = 0;
+    if (n >= 1<<16) { n >>= 16; pos += 16; }
+    if (n >= 1<< 8) { n >>=  8; pos +=  8; }
+    if (n >= 1<< 4) { n >>=  4; pos +=  4; }
+    if (n >= 1<< 2) { n >>=  2; pos +=  2; }
+    if (n >= 1<< 1) {           pos +=  1; }
+    return ((n == 0) ? ((uint64_t)-1) : pos);
+}
+
+/**
+ *  Model of n-way associative write-through cache with tree pseudo-LRU
+ *  replacement.
+ *
+ *  The tags of a set are stored contiguously, followed by the pseudo-LRU
+ *  bits of the set, so that a lookup touches a single small block of memory.
+ *  Bit i (1 <= i < associativity) is the node i of the binary tree whose
+ *  leaves are the ways, a set bit means that the victim is in the right
+ *  subtree.
+ *
+ *  This class does not depend on QEMU, it is also used by the offline
+ *  benchmark tool.
+ */
+class Cache {
+protected:
+    uint64_t m_size;
+    uint64_t m_associativity;
+    uint64_t m_lineSize;
+
+    uint64_t m_indexShift; // log2(m_lineSize)
+    uint64_t m_indexMask;  // 1 - setsCount
+
+    uint64_t m_tagShift;   // m_indexShift + log2(setsCount)
+
+    uint64_t m_setStride;  // m_associativity + 1
+    uint64_t m_wayBits;    // log2(m_associativity)
+
+    /* Shared with the caches of forked states until an access changes them */
+    CowVector<uint64_t> m_sets;
+
+    /* Last accessed line, it is always the most recently used one */
+    uint64_t m_lastLine;
+
+    std::string m_name;
+    uint8_t m_cacheId;
+
+    Cache* m_upperCache;
+
+    static int findWay(const uint64_t *tags, unsigned count, uint64_t tag) {
+        unsigned i = 0;
+#ifdef __SSE2__
+        /* Compare two tags at a time. There is no 64-bit compare in SSE2,
+           a tag matches if both of its 32-bit halves match. */
+        __m128i key = _mm_set1_epi64x(tag);
+        for (; i + 2 <= count; i += 2) {
+            __m128i t = _mm_loadu_si128((const __m128i*) (tags + i));
+            __m128i eq = _mm_cmpeq_epi32(t, key);
+            eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+            int mask = _mm_movemask_pd(_mm_castsi128_pd(eq));
+            if (mask) {
+                return i + ((mask & 1) ? 0 : 1);
+            }
+        }
+#endif
+        for (; i < count; ++i) {
+            if (tags[i] == tag) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    unsigned getVictim(uint64_t plru) const {
+        unsigned node = 1;
+        for (unsigned i = 0; i < m_wayBits; ++i) {
+            node = (node << 1) | ((plru >> node) & 1);
+        }
+        return node - m_associativity;
+    }
+
+    /* Make all the nodes on the path to the way point away from it */
+    void touch(uint64_t &plru, unsigned way) const {
+        unsigned node = way + m_associativity;
+        while (node > 1) {
+            unsigned parent = node >> 1;
+            if (node & 1) {
+                plru &= ~(1ULL << parent);
+            } else {
+                plru |= 1ULL << parent;
+            }
+            node = parent;
+        }
+    }
+
+public:
+    uint64_t getSize() const {
+        return m_size;
+    }
+
+    uint64_t getAssociativity() const {
+        return m_associativity;
+    }
+
+    uint64_t getLineSize() const {
+        return m_lineSize;
+    }
+
+    uint8_t getId() const {
+        return m_cacheId;
+    }
+
+    void setId(uint8_t id) {
+        m_cacheId = id;
+    }
+
+
+    Cache(const Cache &c) {
+        m_size = c.m_size;
+        m_associativity = c.m_associativity;
+        m_lineSize = c.m_lineSize;
+        m_indexShift = c.m_indexShift;
+        m_indexMask = c.m_indexMask;
+        m_tagShift = c.m_tagShift;
+        m_setStride = c.m_setStride;
+        m_wayBits = c.m_wayBits;
+        m_sets = c.m_sets;
+        m_lastLine = c.m_lastLine;
+        m_name = c.m_name;
+        m_cacheId = c.m_cacheId;
+        m_upperCache = NULL;
+    }
+
+    Cache(const std::string& name,
+          uint64_t size, uint64_t associativity,
+          uint64_t lineSize, uint64_t cost = 1, Cache* upperCache = NULL)
+        : m_size(size), m_associativity(associativity), m_lineSize(lineSize),
+          m_name(name), m_cacheId(0), m_upperCache(upperCache)
+    {
+        assert(size && associativity && lineSize);
+
+        assert(uint64_t(1LL<<floorLog2(associativity)) == associativity);
+        assert(uint64_t(1LL<<floorLog2(lineSize)) == lineSize);
+        assert(associativity <= 64 && "Pseudo-LRU bits must fit in 64 bits");
+
+        uint64_t setsCount = (size / lineSize) / associativity;
+        assert(setsCount && uint64_t(1LL << floorLog2(setsCount)) == setsCount);
+
+        m_indexShift = floorLog2(m_lineSize);
+        m_indexMask = setsCount-1;
+
+        m_tagShift = floorLog2(setsCount) + m_indexShift;
+
+        m_setStride = associativity + 1;
+        m_wayBits = floorLog2(associativity);
+        m_lastLine = (uint64_t) -1;
+
+        std::vector<uint64_t> &sets = m_sets.write();
+        sets.resize(setsCount * m_setStride, (uint64_t) -1);
+        for (uint64_t i = 0; i < setsCount; ++i) {
+            sets[i * m_setStride + associativity] = 0;
+        }
+    }
+
+    const std::string& getName() const { return m_name; }
+
+    Cache* getUpperCache() { return m_upperCache; }
+    void setUpperCache(Cache* cache) { m_upperCache = cache; }
+
+    /** Looks up a line (address >> log2(lineSize)) in this cache only.
+        Returns true on a hit, installs the line on a miss. */
+    bool accessLine(uint64_t line) {
+        /* Touching the most recently used line does not change anything */
+        if (line == m_lastLine) {
+            return true;
+        }
+        m_lastLine = line;
+
+        uint64_t tag = line >> (m_tagShift - m_indexShift);
+        uint64_t index = (line & m_indexMask) * m_setStride;
+        const uint64_t *set = &m_sets.get()[index];
+        uint64_t plru = set[m_associativity];
+
+        int way = findWay(set, m_associativity, tag);
+        bool hit = way >= 0;
+        if (!hit) {
+            way = getVictim(plru);
+        }
+
+        uint64_t newPlru = plru;
+        touch(newPlru, way);
+
+        /* Only unshare the sets when the access changes them, hits
+           on lines the pseudo-LRU bits already point away from do not */
+        if (hit && newPlru == plru) {
+            return true;
+        }
+
+        uint64_t *wset = &m_sets.write()[index];
+        if (!hit) {
+            wset[way] = tag;
+        }
+        wset[m_associativity] = newPlru;
+        return hit;
+    }
+
+    /** Models a cache access. A misCount is an array for miss counts (will be
+        passed to the upper caches), misCountSize is its size. Array
+        must be zero-initialized. */
+    void access(uint64_t address, uint64_t size,
+            bool isWrite, unsigned* misCount, unsigned misCountSize)
+    {
+        uint64_t first = address >> m_indexShift;
+        uint64_t last = (address + size - 1) >> m_indexShift;
+
+        for (uint64_t line = first; line <= last; ++line) {
+            if (accessLine(line)) {
+                continue;
+            }
+
+            misCount[0] += 1;
+
+            if (m_upperCache) {
+                /* Only forward the part of the access that covers this line */
+                uint64_t start = line << m_indexShift;
+                uint64_t end = start + m_lineSize;
+                if (start < address) {
+                    start = address;
+                }
+                if (end > address + size) {
+                    end = address + size;
+                }
+
+                assert(misCountSize > 1);
+                m_upperCache->access(start, end - start, isWrite,
+                                     misCount+1, misCountSize-1);
+            }
+        }
+    }
+};
+
+} // namespace plugins
+} // namespace s2e
+
+#endif // S2E_PLUGINS_CACHEMODEL_H
@@ -39,6 +39,7 @@ extern "C" {
 }
 
 #include "CacheSim.h"
+#include "CacheModel.h"
 
 #include <s2e/S2E.h>
 #include <s2e/ConfigFile.h>
@@ -59,148 +60,6 @@ namespace plugins {
 using namespace std;
 using namespace klee;
 
-/** Returns the floor form of binary logarithm for a 32 bit integer.
-    (unsigned) -1 is returned if n is 0. */
-uint64_t floorLog2(uint64_t n);
-uint64_t floorLog2(uint64_t n) {
-    int pos = 0;
-    if (n >= 1<<16) { n >>= 16; pos += 16; }
-    if (n >= 1<< 8) { n >>=  8; pos +=  8; }
-    if (n >= 1<< 4) { n >>=  4; pos +=  4; }
-    if (n >= 1<< 2) { n >>=  2; pos +=  2; }
-    if (n >= 1<< 1) {           pos +=  1; }
-    return ((n == 0) ? ((uint64_t)-1) : pos);
-}
-
-/* Model of n-way accosiative write-through LRU cache */
-class Cache {
-protected:
-    uint64_t m_size;
-    uint64_t m_associativity;
-    uint64_t m_lineSize;
-
-    uint64_t m_indexShift; // log2(m_lineSize)
-    uint64_t m_indexMask;  // 1 - setsCount
-
-    uint64_t m_tagShift;   // m_indexShift + log2(setsCount)
-
-    std::vector<uint64_t> m_lines;
-
-    std::string m_name;
-    uint8_t m_cacheId;
-
-    Cache* m_upperCache;
-
-public:
-    uint64_t getSize() const {
-        return m_size;
-    }
-
-    uint64_t getAssociativity() const {
-        return m_associativity;
-    }
-
-    uint64_t getLineSize() const {
-        return m_lineSize;
-    }
-
-    uint8_t getId() const {
-        return m_cacheId;
-    }
-
-    void setId(uint8_t id) {
-        m_cacheId = id;
-    }
-
-
-    Cache(const Cache &c) {
-        m_size = c.m_size;
-        m_associativity = c.m_associativity;
-        m_lineSize = c.m_lineSize;
-        m_indexShift = c.m_indexShift;
-        m_indexMask = c.m_indexMask;
-        m_tagShift = c.m_tagShift;
-        m_lines = c.m_lines;
-        m_name = c.m_name;
-        m_cacheId = c.m_cacheId;
-        m_upperCache = NULL;
-    }
-
-    Cache(const std::string& name,
-          uint64_t size, uint64_t associativity,
-          uint64_t lineSize, uint64_t cost = 1, Cache* upperCache = NULL)
-        : m_size(size), m_associativity(associativity), m_lineSize(lineSize),
-          m_name(name), m_upperCache(upperCache)
-    {
-        assert(size && associativity && lineSize);
-
-        assert(uint64_t(1LL<<floorLog2(associativity)) == associativity);
-        assert(uint64_t(1LL<<floorLog2(lineSize)) == lineSize);
-
-        uint64_t setsCount = (size / lineSize) / associativity;
-        assert(setsCount && uint64_t(1LL << floorLog2(setsCount)) == setsCount);
-
-        m_indexShift = floorLog2(m_lineSize);
-        m_indexMask = setsCount-1;
-
-        m_tagShift = floorLog2(setsCount) + m_indexShift;
-
-        m_lines.resize(setsCount * associativity, (uint64_t) -1);
-    }
-
-    const std::string& getName() const { return m_name; }
-
-    Cache* getUpperCache() { return m_upperCache; }
-    void setUpperCache(Cache* cache) { m_upperCache = cache; }
-
-    /** Models a cache access. A misCount is an array for miss counts (will be
-        passed to the upper caches), misCountSize is its size. Array
-        must be zero-initialized. */
-    void access(uint64_t address, uint64_t size,
-            bool isWrite, unsigned* misCount, unsigned misCountSize)
-    {
-
-        uint64_t s1 = address >> m_indexShift;
-        uint64_t s2 = (address+size-1) >> m_indexShift;
-
-        if(s1 != s2) {
-            /* Cache access spawns multiple lines */
-            uint64_t size1 = m_lineSize - (address & (m_lineSize - 1));
-            access(address, size1, isWrite, misCount, misCountSize);
-            access((address & ~(m_lineSize-1)) + m_lineSize, size-size1,
-                                   isWrite, misCount, misCountSize);
-            return;
-        }
-
-        uint64_t set = s1 & m_indexMask;
-        uint64_t l = set * m_associativity;
-        uint64_t tag = address >> m_tagShift;
-
-        for(unsigned i = 0; i < m_associativity; ++i) {
-            if(m_lines[l + i] == tag) {
-                /* Cache hit. Move line to MRU. */
-                for(unsigned j = i; j > 0; --j)
-                    m_lines[l + j] = m_lines[l + j - 1];
-                m_lines[l] = tag;
-                return;
-            }
-        }
-
-        //g_s2e->getDebugStream() << "Miss at 0x" << std::hex << address << '\n';
-        /* Cache miss. Install new tag as MRU */
-        misCount[0] += 1;
-        for(unsigned j = m_associativity-1; j > 0; --j)
-            m_lines[l + j] = m_lines[l + j - 1];
-        m_lines[l] = tag;
-
-        if(m_upperCache) {
-            assert(misCountSize > 1);
-            m_upperCache->access(address, size, isWrite,
-                                 misCount+1, misCountSize-1);
-        }
-    }
-};
-
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -280,9 +139,8 @@ CacheSimState::CacheSimState(S2EExecutionState *s, Plugin *p)
 
     }else {
         if(m_d1) {
-            s2e->getDebugStream()  << "CacheSim: connecting to onDataMemoryAccess" << '\n';
-            s2e->getCorePlugin()->onDataMemoryAccess.connect(
-                sigc::mem_fun(*csp, &CacheSim::onDataMemoryAccess));
+            s2e->getDebugStream()  << "CacheSim: connecting to data memory accesses" << '\n';
+            csp->connectDataMemoryAccess();
         }
 
         if(m_i1) {
@@ -391,11 +249,14 @@ void CacheSim::initialize()
     //Determines whether to address the cache physically of virtually
     m_physAddress = conf->getBool(getConfigKey() + ".physicalAddressing");
 
+    //Simulate data accesses in batches instead of one at a time
+    m_batchAccesses = conf->getBool(getConfigKey() + ".batchAccesses");
+
     m_cacheStructureWrittenToLog = false;
 
     ////////////////////
     //XXX: trick to force the initialization of the cache upon first memory access.
-    m_d1_connection = s2e()->getCorePlugin()->onDataMemoryAccess.connect(
+    m_d1_connection = s2e()->getCorePlugin()->onConcreteDataMemoryAccess.connect(
          sigc::mem_fun(*this, &CacheSim::onDataMemoryAccess));
 
     m_i1_connection = s2e()->getCorePlugin()->onTranslateBlockStart.connect(
@@ -465,8 +326,7 @@ void CacheSim::onModuleTranslateBlockStart(
         pc <<'\n';
 
     if(plgState->m_d1)
-        s2e()->getCorePlugin()->onDataMemoryAccess.connect(
-            sigc::mem_fun(*this, &CacheSim::onDataMemoryAccess));
+        connectDataMemoryAccess();
 
     if(plgState->m_i1)
         s2e()->getCorePlugin()->onTranslateBlockStart.connect(
@@ -478,12 +338,12 @@ void CacheSim::onModuleTranslateBlockStart(
 }
 
 
-bool CacheSim::profileAccess(S2EExecutionState *state) const
+bool CacheSim::profileAccess(S2EExecutionState *state, uint64_t pc) const
 {
     //Check whether to profile only known modules
     if (!m_reportWholeSystem) {
         if (m_execDetector && m_profileModulesOnly) {
-            if (!m_execDetector->getCurrentDescriptor(state)) {
+            if (!m_execDetector->getModule(state, pc)) {
                 return false;
             }
         }
@@ -492,13 +352,13 @@ bool CacheSim::profileAccess(S2EExecutionState *state) const
     return true;
 }
 
-bool CacheSim::reportAccess(S2EExecutionState *state) const
+bool CacheSim::reportAccess(S2EExecutionState *state, uint64_t pc) const
 {
     bool doLog = m_reportWholeSystem;
 
     if (!m_reportWholeSystem) {
         if (m_execDetector) {
-            return (m_execDetector->getCurrentDescriptor(state) != NULL);
+            return (m_execDetector->getModule(state, pc) != NULL);
         }else {
             return false;
         }
@@ -507,7 +367,7 @@ bool CacheSim::reportAccess(S2EExecutionState *state) const
     return doLog;
 }
 
-void CacheSim::onMemoryAccess(S2EExecutionState *state,
+void CacheSim::onMemoryAccess(S2EExecutionState *state, uint64_t pc,
                               uint64_t address, unsigned size,
                               bool isWrite, bool isIO, bool isCode)
 {
@@ -516,7 +376,7 @@ void CacheSim::onMemoryAccess(S2EExecutionState *state,
 
     DECLARE_PLUGINSTATE(CacheSimState, state);
 
-    if (!profileAccess(state)) {
+    if (!profileAccess(state, pc)) {
         return;
     }
 
@@ -533,18 +393,31 @@ void CacheSim::onMemoryAccess(S2EExecutionState *state,
     memset(missCount, 0, sizeof(missCount));
     cache->access(address, size, isWrite, missCount, missCountLength);
 
+    //Nothing to log for first-level hits
+    if (!m_reportZeroMisses && !missCount[0]) {
+        return;
+    }
+
     //Decide whether to log the access in the database
-    if (!reportAccess(state)) {
+    if (!reportAccess(state, pc)) {
         return;
     }
 
+    logAccess(state, cache, missCount, pc, address, size, isWrite, isCode);
+}
+
+void CacheSim::logAccess(S2EExecutionState *state, Cache *cache,
+                         const unsigned *missCount, uint64_t pc,
+                         uint64_t address, unsigned size,
+                         bool isWrite, bool isCode)
+{
     unsigned i = 0;
     for(Cache* c = cache; c != NULL; c = c->getUpperCache(), ++i) {
         if (m_reportZeroMisses || missCount[i]) {
                 ExecutionTraceCacheSimEntry e;
                 e.type = CACHE_ENTRY;
                 e.cacheId = c->getId();
-                e.pc = state->getPc();
+                e.pc = pc;
                 e.address = address;
                 e.size = size;
                 e.isWrite = isWrite;
@@ -558,37 +431,101 @@ void CacheSim::onMemoryAccess(S2EExecutionState *state,
     }
 }
 
+void CacheSim::connectDataMemoryAccess()
+{
+    if (m_batchAccesses) {
+        s2e()->getCorePlugin()->onConcreteDataMemoryAccessBatch.connect(
+            sigc::mem_fun(*this, &CacheSim::onDataMemoryAccessBatch));
+    } else {
+        s2e()->getCorePlugin()->onConcreteDataMemoryAccess.connect(
+            sigc::mem_fun(*this, &CacheSim::onDataMemoryAccess));
+    }
+}
+
 void CacheSim::onDataMemoryAccess(S2EExecutionState *state,
-                              klee::ref<klee::Expr> address,
-                              klee::ref<klee::Expr> hostAddress,
-                              klee::ref<klee::Expr> value,
-                              bool isWrite, bool isIO)
+                              uint64_t address,
+                              uint64_t hostAddress,
+                              uint64_t value,
+                              unsigned size,
+                              unsigned flags)
 {
-    if(!isa<ConstantExpr>(hostAddress)) {
-        s2e()->getWarningsStream()
-                << "Warning: CacheSim do not support symbolic addresses"
-                << '\n';
+    onMemoryAccess(state, state->getPc(),
+                   m_physAddress ? hostAddress : address, size,
+                   flags & MEM_TRACE_FLAG_WRITE, flags & MEM_TRACE_FLAG_IO,
+                   false);
+}
+
+/**
+ *  Same as onMemoryAccess, but the plugin state and the module
+ *  lookups are done once per batch (resp. once per pc) instead of
+ *  once per access.
+ */
+void CacheSim::onDataMemoryAccessBatch(S2EExecutionState *state,
+                                       const MemoryAccessRecord *records,
+                                       unsigned count)
+{
+    DECLARE_PLUGINSTATE(CacheSimState, state);
+
+    Cache *cache = plgState->m_d1;
+    if (!cache || !count) {
         return;
     }
 
-    uint64_t constAddress;
-    unsigned size = Expr::getMinBytesForWidth(value->getWidth());
+    writeCacheDescriptionToLog(state);
 
-    if (m_physAddress) {
-        constAddress = cast<ConstantExpr>(hostAddress)->getZExtValue(64);
-  //      s2e()->getDebugStream() << "acc pc=" << std::hex << state->getPc() << " ha=" << constAddress << '\n';
-    }else {
-        constAddress = cast<ConstantExpr>(address)->getZExtValue(64);
-    }
+    unsigned missCountLength = plgState->m_d1_length;
+    unsigned missCount[missCountLength];
+
+    uint64_t lastPc = records[0].pc;
+    bool profile = profileAccess(state, lastPc);
+    int report = -1;
+
+    for (unsigned i = 0; i < count; ++i) {
+        const MemoryAccessRecord &r = records[i];
+        if (r.flags & MEM_TRACE_FLAG_IO) {
+            continue;
+        }
+
+        if (r.pc != lastPc) {
+            lastPc = r.pc;
+            profile = profileAccess(state, lastPc);
+            report = -1;
+        }
+
+        if (!profile) {
+            continue;
+        }
+
+        uint64_t address = m_physAddress ? r.hostAddress : r.virtualAddress;
+        bool isWrite = r.flags & MEM_TRACE_FLAG_WRITE;
 
-    onMemoryAccess(state, constAddress, size, isWrite, isIO, false);
+        memset(missCount, 0, sizeof(missCount));
+        cache->access(address, r.size, isWrite, missCount, missCountLength);
+
+        if (!m_reportZeroMisses && !missCount[0]) {
+            continue;
+        }
+
+        if (report < 0) {
+            report = reportAccess(state, lastPc);
+        }
+
+        if (report) {
+            logAccess(state, cache, missCount, r.pc, address, r.size, isWrite, false);
+        }
+    }
 }
 
 void CacheSim::onExecuteBlockStart(S2EExecutionState *state, uint64_t pc,
                                    TranslationBlock *tb, uint64_t hostAddress)
 {
 //    s2e()->getDebugStream() << "exec pc=" << std::hex << pc << " ha=" << hostAddress << '\n';
-    onMemoryAccess(state, m_physAddress ? hostAddress : pc, tb->size, false, false, true);
+    if (m_batchAccesses) {
+        //Data accesses of previous blocks must hit the shared caches first
+        s2e()->getCorePlugin()->flushMemoryAccessBatch();
+    }
+
+    onMemoryAccess(state, pc, m_physAddress ? hostAddress : pc, tb->size, false, false, true);
 }
 
 void CacheSim::onTranslateBlockStart(ExecutionSignal *signal,
@@ -88,6 +88,7 @@ protected:
     bool m_cacheStructureWrittenToLog;
     bool m_startOnModuleLoad;
     bool m_physAddress;
+    bool m_batchAccesses;
     sigc::connection m_ModuleConnection;
 
     sigc::connection m_d1_connection;
@@ -100,15 +101,26 @@ protected:
         TranslationBlock *tb, uint64_t pc);
 
 
-    void onMemoryAccess(S2EExecutionState* state,
+    void onMemoryAccess(S2EExecutionState* state, uint64_t pc,
                         uint64_t address, unsigned size,
                         bool isWrite, bool isIO, bool isCode);
 
+    void logAccess(S2EExecutionState *state, Cache *cache,
+                   const unsigned *missCount, uint64_t pc,
+                   uint64_t address, unsigned size,
+                   bool isWrite, bool isCode);
+
+    void connectDataMemoryAccess();
+
     void onDataMemoryAccess(S2EExecutionState* state,
-                        klee::ref<klee::Expr> address,
-                        klee::ref<klee::Expr> hostAddress,
-                        klee::ref<klee::Expr> value,
-                        bool isWrite, bool isIO);
+                        uint64_t address,
+                        uint64_t hostAddress,
+                        uint64_t value,
+                        unsigned size, unsigned flags);
+
+    void onDataMemoryAccessBatch(S2EExecutionState* state,
+                        const MemoryAccessRecord *records,
+                        unsigned count);
 
     void onTranslateBlockStart(ExecutionSignal* signal,
                         S2EExecutionState*,
@@ -121,8 +133,8 @@ protected:
 
     void writeCacheDescriptionToLog(S2EExecutionState *state);
 
-    bool profileAccess(S2EExecutionState *state) const;
-    bool reportAccess(S2EExecutionState *state) const;
+    bool profileAccess(S2EExecutionState *state, uint64_t pc) const;
+    bool reportAccess(S2EExecutionState *state, uint64_t pc) const;
 public:
     CacheSim(S2E* s2e): Plugin(s2e) {}
     ~CacheSim();
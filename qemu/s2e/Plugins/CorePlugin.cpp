@@ -85,11 +85,86 @@ void CorePlugin::initializeTimers()
     qemu_mod_timer(m_Timer, qemu_get_clock_ms(rt_clock) + 1000);
 }
 
+CorePlugin::~CorePlugin()
+{
+    foreach2(it, m_memoryAccessFilters.begin(), m_memoryAccessFilters.end()) {
+        delete *it;
+    }
+}
+
 void CorePlugin::initialize()
 {
 
 }
 
+ConcreteMemoryAccessSignal &CorePlugin::getConcreteDataMemoryAccessSignal(
+        uint64_t start, uint64_t end)
+{
+    assert(start < end);
+    foreach2(it, m_memoryAccessFilters.begin(), m_memoryAccessFilters.end()) {
+        if ((*it)->start == start && (*it)->end == end) {
+            return (*it)->signal;
+        }
+    }
+
+    MemoryAccessFilter *filter = new MemoryAccessFilter();
+    filter->start = start;
+    filter->end = end;
+    m_memoryAccessFilters.push_back(filter);
+    return filter->signal;
+}
+
+void CorePlugin::emitConcreteDataMemoryAccess(S2EExecutionState *state,
+                                              uint64_t virtualAddress,
+                                              uint64_t hostAddress,
+                                              uint64_t value, unsigned size,
+                                              unsigned flags)
+{
+    if (!onConcreteDataMemoryAccess.empty()) {
+        onConcreteDataMemoryAccess.emit(state, virtualAddress, hostAddress,
+                                        value, size, flags);
+    }
+
+    unsigned count = m_memoryAccessFilters.size();
+    for (unsigned i = 0; i < count; ++i) {
+        MemoryAccessFilter *filter = m_memoryAccessFilters[i];
+        if (virtualAddress + size > filter->start &&
+            virtualAddress < filter->end && !filter->signal.empty()) {
+            filter->signal.emit(state, virtualAddress, hostAddress,
+                                value, size, flags);
+        }
+    }
+
+    if (!onConcreteDataMemoryAccessBatch.empty()) {
+        if (m_memoryAccessBatchState != state) {
+            flushMemoryAccessBatch();
+            m_memoryAccessBatchState = state;
+        }
+
+        MemoryAccessRecord &record = m_memoryAccessBatch[m_memoryAccessBatchCount++];
+        record.pc = state->getPc();
+        record.virtualAddress = virtualAddress;
+        record.hostAddress = hostAddress;
+        record.value = value;
+        record.size = size;
+        record.flags = flags;
+
+        if (m_memoryAccessBatchCount == MEMORY_ACCESS_BATCH_SIZE) {
+            flushMemoryAccessBatchSlow();
+        }
+    }
+}
+
+void CorePlugin::flushMemoryAccessBatchSlow()
+{
+    /* Reset first, so that a nested flush does not deliver them twice */
+    unsigned count = m_memoryAccessBatchCount;
+    m_memoryAccessBatchCount = 0;
+
+    onConcreteDataMemoryAccessBatch.emit(m_memoryAccessBatchState,
+                                         m_memoryAccessBatch, count);
+}
+
 /******************************/
 /* Functions called from QEMU */
 
@@ -342,16 +417,26 @@ static void s2e_trace_memory_access_slow(
         uint64_t vaddr, uint64_t haddr, uint8_t* buf, unsigned size,
         int isWrite, int isIO)
 {
+    CorePlugin *core = g_s2e->getCorePlugin();
     uint64_t value = 0;
     unsigned copy_size = (size > sizeof value) ? sizeof (value) : size;
     memcpy(&value, buf, copy_size);
 
     try {
-        g_s2e->getCorePlugin()->onDataMemoryAccess.emit(g_s2e_state,
-            klee::ConstantExpr::create(vaddr, 64),
-            klee::ConstantExpr::create(haddr, 64),
-            klee::ConstantExpr::create(value, copy_size << 3),
-            isWrite, isIO);
+        if (core->hasConcreteDataMemoryAccessListeners()) {
+            unsigned flags = (isWrite ? MEM_TRACE_FLAG_WRITE : 0) |
+                             (isIO ? MEM_TRACE_FLAG_IO : 0);
+            core->emitConcreteDataMemoryAccess(g_s2e_state, vaddr, haddr,
+                                               value, copy_size, flags);
+        }
+
+        if (!core->onDataMemoryAccess.empty()) {
+            core->onDataMemoryAccess.emit(g_s2e_state,
+                klee::ConstantExpr::create(vaddr, 64),
+                klee::ConstantExpr::create(haddr, 64),
+                klee::ConstantExpr::create(value, copy_size << 3),
+                isWrite, isIO);
+        }
     } catch(s2e::CpuExitException&) {
         s2e_longjmp(env->jmp_env, 1);
     }
@@ -365,7 +450,9 @@ void s2e_trace_memory_access(
         uint64_t vaddr, uint64_t haddr, uint8_t* buf, unsigned size,
         int isWrite, int isIO)
 {
-    if(unlikely(!g_s2e->getCorePlugin()->onDataMemoryAccess.empty())) {
+    CorePlugin *core = g_s2e->getCorePlugin();
+    if(unlikely(!core->onDataMemoryAccess.empty() ||
+                core->hasConcreteDataMemoryAccessListeners())) {
         s2e_trace_memory_access_slow(vaddr, haddr, buf, size, isWrite, isIO);
     }
 }
@@ -466,6 +553,7 @@ void s2e_on_page_directory_change(uint64_t previous, uint64_t current)
     assert(g_s2e_state->isActive());
 
     try {
+        g_s2e->getCorePlugin()->flushMemoryAccessBatch();
         g_s2e->getCorePlugin()->onPageDirectoryChange.emit(g_s2e_state, previous, current);
     } catch(s2e::CpuExitException&) {
         assert(false && "Cannot throw exceptions here. VM state may be inconsistent at this point.");
@@ -67,6 +67,34 @@ typedef sigc::signal<void, S2EExecutionState*, uint64_t /* pc */> ExecutionSigna
 typedef bool (*SYMB_PORT_CHECK)(uint16_t port, void *opaque);
 typedef bool (*SYMB_MMIO_CHECK)(uint64_t physaddress, uint64_t size, void *opaque);
 
+/** Flags of the concrete memory access signals */
+enum MemoryAccessFlags {
+    MEM_TRACE_FLAG_WRITE = 1,
+    MEM_TRACE_FLAG_IO = 2,
+    /* The value is symbolic and was passed as its concrete value in
+       concolic mode, as 0 otherwise */
+    MEM_TRACE_FLAG_SYMBOLIC_VALUE = 4
+};
+
+/** A type of a signal emitted on data memory accesses with concrete addresses */
+typedef sigc::signal<void, S2EExecutionState*,
+                     uint64_t /* virtualAddress */,
+                     uint64_t /* hostAddress */,
+                     uint64_t /* value */,
+                     unsigned /* size in bytes */,
+                     unsigned /* MemoryAccessFlags */>
+        ConcreteMemoryAccessSignal;
+
+/** Compact description of a data memory access, see onConcreteDataMemoryAccessBatch */
+struct MemoryAccessRecord {
+    uint64_t pc;
+    uint64_t virtualAddress;
+    uint64_t hostAddress;
+    uint64_t value;
+    uint32_t size;
+    uint32_t flags;
+};
+
 class CorePlugin : public Plugin {
     S2E_PLUGIN
 
@@ -77,6 +105,23 @@ private:
     void *m_isPortSymbolicOpaque;
     void *m_isMmioSymbolicOpaque;
 
+    /** Signal of accesses to [start, end) */
+    struct MemoryAccessFilter {
+        uint64_t start, end;
+        ConcreteMemoryAccessSignal signal;
+    };
+
+    typedef std::vector<MemoryAccessFilter*> MemoryAccessFilters;
+    MemoryAccessFilters m_memoryAccessFilters;
+
+    /** Accesses that were not delivered yet to onConcreteDataMemoryAccessBatch */
+    static const unsigned MEMORY_ACCESS_BATCH_SIZE = 4096;
+    MemoryAccessRecord m_memoryAccessBatch[MEMORY_ACCESS_BATCH_SIZE];
+    unsigned m_memoryAccessBatchCount;
+    S2EExecutionState *m_memoryAccessBatchState;
+
+    void flushMemoryAccessBatchSlow();
+
 public:
     CorePlugin(S2E* s2e): Plugin(s2e) {
         m_Timer = NULL;
@@ -84,8 +129,12 @@ public:
         m_isMmioSymbolicCb = NULL;
         m_isPortSymbolicOpaque = NULL;
         m_isMmioSymbolicOpaque = NULL;
+        m_memoryAccessBatchCount = 0;
+        m_memoryAccessBatchState = NULL;
     }
 
+    ~CorePlugin();
+
     void initialize();
     void initializeTimers();
 
@@ -192,6 +241,56 @@ public:
                  bool /* isWrite */, bool /* isIO */>
             onDataMemoryAccess;
 
+    /**
+     * Signal that is emitted on each data memory access whose addresses
+     * are concrete. Unlike onDataMemoryAccess, it does not build any
+     * expression and should be preferred by plugins that do not need
+     * symbolic values.
+     */
+    ConcreteMemoryAccessSignal onConcreteDataMemoryAccess;
+
+    /**
+     * Returns a signal that behaves like onConcreteDataMemoryAccess but
+     * only fires for accesses that overlap the virtual address range
+     * [start, end). The range is checked before any slot is invoked.
+     * Plugins asking for the same range share the signal.
+     */
+    ConcreteMemoryAccessSignal &getConcreteDataMemoryAccessSignal(
+            uint64_t start, uint64_t end);
+
+    /**
+     * Batched variant of onConcreteDataMemoryAccess. Accesses are
+     * recorded in a buffer and delivered in order when the buffer is
+     * full, when the translation block returns to the CPU loop, and
+     * before the state is switched, forked or killed, or its page
+     * directory changes. Slots must take the program counter from the
+     * records, the CPU may already be past the recorded accesses.
+     * Slots must not throw CpuExitException.
+     */
+    sigc::signal<void, S2EExecutionState*,
+                 const MemoryAccessRecord* /* records */,
+                 unsigned /* count */>
+            onConcreteDataMemoryAccessBatch;
+
+    /** Deliver the pending batch of memory accesses, if any */
+    inline void flushMemoryAccessBatch() {
+        if (m_memoryAccessBatchCount) {
+            flushMemoryAccessBatchSlow();
+        }
+    }
+
+    inline bool hasConcreteDataMemoryAccessListeners() const {
+        return !onConcreteDataMemoryAccess.empty() ||
+               !m_memoryAccessFilters.empty() ||
+               !onConcreteDataMemoryAccessBatch.empty();
+    }
+
+    void emitConcreteDataMemoryAccess(S2EExecutionState *state,
+                                      uint64_t virtualAddress,
+                                      uint64_t hostAddress,
+                                      uint64_t value, unsigned size,
+                                      unsigned flags);
+
     /** Signal that is emitted on each port access */
     sigc::signal<void, S2EExecutionState*,
                  klee::ref<klee::Expr> /* port */,
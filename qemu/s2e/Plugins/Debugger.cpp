@@ -75,8 +75,7 @@ void Debugger::initialize()
     initAddressTriggers(getConfigKey() + ".addressTriggers");
 
     if (!m_timeTrigger) {
-        s2e()->getCorePlugin()->onDataMemoryAccess.connect(
-                sigc::mem_fun(*this, &Debugger::onDataMemoryAccess));
+        connectMemoryMonitor();
     }else {
         m_timerConnection = s2e()->getCorePlugin()->onTimer.connect(
                 sigc::mem_fun(*this, &Debugger::onTimer));
@@ -195,20 +194,26 @@ bool Debugger::decideTracing(S2EExecutionState *state, uint64_t addr, uint64_t d
     return false;
 }
 
+void Debugger::connectMemoryMonitor()
+{
+    //Accesses below m_catchAbove are filtered out before reaching us
+    s2e()->getCorePlugin()->getConcreteDataMemoryAccessSignal(
+            m_catchAbove, (uint64_t) -1).connect(
+                sigc::mem_fun(*this, &Debugger::onDataMemoryAccess));
+}
+
 void Debugger::onDataMemoryAccess(S2EExecutionState *state,
-                               klee::ref<klee::Expr> address,
-                               klee::ref<klee::Expr> hostAddress,
-                               klee::ref<klee::Expr> value,
-                               bool isWrite, bool isIO)
+                               uint64_t addr,
+                               uint64_t hostAddress,
+                               uint64_t val,
+                               unsigned size,
+                               unsigned flags)
 {
-    if(!isa<klee::ConstantExpr>(address) || !isa<klee::ConstantExpr>(value)) {
+    if (flags & MEM_TRACE_FLAG_SYMBOLIC_VALUE) {
         //We do not support symbolic values yet...
         return;
     }
 
-    uint64_t addr = cast<klee::ConstantExpr>(address)->getZExtValue(64);
-    uint64_t val = cast<klee::ConstantExpr>(value)->getZExtValue(64);
-
     if (addr < m_catchAbove) {
         //Skip uninteresting ranges
         return;
@@ -220,7 +225,7 @@ void Debugger::onDataMemoryAccess(S2EExecutionState *state,
                    " MEM PC=" << hexval(state->getPc()) <<
                    " Addr=" << hexval(addr) <<
                    " Value=" << hexval(val) <<
-                   " IsWrite=" << isWrite << '\n';
+                   " IsWrite=" << !!(flags & MEM_TRACE_FLAG_WRITE) << '\n';
     }
 
 }
@@ -260,8 +265,7 @@ void Debugger::onTimer()
     }
 
     s2e()->getMessagesStream() << "Debugger Plugin: Enabling memory tracing" << '\n';
-    s2e()->getCorePlugin()->onDataMemoryAccess.connect(
-            sigc::mem_fun(*this, &Debugger::onDataMemoryAccess));
+    connectMemoryMonitor();
 
     //s2e()->getCorePlugin()->onTranslateInstructionStart.connect(
       //      sigc::mem_fun(*this, &Debugger::onTranslateInstructionStart));
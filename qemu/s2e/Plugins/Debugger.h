@@ -90,11 +90,13 @@ private:
 
     bool decideTracing(S2EExecutionState *state, uint64_t addr, uint64_t data) const;
 
+    void connectMemoryMonitor();
+
     void onDataMemoryAccess(S2EExecutionState *state,
-                                   klee::ref<klee::Expr> address,
-                                   klee::ref<klee::Expr> hostAddress,
-                                   klee::ref<klee::Expr> value,
-                                   bool isWrite, bool isIO);
+                                   uint64_t address,
+                                   uint64_t hostAddress,
+                                   uint64_t value,
+                                   unsigned size, unsigned flags);
 
     void onTranslateInstructionStart(
         ExecutionSignal *signal,
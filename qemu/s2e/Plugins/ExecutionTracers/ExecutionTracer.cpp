@@ -104,6 +104,10 @@ uint32_t ExecutionTracer::writeData(
 
     assert(m_LogFile);
 
+    /* Batched memory accesses come before this entry in the trace.
+       The flush is a no-op when this entry is part of the batch. */
+    s2e()->getCorePlugin()->flushMemoryAccessBatch();
+
     item.timeStamp = llvm::sys::TimeValue::now().usec();
     item.size = size;
     item.type = type;
@@ -86,6 +86,13 @@ void MemoryTracer::initialize()
     //the object state. Can be useful to debug the engine.
     m_debugObjectStates = s2e()->getConfig()->getBool(getConfigKey() + ".debugObjectStates");
 
+    //Write the trace in batches of concrete accesses. The entries are
+    //the same as without batching, except that accesses with symbolic
+    //addresses are not traced, and that the time stamps of the entries
+    //are those of the end of the batch, which is at most one translation
+    //block later. Off by default.
+    m_batchAccesses = s2e()->getConfig()->getBool(getConfigKey() + ".batchAccesses");
+
     //Start monitoring after the specified number of seconds
     bool hasTimeTrigger = false;
     m_timeTrigger = s2e()->getConfig()->getInt(getConfigKey() + ".timeTrigger", 0, &hasTimeTrigger);
@@ -187,6 +194,83 @@ void MemoryTracer::traceDataMemoryAccess(S2EExecutionState *state,
     m_tracer->writeData(state, &e, sizeof(e), TRACE_MEMORY);
 }
 
+void MemoryTracer::onDataMemoryAccessBatch(S2EExecutionState *state,
+                                           const MemoryAccessRecord *records,
+                                           unsigned count)
+{
+    //Write the same entries as traceDataMemoryAccess
+    ExecutionTraceMemory e;
+
+    for (unsigned i = 0; i < count; ++i) {
+        const MemoryAccessRecord &r = records[i];
+
+        if (m_catchAbove && (m_catchAbove >= r.pc)) {
+            continue;
+        }
+        if (m_catchBelow && (m_catchBelow < r.pc)) {
+            continue;
+        }
+
+        //The CPU may have left the module since the access was recorded
+        if (m_execDetector && m_monitorModules && !m_execDetector->getModule(state, r.pc)) {
+            continue;
+        }
+
+        e.pc = r.pc;
+        e.address = r.virtualAddress;
+        e.hostAddress = r.hostAddress;
+        e.value = r.value;
+        e.size = r.size;
+        e.flags = 0;
+
+        if (r.flags & MEM_TRACE_FLAG_WRITE) {
+            e.flags |= EXECTRACE_MEM_WRITE;
+        }
+        if (r.flags & MEM_TRACE_FLAG_IO) {
+            e.flags |= EXECTRACE_MEM_IO;
+        }
+        if (r.flags & MEM_TRACE_FLAG_SYMBOLIC_VALUE) {
+            //The record holds the concrete value in concolic mode
+            if (!ConcolicMode) {
+                e.value = 0xdeadbeef;
+            }
+            e.flags |= EXECTRACE_MEM_SYMBVAL;
+        }
+
+        e.concreteBuffer = 0;
+        if (m_traceHostAddresses) {
+            e.flags |= EXECTRACE_MEM_HASHOSTADDR;
+            e.flags |= EXECTRACE_MEM_OBJECTSTATE;
+
+            klee::ObjectPair op = state->addressSpace.findObject(e.hostAddress & S2E_RAM_OBJECT_MASK);
+            if (op.first && op.second) {
+                e.concreteBuffer = (uint64_t) op.second->getConcreteStore();
+                if ((r.flags & MEM_TRACE_FLAG_WRITE) && m_debugObjectStates) {
+                    assert(state->addressSpace.isOwnedByUs(op.second));
+                }
+            }
+        }
+
+        m_tracer->writeData(state, &e, sizeof(e), TRACE_MEMORY);
+    }
+
+    //Same as in onDataMemoryAccess
+    if (m_execDetector && m_monitorModules && !m_execDetector->getCurrentDescriptor(state)) {
+        m_memoryMonitor.disconnect();
+    }
+}
+
+sigc::connection MemoryTracer::connectMemoryMonitor()
+{
+    if (m_batchAccesses) {
+        return s2e()->getCorePlugin()->onConcreteDataMemoryAccessBatch.connect(
+                sigc::mem_fun(*this, &MemoryTracer::onDataMemoryAccessBatch));
+    }
+
+    return s2e()->getCorePlugin()->onDataMemoryAccess.connect(
+            sigc::mem_fun(*this, &MemoryTracer::onDataMemoryAccess));
+}
+
 void MemoryTracer::onDataMemoryAccess(S2EExecutionState *state,
                                klee::ref<klee::Expr> address,
                                klee::ref<klee::Expr> hostAddress,
@@ -207,11 +291,11 @@ void MemoryTracer::onModuleTransition(S2EExecutionState *state,
                                        const ModuleDescriptor *prevModule,
                                        const ModuleDescriptor *nextModule)
 {
+    //Accesses recorded so far belong to the previous module
+    s2e()->getCorePlugin()->flushMemoryAccessBatch();
+
     if (nextModule && !m_memoryMonitor.connected()) {
-        m_memoryMonitor =
-            s2e()->getCorePlugin()->onDataMemoryAccess.connect(
-                sigc::mem_fun(*this, &MemoryTracer::onDataMemoryAccess)
-            );
+        m_memoryMonitor = connectMemoryMonitor();
     } else {
         m_memoryMonitor.disconnect();
     }
@@ -250,8 +334,7 @@ void MemoryTracer::enableTracing()
                             &MemoryTracer::onModuleTransition)
                     );
         } else {
-            m_memoryMonitor = s2e()->getCorePlugin()->onDataMemoryAccess.connect(
-                    sigc::mem_fun(*this, &MemoryTracer::onDataMemoryAccess));
+            m_memoryMonitor = connectMemoryMonitor();
         }
     }
 
@@ -272,6 +355,7 @@ void MemoryTracer::enableTracing()
 
 void MemoryTracer::disableTracing()
 {
+    s2e()->getCorePlugin()->flushMemoryAccessBatch();
     m_memoryMonitor.disconnect();
     m_pageFaultsMonitor.disconnect();
     m_tlbMissesMonitor.disconnect();
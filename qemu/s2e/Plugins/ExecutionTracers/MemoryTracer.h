@@ -37,6 +37,7 @@
 #define S2E_PLUGINS_MEMTRACER_H
 
 #include <s2e/Plugin.h>
+#include <s2e/Plugins/CorePlugin.h>
 #include <s2e/Plugins/Opcodes.h>
 #include <string>
 #include "ExecutionTracer.h"
@@ -72,6 +73,7 @@ private:
     bool m_monitorStack;
     bool m_traceHostAddresses;
     bool m_debugObjectStates;
+    bool m_batchAccesses;
     uint64_t m_catchAbove;
     uint64_t m_catchBelow;
 
@@ -95,12 +97,18 @@ private:
     void disableTracing();
     void onCustomInstruction(S2EExecutionState* state, uint64_t opcode);
 
+    sigc::connection connectMemoryMonitor();
+
     void onDataMemoryAccess(S2EExecutionState *state,
                                    klee::ref<klee::Expr> address,
                                    klee::ref<klee::Expr> hostAddress,
                                    klee::ref<klee::Expr> value,
                                    bool isWrite, bool isIO);
 
+    void onDataMemoryAccessBatch(S2EExecutionState *state,
+                                 const MemoryAccessRecord *records,
+                                 unsigned count);
+
     void onModuleTransition(S2EExecutionState *state,
                             const ModuleDescriptor *prevModule,
                             const ModuleDescriptor *nextModule);
@@ -130,7 +130,7 @@ void LibraryCallMonitor::onModuleLoad(
             insertRes = m_functionNames.insert(composedName);
 
             const char *cstring = (*insertRes.first).c_str();
-            plgState->m_functions[address] = cstring;
+            plgState->m_functions.write()[address] = cstring;
 
             FunctionMonitor::CallSignal *cs = m_functionMonitor->getCallSignal(state, address, module.Pid);
             cs->connect(sigc::mem_fun(*this, &LibraryCallMonitor::onFunctionCall));
@@ -163,8 +163,8 @@ void LibraryCallMonitor::onFunctionCall(S2EExecutionState* state, FunctionMonito
         return;
     }
 
-    LibraryCallMonitorState::AddressToFunctionName::iterator it = plgState->m_functions.find(pc);
-    if (it != plgState->m_functions.end()) {
+    LibraryCallMonitorState::AddressToFunctionName::const_iterator it = plgState->m_functions->find(pc);
+    if (it != plgState->m_functions->end()) {
         const char *str = (*it).second;
         s2e()->getMessagesStream() << mod->Name << "@" << hexval(mod->ToNativeBase(caller)) << " called function " << str << '\n';
 
@@ -39,6 +39,7 @@
 #include <s2e/Plugin.h>
 #include <s2e/Plugins/CorePlugin.h>
 #include <s2e/S2EExecutionState.h>
+#include <s2e/CowContainers.h>
 
 #include <tr1/unordered_map>
 #include <tr1/unordered_set>
@@ -99,7 +100,7 @@ public:
     typedef std::tr1::unordered_map<uint64_t, const char *> AddressToFunctionName;
 
 private:
-    AddressToFunctionName m_functions;
+    CowContainer<AddressToFunctionName> m_functions;
 
 public:
     LibraryCallMonitorState();
@@ -37,6 +37,7 @@
 #include <s2e/S2E.h>
 #include <s2e/ConfigFile.h>
 #include <s2e/Utils.h>
+#include <s2e/CowContainers.h>
 
 #include <s2e/S2EExecutor.h>
 #include <s2e/Plugins/ModuleDescriptor.h>
@@ -45,8 +46,11 @@
 
 #include <klee/Internal/ADT/ImmutableMap.h>
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <string.h>
+#include <tr1/unordered_map>
 
 namespace s2e {
 namespace plugins {
@@ -116,6 +120,246 @@ namespace {
             << "    type = " << r.type << "\n";
         return out;
     }
+
+    static const unsigned SHADOW_PAGE_BITS = 12;
+    static const uint64_t SHADOW_PAGE_SIZE = 1 << SHADOW_PAGE_BITS;
+    static const uint8_t SHADOW_MIXED = 0xff;
+
+    /**
+     *  Shadow of one guest page. Each byte of the page has one bit per
+     *  permission, and one bit that marks the first byte of a region
+     *  (an access must not span several regions).
+     */
+    struct ShadowPage {
+        enum { READ_BITS = 0, WRITE_BITS, START_BITS, BITMAPS };
+
+        unsigned refCount;
+
+        //Permissions of all the bytes of the page if they belong to the
+        //same region, SHADOW_MIXED otherwise
+        uint8_t uniform;
+
+        uint8_t bits[BITMAPS][SHADOW_PAGE_SIZE / 8];
+
+        ShadowPage(): refCount(0), uniform(SHADOW_MIXED) {
+            memset(bits, 0, sizeof(bits));
+        }
+
+        ShadowPage(const ShadowPage &p): refCount(0), uniform(p.uniform) {
+            memcpy(bits, p.bits, sizeof(bits));
+        }
+
+        bool allSet(unsigned map, unsigned offset, unsigned size) const {
+            while (size) {
+                unsigned bit = offset & 7;
+                unsigned n = std::min(8 - bit, size);
+                uint8_t mask = ((1 << n) - 1) << bit;
+                if ((bits[map][offset >> 3] & mask) != mask) {
+                    return false;
+                }
+                offset += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        bool anySet(unsigned map, unsigned offset, unsigned size) const {
+            while (size) {
+                unsigned bit = offset & 7;
+                unsigned n = std::min(8 - bit, size);
+                uint8_t mask = ((1 << n) - 1) << bit;
+                if (bits[map][offset >> 3] & mask) {
+                    return true;
+                }
+                offset += n;
+                size -= n;
+            }
+            return false;
+        }
+
+        void fill(unsigned map, unsigned offset, unsigned size, bool value) {
+            while (size) {
+                unsigned bit = offset & 7;
+                unsigned n = std::min(8 - bit, size);
+                uint8_t mask = ((1 << n) - 1) << bit;
+                if (value) {
+                    bits[map][offset >> 3] |= mask;
+                } else {
+                    bits[map][offset >> 3] &= ~mask;
+                }
+                offset += n;
+                size -= n;
+            }
+        }
+
+        /** Checks the bytes of the page without looking at the summary */
+        bool check(unsigned offset, unsigned size, uint8_t perms, bool regionStartAllowed) const {
+            if ((perms & MemoryChecker::READ) && !allSet(READ_BITS, offset, size)) {
+                return false;
+            }
+            if ((perms & MemoryChecker::WRITE) && !allSet(WRITE_BITS, offset, size)) {
+                return false;
+            }
+            if (regionStartAllowed) {
+                ++offset;
+                --size;
+            }
+            return !anySet(START_BITS, offset, size);
+        }
+
+        bool isEmpty() const {
+            return !anySet(READ_BITS, 0, SHADOW_PAGE_SIZE) &&
+                   !anySet(WRITE_BITS, 0, SHADOW_PAGE_SIZE);
+        }
+
+        void updateSummary() {
+            uniform = SHADOW_MIXED;
+            if (anySet(START_BITS, 1, SHADOW_PAGE_SIZE - 1)) {
+                return;
+            }
+
+            uint8_t perms = 0;
+            if (allSet(READ_BITS, 0, SHADOW_PAGE_SIZE)) {
+                perms |= MemoryChecker::READ;
+            } else if (anySet(READ_BITS, 0, SHADOW_PAGE_SIZE)) {
+                return;
+            }
+
+            if (allSet(WRITE_BITS, 0, SHADOW_PAGE_SIZE)) {
+                perms |= MemoryChecker::WRITE;
+            } else if (anySet(WRITE_BITS, 0, SHADOW_PAGE_SIZE)) {
+                return;
+            }
+
+            uniform = perms;
+        }
+    };
+
+    typedef klee::ref<ShadowPage> ShadowPageRef;
+
+    /**
+     *  Page-granularity shadow of the memory map, used to check accesses
+     *  with a couple of memory loads. Pages fully covered by a region
+     *  share the same read-only shadow page. The page table is shared
+     *  between states until one of them grants or revokes memory.
+     */
+    class ShadowMemory {
+    private:
+        typedef std::tr1::unordered_map<uint64_t, ShadowPageRef> Pages;
+        CowContainer<Pages> m_pages;
+
+        //Last page looked up, only valid until the next update
+        mutable uint64_t m_lastPageNumber;
+        mutable const ShadowPage *m_lastPage;
+
+        static ShadowPageRef getUniformPage(uint8_t perms, bool regionStart) {
+            static ShadowPageRef s_pages[4][2];
+            ShadowPageRef &page = s_pages[perms & MemoryChecker::READWRITE][regionStart];
+            if (page.isNull()) {
+                page = new ShadowPage();
+                page->fill(ShadowPage::READ_BITS, 0, SHADOW_PAGE_SIZE, perms & MemoryChecker::READ);
+                page->fill(ShadowPage::WRITE_BITS, 0, SHADOW_PAGE_SIZE, perms & MemoryChecker::WRITE);
+                page->fill(ShadowPage::START_BITS, 0, 1, regionStart);
+                page->uniform = perms & MemoryChecker::READWRITE;
+            }
+            return page;
+        }
+
+        const ShadowPage *getPage(uint64_t pageNumber) const {
+            if (pageNumber != m_lastPageNumber || !m_lastPage) {
+                Pages::const_iterator it = m_pages->find(pageNumber);
+                if (it == m_pages->end()) {
+                    return NULL;
+                }
+                m_lastPageNumber = pageNumber;
+                m_lastPage = (*it).second.get();
+            }
+            return m_lastPage;
+        }
+
+    public:
+        ShadowMemory(): m_lastPageNumber(0), m_lastPage(NULL) {}
+
+        /** Returns true if the access is entirely within one region
+            with the requested permissions. */
+        bool check(uint64_t start, uint64_t size, uint8_t perms) const {
+            if (size == 0 || start + size < start) {
+                return false;
+            }
+
+            uint64_t offset = start & (SHADOW_PAGE_SIZE - 1);
+            if (offset + size <= SHADOW_PAGE_SIZE) {
+                const ShadowPage *page = getPage(start >> SHADOW_PAGE_BITS);
+                if (!page) {
+                    return false;
+                }
+                if (page->uniform != SHADOW_MIXED) {
+                    return (page->uniform & perms) == perms;
+                }
+                return page->check(offset, size, perms, true);
+            }
+
+            //The access spans several pages
+            bool first = true;
+            while (size) {
+                const ShadowPage *page = getPage(start >> SHADOW_PAGE_BITS);
+                uint64_t n = std::min(SHADOW_PAGE_SIZE - offset, size);
+                if (!page || !page->check(offset, n, perms, first)) {
+                    return false;
+                }
+                start += n;
+                size -= n;
+                offset = 0;
+                first = false;
+            }
+            return true;
+        }
+
+        /** Reflects the grant or revocation of a region */
+        void update(uint64_t start, uint64_t size, uint8_t perms, bool grant) {
+            Pages &pages = m_pages.write();
+            m_lastPage = NULL;
+
+            uint64_t end = start + size;
+            uint64_t address = start;
+            while (address < end) {
+                uint64_t pageNumber = address >> SHADOW_PAGE_BITS;
+                uint64_t offset = address & (SHADOW_PAGE_SIZE - 1);
+                uint64_t n = std::min(SHADOW_PAGE_SIZE - offset, end - address);
+
+                if (n == SHADOW_PAGE_SIZE) {
+                    //Inaccessible pages do not need a shadow
+                    if (grant && (perms & MemoryChecker::READWRITE)) {
+                        pages[pageNumber] = getUniformPage(perms, address == start);
+                    } else {
+                        pages.erase(pageNumber);
+                    }
+                } else {
+                    ShadowPageRef &page = pages[pageNumber];
+                    if (page.isNull()) {
+                        page = new ShadowPage();
+                    } else if (page->refCount > 1) {
+                        page = new ShadowPage(*page);
+                    }
+
+                    page->fill(ShadowPage::READ_BITS, offset, n, grant && (perms & MemoryChecker::READ));
+                    page->fill(ShadowPage::WRITE_BITS, offset, n, grant && (perms & MemoryChecker::WRITE));
+                    page->fill(ShadowPage::START_BITS, offset, n, false);
+                    if (grant && address == start) {
+                        page->fill(ShadowPage::START_BITS, offset, 1, true);
+                    }
+
+                    if (page->isEmpty()) {
+                        pages.erase(pageNumber);
+                    } else {
+                        page->updateSummary();
+                    }
+                }
+
+                address += n;
+            }
+        }
+    };
 } // namespace
 
 class MemoryCheckerState: public PluginState
@@ -124,6 +368,9 @@ public:
     MemoryMap m_memoryMap;
     ResourceHandleMap m_resourceMap;
 
+    //Permissions of m_memoryMap in a form that is fast to check
+    ShadowMemory m_shadow;
+
 public:
     MemoryCheckerState() {}
     ~MemoryCheckerState() {}
@@ -141,6 +388,10 @@ public:
         m_memoryMap = memoryMap;
     }
 
+    ShadowMemory &getShadowMemory() {
+        return m_shadow;
+    }
+
     ResourceHandleMap &getResourceMap() {
         return m_resourceMap;
     }
@@ -268,6 +519,18 @@ void MemoryChecker::onDataMemoryAccess(S2EExecutionState *state,
 
     onPreCheck.emit(state, start, accessSize, isWrite);
 
+    //Most accesses are valid, avoid building the error message for them
+    if (!m_checkMemoryErrors) {
+        return;
+    }
+
+    {
+        DECLARE_PLUGINSTATE(MemoryCheckerState, state);
+        if (plgState->getShadowMemory().check(start, accessSize, isWrite ? WRITE : READ)) {
+            return;
+        }
+    }
+
     std::string errstr;
     llvm::raw_string_ostream err(errstr);
     bool result = checkMemoryAccess(state, start,
@@ -493,6 +756,7 @@ void MemoryChecker::grantMemory(S2EExecutionState *state,
     }
 
     plgState->setMemoryMap(memoryMap.replace(std::make_pair(region->range, region)));
+    plgState->getShadowMemory().update(start, size, perms, true);
 
 }
 
@@ -585,6 +849,7 @@ bool MemoryChecker::revokeMemory(S2EExecutionState *state,
 
         //we can not just delete it since it can be used by other states!
         //delete const_cast<MemoryRegion*>(res->second);
+        plgState->getShadowMemory().update(res->first.start, res->first.size, NONE, false);
         plgState->setMemoryMap(memoryMap.remove(region->range));
     } while(false);
 
@@ -757,6 +1022,11 @@ bool MemoryChecker::checkMemoryAccess(S2EExecutionState *state,
 
     DECLARE_PLUGINSTATE(MemoryCheckerState, state);
 
+    if (plgState->getShadowMemory().check(start, size, perms)) {
+        return true;
+    }
+
+    //The memory map is only used to explain what went wrong
     MemoryMap &memoryMap = plgState->getMemoryMap();
 
     bool hasError = false;
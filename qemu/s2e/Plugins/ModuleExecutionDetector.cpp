@@ -58,6 +58,7 @@ extern "C" {
 #include "config.h"
 #include "qemu-common.h"
 #include "cpu.h"
+#include "exec-all.h"
 extern CPUArchState *env;
 }
 
@@ -72,6 +73,7 @@ extern CPUArchState *env;
 #include "ModuleExecutionDetector.h"
 #include <assert.h>
 #include <sstream>
+#include <algorithm>
 
 using namespace s2e;
 using namespace s2e::plugins;
@@ -127,9 +129,11 @@ void ModuleExecutionDetector::initializeConfiguration()
 
     m_TrackAllModules = cfg->getBool(getConfigKey() + ".trackAllModules");
     m_ConfigureAllModules = cfg->getBool(getConfigKey() + ".configureAllModules");
+    m_PrefetchLlvmCode = cfg->getBool(getConfigKey() + ".prefetchLlvmCode");
 
     foreach2(it, keyList.begin(), keyList.end()) {
-        if (*it == "trackAllModules"  || *it == "configureAllModules") {
+        if (*it == "trackAllModules"  || *it == "configureAllModules" ||
+            *it == "prefetchLlvmCode") {
             continue;
         }
 
@@ -386,17 +390,20 @@ void ModuleExecutionDetector::onTranslateBlockStart(
     TranslationBlock *tb,
     uint64_t pc)
 {
-    DECLARE_PLUGINSTATE(ModuleTransitionState, state);
-
     uint64_t pid = m_Monitor->getPid(state, pc);
 
     const ModuleDescriptor *currentModule =
-            plgState->getDescriptor(pid, pc);
+            getBlockModule(state, tb, pid);
 
     if (currentModule) {
         //S2E::printf(s2e()->getDebugStream(), "Translating block %#"PRIx64" belonging to %s\n",pc, currentModule->Name.c_str());
-        signal->connect(sigc::mem_fun(*this,
-            &ModuleExecutionDetector::onExecution));
+        signal->connect(sigc::bind(sigc::mem_fun(*this,
+            &ModuleExecutionDetector::onExecuteBlockStart), tb));
+
+        //Tracked modules are the ones likely to be executed symbolically
+        if (m_PrefetchLlvmCode) {
+            s2e()->getExecutor()->prefetchLlvmCode(tb);
+        }
 
         onModuleTranslateBlockStart.emit(signal, state, *currentModule, tb, pc);
     }
@@ -506,6 +513,43 @@ void ModuleExecutionDetector::onExecution(
     }
 }
 
+/**
+ *  Returns the module of the first instruction of tb. The result is cached
+ *  in the translation block and stays valid as long as the module index
+ *  of the process does not change, which makes the lookup O(1) on the
+ *  execution path of blocks shared by many states.
+ */
+const ModuleDescriptor *ModuleExecutionDetector::getBlockModule(
+        S2EExecutionState *state, TranslationBlock *tb, uint64_t pid)
+{
+    DECLARE_PLUGINSTATE(ModuleTransitionState, state);
+    S2ETranslationBlock *stb = tb->s2e_tb;
+
+    uint64_t indexId = plgState->getIndexId(pid);
+    if (stb->moduleIndexId == indexId && stb->modulePid == pid) {
+        return stb->module;
+    }
+
+    stb->module = plgState->getDescriptor(pid, tb->pc);
+    stb->modulePid = pid;
+    stb->moduleIndexId = indexId;
+    return stb->module;
+}
+
+void ModuleExecutionDetector::onExecuteBlockStart(
+    S2EExecutionState *state, uint64_t pc, TranslationBlock *tb)
+{
+    DECLARE_PLUGINSTATE(ModuleTransitionState, state);
+
+    const ModuleDescriptor *currentModule =
+            getBlockModule(state, tb, m_Monitor->getPid(state, pc));
+
+    if (plgState->m_PreviousModule != currentModule) {
+        onModuleTransition.emit(state, plgState->m_PreviousModule, currentModule);
+        plgState->m_PreviousModule = currentModule;
+    }
+}
+
 void ModuleExecutionDetector::dumpMemory(S2EExecutionState *state,
                                          llvm::raw_ostream &os_llvm,
                                          uint64_t va, unsigned count)
@@ -544,48 +588,107 @@ void ModuleExecutionDetector::dumpMemory(S2EExecutionState *state,
 /*****************************************************************************/
 /*****************************************************************************/
 
-ModuleTransitionState::ModuleTransitionState()
+uint64_t ModuleTransitionState::s_NextIndexId = 1;
+
+ModuleTransitionState::ModuleIndex::ModuleIndex():
+    refCount(0), id(s_NextIndexId++)
 {
-    m_PreviousModule = NULL;
-    m_CachedModule = NULL;
+
 }
 
-ModuleTransitionState::~ModuleTransitionState()
+ModuleTransitionState::ModuleIndex::ModuleIndex(const ModuleIndex &index):
+    refCount(0), id(s_NextIndexId++)
+{
+    foreach2(it, index.tracked.begin(), index.tracked.end()) {
+        tracked.push_back(new ModuleDescriptor(**it));
+    }
+
+    foreach2(it, index.notTracked.begin(), index.notTracked.end()) {
+        notTracked.push_back(new ModuleDescriptor(**it));
+    }
+}
+
+ModuleTransitionState::ModuleIndex::~ModuleIndex()
 {
-    foreach2(it, m_Descriptors.begin(), m_Descriptors.end()) {
+    foreach2(it, tracked.begin(), tracked.end()) {
         delete *it;
     }
 
-    foreach2(it, m_NotTrackedDescriptors.begin(), m_NotTrackedDescriptors.end()) {
+    foreach2(it, notTracked.begin(), notTracked.end()) {
         delete *it;
     }
 }
 
-ModuleTransitionState* ModuleTransitionState::clone() const
+namespace {
+    /* Descriptors are sorted and do not overlap, so their end addresses are sorted too */
+    struct ModuleEndsBefore {
+        bool operator()(const ModuleDescriptor *md, uint64_t address) const {
+            return md->LoadBase + md->Size <= address;
+        }
+    };
+}
+
+/* Returns the position of the module overlapping the given range, or
+   descriptors.size() if there is none */
+unsigned ModuleTransitionState::ModuleIndex::findOverlapping(
+        const Descriptors &descriptors, uint64_t loadBase, uint64_t size)
 {
-    ModuleTransitionState *ret = new ModuleTransitionState();
+    Descriptors::const_iterator it = std::lower_bound(descriptors.begin(),
+                                                      descriptors.end(),
+                                                      loadBase, ModuleEndsBefore());
 
-    foreach2(it, m_Descriptors.begin(), m_Descriptors.end()) {
-        ret->m_Descriptors.insert(new ModuleDescriptor(**it));
+    if (it != descriptors.end() && (*it)->LoadBase < loadBase + size) {
+        return it - descriptors.begin();
     }
 
-    foreach2(it, m_NotTrackedDescriptors.begin(), m_NotTrackedDescriptors.end()) {
-        assert(*it != m_CachedModule && *it != m_PreviousModule);
-        ret->m_NotTrackedDescriptors.insert(new ModuleDescriptor(**it));
-    }
+    return descriptors.size();
+}
 
-    if (m_CachedModule) {
-        DescriptorSet::iterator it = ret->m_Descriptors.find(m_CachedModule);
-        assert(it != ret->m_Descriptors.end());
-        ret->m_CachedModule = *it;
+const ModuleDescriptor *ModuleTransitionState::ModuleIndex::find(
+        const Descriptors &descriptors, uint64_t pc)
+{
+    unsigned i = findOverlapping(descriptors, pc, 1);
+    return i < descriptors.size() ? descriptors[i] : NULL;
+}
+
+const ModuleDescriptor *ModuleTransitionState::ModuleIndex::translate(
+        const ModuleIndex &index, const ModuleDescriptor *md) const
+{
+    Descriptors::const_iterator it;
+
+    it = std::find(index.tracked.begin(), index.tracked.end(), md);
+    if (it != index.tracked.end()) {
+        return tracked[it - index.tracked.begin()];
     }
 
-    if (m_PreviousModule) {
-        DescriptorSet::iterator it = ret->m_Descriptors.find(m_PreviousModule);
-        assert(it != ret->m_Descriptors.end());
-        ret->m_PreviousModule = *it;
+    it = std::find(index.notTracked.begin(), index.notTracked.end(), md);
+    if (it != index.notTracked.end()) {
+        return notTracked[it - index.notTracked.begin()];
     }
 
+    return md;
+}
+
+/*****************************************************************************/
+
+ModuleTransitionState::ModuleTransitionState()
+{
+    m_PreviousModule = NULL;
+    m_CachedModule = NULL;
+}
+
+ModuleTransitionState::~ModuleTransitionState()
+{
+
+}
+
+/* The module indexes are shared with the new state, copy happens on write */
+ModuleTransitionState* ModuleTransitionState::clone() const
+{
+    ModuleTransitionState *ret = new ModuleTransitionState();
+    ret->m_Indexes = m_Indexes;
+    ret->m_CachedModule = m_CachedModule;
+    ret->m_PreviousModule = m_PreviousModule;
     return ret;
 }
 
@@ -598,6 +701,38 @@ PluginState* ModuleTransitionState::factory(Plugin *p, S2EExecutionState *state)
     return s;
 }
 
+const ModuleTransitionState::ModuleIndex *ModuleTransitionState::getIndex(uint64_t pid) const
+{
+    ModuleIndexes::const_iterator it = m_Indexes.find(pid);
+    if (it == m_Indexes.end()) {
+        return NULL;
+    }
+    return (*it).second.get();
+}
+
+/* Returns an index of pid that is owned by this state only */
+ModuleTransitionState::ModuleIndex *ModuleTransitionState::getWriteableIndex(uint64_t pid)
+{
+    ModuleIndexRef &index = m_Indexes[pid];
+
+    if (index.isNull()) {
+        index = new ModuleIndex();
+        return index.get();
+    }
+
+    if (index->refCount > 1) {
+        ModuleIndex *copy = new ModuleIndex(*index);
+        m_CachedModule = copy->translate(*index, m_CachedModule);
+        m_PreviousModule = copy->translate(*index, m_PreviousModule);
+        index = copy;
+    } else {
+        /* Blocks may have cached lookups from the current content */
+        index->id = s_NextIndexId++;
+    }
+
+    return index.get();
+}
+
 const ModuleDescriptor *ModuleTransitionState::getDescriptor(uint64_t pid, uint64_t pc, bool tracked) const
 {
     if (m_CachedModule) {
@@ -611,25 +746,22 @@ const ModuleDescriptor *ModuleTransitionState::getDescriptor(uint64_t pid, uint6
         }
     }
 
-    ModuleDescriptor d;
-    d.Pid = pid;
-    d.LoadBase = pc;
-    d.Size = 1;
-    DescriptorSet::iterator it = m_Descriptors.find(&d);
-    if (it != m_Descriptors.end()) {
-        m_CachedModule = *it;
-        return *it;
+    const ModuleIndex *index = getIndex(pid);
+    if (!index) {
+        m_CachedModule = NULL;
+        return NULL;
+    }
+
+    const ModuleDescriptor *md = ModuleIndex::find(index->tracked, pc);
+    if (md) {
+        m_CachedModule = md;
+        return md;
     }
 
     m_CachedModule = NULL;
 
     if (!tracked) {
-        it = m_NotTrackedDescriptors.find(&d);
-        if (it != m_NotTrackedDescriptors.end()) {
-            //XXX: implement proper caching
-            assert(*it != m_CachedModule && *it != m_PreviousModule);
-            return *it;
-        }
+        return ModuleIndex::find(index->notTracked, pc);
     }
 
     return NULL;
@@ -637,115 +769,100 @@ const ModuleDescriptor *ModuleTransitionState::getDescriptor(uint64_t pid, uint6
 
 bool ModuleTransitionState::loadDescriptor(const ModuleDescriptor &desc, bool track)
 {
-    if (track) {
-        m_Descriptors.insert(new ModuleDescriptor(desc));
-    }else {
-        if (m_NotTrackedDescriptors.find(&desc) == m_NotTrackedDescriptors.end()) {
-            m_NotTrackedDescriptors.insert(new ModuleDescriptor(desc));
-        }
-        else {
-            return false;
+    /* Check on the shared index first, copying it and changing its id
+       would invalidate the modules cached by the translation blocks */
+    const ModuleIndex *sharedIndex = getIndex(desc.Pid);
+    if (sharedIndex) {
+        const Descriptors &shared = track ? sharedIndex->tracked : sharedIndex->notTracked;
+        if (ModuleIndex::findOverlapping(shared, desc.LoadBase, desc.Size) < shared.size()) {
+            return track;
         }
     }
+
+    ModuleIndex *index = getWriteableIndex(desc.Pid);
+    Descriptors &descriptors = track ? index->tracked : index->notTracked;
+
+    Descriptors::iterator it = std::lower_bound(descriptors.begin(), descriptors.end(),
+                                                desc.LoadBase, ModuleEndsBefore());
+    descriptors.insert(it, new ModuleDescriptor(desc));
     return true;
 }
 
 void ModuleTransitionState::unloadDescriptor(const ModuleDescriptor &desc)
 {
-    ModuleDescriptor d;
-    d.LoadBase = desc.LoadBase;
-    d.Pid = desc.Pid;
-    d.Size = desc.Size;
+    const ModuleIndex *sharedIndex = getIndex(desc.Pid);
+    if (!sharedIndex) {
+        return;
+    }
+
+    if (ModuleIndex::findOverlapping(sharedIndex->tracked, desc.LoadBase, desc.Size) ==
+            sharedIndex->tracked.size() &&
+        ModuleIndex::findOverlapping(sharedIndex->notTracked, desc.LoadBase, desc.Size) ==
+            sharedIndex->notTracked.size()) {
+        return;
+    }
 
-    DescriptorSet::iterator it = m_Descriptors.find(&d);
-    if (it != m_Descriptors.end()) {
-        if (m_CachedModule == *it) {
+    ModuleIndex *index = getWriteableIndex(desc.Pid);
+
+    unsigned i = ModuleIndex::findOverlapping(index->tracked, desc.LoadBase, desc.Size);
+    if (i < index->tracked.size()) {
+        const ModuleDescriptor *md = index->tracked[i];
+        if (m_CachedModule == md) {
             m_CachedModule = NULL;
         }
 
-        if (m_PreviousModule == *it) {
+        if (m_PreviousModule == md) {
             m_PreviousModule = NULL;
         }
 
-        const ModuleDescriptor *md = *it;
-        size_t s = m_Descriptors.erase(*it);
-        assert(s == 1);
+        index->tracked.erase(index->tracked.begin() + i);
         delete md;
     }
 
-    it = m_NotTrackedDescriptors.find(&d);
-    if (it != m_NotTrackedDescriptors.end()) {
-        assert(*it != m_CachedModule && *it != m_PreviousModule);
-        const ModuleDescriptor *md = *it;
-        size_t s = m_NotTrackedDescriptors.erase(*it);
-        assert(s == 1);
+    i = ModuleIndex::findOverlapping(index->notTracked, desc.LoadBase, desc.Size);
+    if (i < index->notTracked.size()) {
+        const ModuleDescriptor *md = index->notTracked[i];
+        assert(md != m_CachedModule && md != m_PreviousModule);
+        index->notTracked.erase(index->notTracked.begin() + i);
         delete md;
     }
 }
 
 void ModuleTransitionState::unloadDescriptorsWithPid(uint64_t pid)
 {
-    DescriptorSet::iterator it, it1;
-
-    for (it = m_Descriptors.begin(); it != m_Descriptors.end(); ) {
-        if ((*it)->Pid != pid) {
-            ++it;
-        }else {
-            it1 = it;
-            ++it1;
-
-            if (m_CachedModule == *it) {
-                m_CachedModule = NULL;
-            }
-
-            if (m_PreviousModule == *it) {
-                m_PreviousModule = NULL;
-            }
-
-            const ModuleDescriptor *md = *it;
-            m_Descriptors.erase(*it);
-            delete md;
-
-            it = it1;
-        }
+    ModuleIndexes::iterator it = m_Indexes.find(pid);
+    if (it == m_Indexes.end()) {
+        return;
     }
 
-    //XXX: avoid copy/paste
-    for (it = m_NotTrackedDescriptors.begin(); it != m_NotTrackedDescriptors.end(); ) {
-        if ((*it)->Pid != pid) {
-            ++it;
-        }else {
-            it1 = it;
-            ++it1;
-
-            if (m_CachedModule == *it) {
-                m_CachedModule = NULL;
-            }
-
-            if (m_PreviousModule == *it) {
-                m_PreviousModule = NULL;
-            }
-
-            const ModuleDescriptor *md = *it;
-            m_NotTrackedDescriptors.erase(*it);
-            delete md;
+    if (m_CachedModule && m_CachedModule->Pid == pid) {
+        m_CachedModule = NULL;
+    }
 
-            it = it1;
-        }
+    if (m_PreviousModule && m_PreviousModule->Pid == pid) {
+        m_PreviousModule = NULL;
     }
+
+    /* Descriptors are freed once no state references the index anymore */
+    m_Indexes.erase(it);
 }
 
 bool ModuleTransitionState::exists(const ModuleDescriptor *desc, bool tracked) const
 {
-    bool ret;
-    ret = m_Descriptors.find(desc) != m_Descriptors.end();
-    if (ret) {
-        return ret;
+    const ModuleIndex *index = getIndex(desc->Pid);
+    if (!index) {
+        return false;
+    }
+
+    if (ModuleIndex::findOverlapping(index->tracked, desc->LoadBase, desc->Size) <
+            index->tracked.size()) {
+        return true;
     }
 
     if (tracked) {
         return false;
     }
 
-    return m_NotTrackedDescriptors.find(desc) != m_NotTrackedDescriptors.end();
+    return ModuleIndex::findOverlapping(index->notTracked, desc->LoadBase, desc->Size) <
+            index->notTracked.size();
 }
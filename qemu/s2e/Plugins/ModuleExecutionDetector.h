@@ -44,6 +44,7 @@
 #include <s2e/Plugins/OSMonitor.h>
 
 #include <inttypes.h>
+#include <klee/util/Ref.h>
 #include "OSMonitor.h"
 
 #ifdef TARGET_I386
@@ -158,6 +159,9 @@ private:
     bool m_TrackAllModules;
     bool m_ConfigureAllModules;
 
+    /** Generate LLVM code for tracked modules at translation time */
+    bool m_PrefetchLlvmCode;
+
     void initializeConfiguration();
     bool opAddModuleConfigEntry(S2EExecutionState *state);
 
@@ -180,6 +184,12 @@ private:
         uint64_t targetPc);
 
     void onExecution(S2EExecutionState *state, uint64_t pc);
+    void onExecuteBlockStart(S2EExecutionState *state, uint64_t pc,
+                             TranslationBlock *tb);
+
+    const ModuleDescriptor *getBlockModule(S2EExecutionState *state,
+                                           TranslationBlock *tb,
+                                           uint64_t pid);
 
     void exceptionListener(
         S2EExecutionState* state,
@@ -228,13 +238,58 @@ public:
 class ModuleTransitionState:public PluginState
 {
 private:
-    typedef std::set<const ModuleDescriptor*, ModuleDescriptor::ModuleByLoadBase> DescriptorSet;
+    typedef std::vector<const ModuleDescriptor*> Descriptors;
+
+    /**
+     *  Modules of one process, sorted by load base. Modules do not
+     *  overlap, so the lookup is a binary search. The index is shared
+     *  between states until one of them loads or unloads a module.
+     */
+    struct ModuleIndex {
+        unsigned refCount;
+
+        /** Changes whenever the content of the index changes,
+            never reused */
+        uint64_t id;
+
+        Descriptors tracked;
+        Descriptors notTracked;
+
+        ModuleIndex();
+        ModuleIndex(const ModuleIndex &index);
+        ~ModuleIndex();
+
+        static unsigned findOverlapping(const Descriptors &descriptors,
+                                        uint64_t loadBase, uint64_t size);
+
+        static const ModuleDescriptor *find(const Descriptors &descriptors,
+                                            uint64_t pc);
+
+        /** Returns the descriptor of this index located at the same
+            position as md in index, or md itself if it is not there */
+        const ModuleDescriptor *translate(const ModuleIndex &index,
+                                          const ModuleDescriptor *md) const;
+    };
+
+    typedef klee::ref<ModuleIndex> ModuleIndexRef;
+    typedef std::map<uint64_t, ModuleIndexRef> ModuleIndexes;
+
+    static uint64_t s_NextIndexId;
 
     const ModuleDescriptor *m_PreviousModule;
     mutable const ModuleDescriptor *m_CachedModule;
 
-    DescriptorSet m_Descriptors;
-    DescriptorSet m_NotTrackedDescriptors;
+    ModuleIndexes m_Indexes;
+
+    const ModuleIndex *getIndex(uint64_t pid) const;
+    ModuleIndex *getWriteableIndex(uint64_t pid);
+
+    /** Identifies the current content of the module index of pid,
+        0 if the process has no modules */
+    uint64_t getIndexId(uint64_t pid) const {
+        const ModuleIndex *index = getIndex(pid);
+        return index ? index->id : 0;
+    }
 
     const ModuleDescriptor *getDescriptor(uint64_t pid, uint64_t pc, bool tracked=true) const;
     bool loadDescriptor(const ModuleDescriptor &desc, bool track);
@@ -65,9 +65,6 @@ void MaxTbSearcher::initialize()
     m_searcherInited = false;
     m_parentSearcher = NULL;
 
-    m_sorter.p = this;
-    m_states = StateSet(m_sorter);
-
     //XXX: Take care of module load/unload
     m_moduleExecutionDetector->onModuleTranslateBlockEnd.connect(
             sigc::mem_fun(*this, &MaxTbSearcher::onModuleTranslateBlockEnd)
@@ -227,12 +224,11 @@ void MaxTbSearcher::onTraceTb(S2EExecutionState* state, uint64_t pc)
     uint64_t tbVa = curModule->ToRelative(state->getTb()->pc);
 
     if (!md) {
-        m_states.erase(state);
         m_coveredTbs[*curModule][tbVa]++;
         DECLARE_PLUGINSTATE(MaxTbSearcherState, state);
         plgState->m_metric = m_coveredTbs[*curModule][tbVa];
         plgState->m_metric *= state->queryCost < 1 ? 1 : state->queryCost;
-        m_states.insert(state);
+        enqueue(state);
         return;
     }
 
@@ -249,8 +245,6 @@ void MaxTbSearcher::onTraceTb(S2EExecutionState* state, uint64_t pc)
     bool NextTbIsNew = NewTbIt == tbm.end();
     bool CurTbIsNew = CurTbIt == tbm.end();
 
-    m_states.erase(state);
-
     /**
      * Update the frequency of the current and next
      * translation blocks
@@ -281,13 +275,19 @@ void MaxTbSearcher::onTraceTb(S2EExecutionState* state, uint64_t pc)
 
     plgState->m_metric *= state->queryCost < 1 ? 1 : state->queryCost;
 
-    m_states.insert(state);
+    enqueue(state);
+}
+
+double MaxTbSearcher::getPriority(klee::ExecutionState *es)
+{
+    S2EExecutionState *state = static_cast<S2EExecutionState*>(es);
+    DECLARE_PLUGINSTATE(MaxTbSearcherState, state);
+    return plgState->m_metric;
 }
 
 klee::ExecutionState& MaxTbSearcher::selectState()
 {
     //If there are no prioritized states, revert to the parent searcher
-    StateSet::iterator it;
 
 #if 0
     uint64_t absNextPc = 0;
@@ -307,13 +307,8 @@ klee::ExecutionState& MaxTbSearcher::selectState()
     }while(absNextPc);
 #endif
 
-    if (m_states.size() > 0) {
-        S2EExecutionState *es = dynamic_cast<S2EExecutionState*>(*m_states.begin());
-        DECLARE_PLUGINSTATE(MaxTbSearcherState, es);
-        if (plgState->m_metric < 2) {
-            return *es;
-        }
-
+    if (!PrioritySearcher::empty() && topPriority() < 2) {
+        return *topState();
     }
 
     return m_parentSearcher->selectState();
@@ -345,7 +340,7 @@ bool MaxTbSearcher::updatePc(S2EExecutionState *es)
             << '\n';
 #endif
 
-    m_states.insert(es);
+    enqueue(es);
     return true;
 }
 
@@ -356,8 +351,7 @@ void MaxTbSearcher::update(klee::ExecutionState *current,
     m_parentSearcher->update(current, addedStates, removedStates);
 
     foreach2(it, removedStates.begin(), removedStates.end()) {
-        S2EExecutionState *es = dynamic_cast<S2EExecutionState*>(*it);
-        m_states.erase(es);
+        dequeue(*it);
     }
 
     foreach2(it, addedStates.begin(), addedStates.end()) {
@@ -368,7 +362,7 @@ void MaxTbSearcher::update(klee::ExecutionState *current,
 
 bool MaxTbSearcher::empty()
 {
-    if (!m_states.empty()) {
+    if (!PrioritySearcher::empty()) {
         return false;
     }
 
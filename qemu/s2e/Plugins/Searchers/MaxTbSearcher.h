@@ -68,30 +68,12 @@ public:
 
 };
 
-class MaxTbSearcher : public Plugin, public klee::Searcher
+//Prioritized states are kept in a heap keyed on their metric, so that
+//plugin states are only looked up when the metric changes
+class MaxTbSearcher : public Plugin, public klee::PrioritySearcher
 {
     S2E_PLUGIN
 public:
-    struct MaxTbSorter{
-        Plugin *p;
-
-        MaxTbSorter() {
-            p = NULL;
-        }
-
-        bool operator()(const S2EExecutionState *s1, const S2EExecutionState *s2) const{
-            const MaxTbSearcherState *p1 = static_cast<MaxTbSearcherState*>(p->getPluginState(const_cast<S2EExecutionState*>(s1), &MaxTbSearcherState::factory));
-            const MaxTbSearcherState *p2 = static_cast<MaxTbSearcherState*>(p->getPluginState(const_cast<S2EExecutionState*>(s2), &MaxTbSearcherState::factory));
-
-            if (p1->m_metric == p2->m_metric) {
-                return p1 < p2;
-            }
-            return p1->m_metric < p2->m_metric;
-        }
-    };
-
-    typedef std::set<S2EExecutionState*, MaxTbSorter> StateSet;
-
     //Maps a translation block address to the number of times it was executed
     typedef std::map<uint64_t, uint64_t> TbMap;
     typedef std::map<ModuleDescriptor, TbMap, ModuleDescriptor::ModuleByName > TbsByModule;
@@ -114,9 +96,7 @@ private:
     klee::Searcher *m_parentSearcher;
     TbsByModule m_coveredTbs;
 
-    MaxTbSorter m_sorter;
-    StateSet m_states;
-
+    virtual double getPriority(klee::ExecutionState *es);
 
     void addTb(S2EExecutionState *s, uint64_t absTargetPc);
     bool isExplored(S2EExecutionState *s, uint64_t absTargetPc);
@@ -43,6 +43,7 @@ extern "C" {
 #include <s2e/ConfigFile.h>
 #include <s2e/Utils.h>
 #include <s2e/s2e_qemu.h>
+#include <s2e/CowContainers.h>
 
 #include <iostream>
 
@@ -61,7 +62,7 @@ public:
     private:
         typedef std::pair<uint64_t, uint64_t> PidPc;
         typedef std::map<PidPc, unsigned> Cache;
-        Cache m_cache;
+        CowMap<PidPc, unsigned> m_cache;
         unsigned m_lastId;
 
     public:
@@ -71,23 +72,25 @@ public:
 
         void addModule(const ModuleDescriptor &module) {
             PidPc p = std::make_pair(module.Pid, module.LoadBase);
-            if (m_cache.find(p) != m_cache.end()) {
+            if (m_cache->find(p) != m_cache->end()) {
                 return;
             }
 
             unsigned id = ++m_lastId;
-            m_cache[p] = id;
+            m_cache.write()[p] = id;
         }
 
         void removeModule(const ModuleDescriptor &module) {
             PidPc p = std::make_pair(module.Pid, module.LoadBase);
-            m_cache.erase(p);
+            if (m_cache->find(p) != m_cache->end()) {
+                m_cache.write().erase(p);
+            }
         }
 
         unsigned getId(const ModuleDescriptor &module) const {
             PidPc p = std::make_pair(module.Pid, module.LoadBase);
-            Cache::const_iterator it = m_cache.find(p);
-            if (it == m_cache.end()) {
+            Cache::const_iterator it = m_cache->find(p);
+            if (it == m_cache->end()) {
                 return 0;
             }
 
@@ -108,7 +111,8 @@ public:
         friend llvm::raw_ostream& operator<<(llvm::raw_ostream &os, const StackFrame &frame);
     };
 
-    //The frames are sorted by decreasing stack pointer
+    //The frames are sorted by decreasing stack pointer.
+    //They are shared between forked states until modified.
     typedef std::vector<StackFrame> StackFrames;
 
 
@@ -119,7 +123,7 @@ public:
         //XXX: remove it?
         uint64_t m_lastStackPointer;
 
-        StackFrames m_frames;
+        CowVector<StackFrame> m_frames;
 
     public:
         Stack(S2EExecutionState *state,
@@ -142,7 +146,7 @@ public:
             sf.size = 4; //XXX: Fix constant
             sf.pc = pc;
 
-            m_frames.push_back(sf);
+            m_frames.write().push_back(sf);
         }
 
         uint64_t getStackBase() const {
@@ -155,7 +159,7 @@ public:
 
         /** Used for call instructions */
         void newFrame(S2EExecutionState *state, unsigned currentModuleId, uint64_t pc, uint64_t stackPointer) {
-            const StackFrame &last = m_frames.back();
+            const StackFrame &last = m_frames->back();
             assert(stackPointer < last.top + last.size);
 
             StackFrame frame;
@@ -163,15 +167,16 @@ public:
             frame.moduleId = currentModuleId;
             frame.top = stackPointer;
             frame.size = 4;
-            m_frames.push_back(frame);
+            m_frames.write().push_back(frame);
 
             m_lastStackPointer = stackPointer;
         }
 
         void update(S2EExecutionState *state, unsigned currentModuleId, uint64_t stackPointer) {
-            assert(!m_frames.empty());
+            StackFrames &frames = m_frames.write();
+            assert(!frames.empty());
             assert(stackPointer >= m_stackBase && stackPointer < (m_stackBase + m_stackSize));
-            StackFrame &last = m_frames.back();
+            StackFrame &last = frames.back();
 
             //The current stack pointer is above the bottom of the stack
             //We need to unwind the frames
@@ -179,14 +184,14 @@ public:
                 if (last.top >= stackPointer) {
                     last.size = last.top - stackPointer + 4;
                 } else {
-                    m_frames.pop_back();
+                    frames.pop_back();
                 }
 
-                if (m_frames.empty()) {
+                if (frames.empty()) {
                     break;
                 }
 
-                last = m_frames.back();
+                last = frames.back();
             } while (stackPointer > last.top);
 
             // The stack may become empty when the last frame is popped,
@@ -194,8 +199,8 @@ public:
         }
 
         /** Check whether there is a frame that belongs to the module. */
-        bool hasModule(unsigned moduleId) {
-            foreach2(it, m_frames.begin(), m_frames.end()) {
+        bool hasModule(unsigned moduleId) const {
+            foreach2(it, m_frames->begin(), m_frames->end()) {
                 if ((*it).moduleId == moduleId) {
                     return true;
                 }
@@ -204,21 +209,25 @@ public:
         }
 
         bool removeAllFrames(unsigned moduleId) {
-            StackFrames::iterator it = m_frames.begin();
+            if (!hasModule(moduleId)) {
+                return m_frames->empty();
+            }
+
+            StackFrames &frames = m_frames.write();
 
             unsigned i=0;
-            while (i < m_frames.size()) {
-                if (m_frames[i].moduleId == moduleId) {
-                    m_frames.erase(it + i);
+            while (i < frames.size()) {
+                if (frames[i].moduleId == moduleId) {
+                    frames.erase(frames.begin() + i);
                 } else {
                     ++i;
                 }
             }
-            return m_frames.empty();
+            return frames.empty();
         }
 
         bool empty() const {
-            return m_frames.empty();
+            return m_frames->empty();
         }
 
         bool getFrame(uint64_t sp, bool &frameValid, StackFrame &frameInfo) const {
@@ -230,7 +239,7 @@ public:
 
             //Look for the right frame
             //XXX: Use binary search?
-            foreach2(it, m_frames.begin(), m_frames.end()) {
+            foreach2(it, m_frames->begin(), m_frames->end()) {
                 const StackFrame &frame= *it;
                 if (sp > frame.top || (sp < frame.top - frame.size)) {
                     continue;
@@ -245,7 +254,7 @@ public:
         }
 
         void getCallStack(CallStack &cs) const {
-            foreach2(it, m_frames.begin(), m_frames.end()) {
+            foreach2(it, m_frames->begin(), m_frames->end()) {
                 cs.push_back((*it).pc);
             }
         }
@@ -264,7 +273,7 @@ private:
     OSMonitor *m_monitor;
     ModuleExecutionDetector *m_detector;
     StackMonitor *m_stackMonitor;
-    Stacks m_stacks;
+    CowMap<PidStackBase, Stack> m_stacks;
     ModuleCache m_moduleCache;
 
 public:
@@ -296,7 +305,7 @@ llvm::raw_ostream& operator<<(llvm::raw_ostream &os, const StackMonitorState::St
 llvm::raw_ostream& operator<<(llvm::raw_ostream &os, const StackMonitorState::Stack &stack)
 {
     os << "Stack " << hexval(stack.m_stackBase) << " size=" << hexval(stack.m_stackSize) << "\n";
-    foreach2(it, stack.m_frames.begin(), stack.m_frames.end()) {
+    foreach2(it, stack.m_frames->begin(), stack.m_frames->end()) {
         os << *it << "\n";
     }
 
@@ -484,11 +493,12 @@ void StackMonitorState::update(S2EExecutionState *state, uint64_t pc, bool isCal
 
     PidStackBase p = std::make_pair(pid, m_cachedStackBase);
 
-    Stacks::iterator stackit = m_stacks.find(p);
-    if (stackit == m_stacks.end()) {
+    Stacks &stacks = m_stacks.write();
+    Stacks::iterator stackit = stacks.find(p);
+    if (stackit == stacks.end()) {
         Stack stack(state, this, pc, m_cachedStackBase, m_cachedStackSize);
-        m_stacks.insert(std::make_pair(p, stack));
-        stackit = m_stacks.find(p);
+        stacks.insert(std::make_pair(p, stack));
+        stackit = stacks.find(p);
         m_stackMonitor->onStackCreation.emit(state);
     }
 
@@ -510,7 +520,7 @@ void StackMonitorState::update(S2EExecutionState *state, uint64_t pc, bool isCal
     }
 
     if (stack.empty()) {
-        m_stacks.erase(stackit);
+        stacks.erase(stackit);
         m_stackMonitor->onStackDeletion.emit(state);
         if (m_stackMonitor->m_statsCollector) {
             m_stackMonitor->m_statsCollector->incrementEmptyCallStacksCount(state);
@@ -536,11 +546,12 @@ void StackMonitorState::onModuleUnload(S2EExecutionState* state, const ModuleDes
     //If there are any frames active, this usually means a bug as a module cannot
     //be usually unloaded unless all its methods finished executing.
     //XXX: Leave this check to bug checkers (put an event here).
-    Stacks::iterator it = m_stacks.begin();
-    while (it != m_stacks.end()) {
+    Stacks &stacks = m_stacks.write();
+    Stacks::iterator it = stacks.begin();
+    while (it != stacks.end()) {
         if ((*it).second.removeAllFrames(id)) {
             //The stack is empty, get rid of it
-            m_stacks.erase(it++);
+            stacks.erase(it++);
         } else {
             ++it;
         }
@@ -550,12 +561,11 @@ void StackMonitorState::onModuleUnload(S2EExecutionState* state, const ModuleDes
 void StackMonitorState::deleteStack(S2EExecutionState *state, uint64_t stackBase)
 {
     PidStackBase p = std::make_pair(m_monitor->getPid(state, state->getPc()), stackBase);
-    Stacks::iterator it = m_stacks.find(p);
-    if (it == m_stacks.end()) {
+    if (m_stacks->find(p) == m_stacks->end()) {
         return;
     }
 
-    m_stacks.erase(it);
+    m_stacks.write().erase(p);
 }
 
 //onTheStack == true && result == true ==> found a valid frame
@@ -567,7 +577,7 @@ bool StackMonitorState::getFrameInfo(S2EExecutionState *state, uint64_t sp, bool
     onTheStack = false;
 
     //XXX: Assume here that there are very few stacks, so simple iteration is fast enough
-    foreach2(it, m_stacks.begin(), m_stacks.end()) {
+    foreach2(it, m_stacks->begin(), m_stacks->end()) {
         if ((*it).first.first != pid) {
             continue;
         }
@@ -599,14 +609,14 @@ bool StackMonitorState::getFrameInfo(S2EExecutionState *state, uint64_t sp, bool
 void StackMonitorState::dump(S2EExecutionState *state) const
 {
     g_s2e->getDebugStream() << "Dumping stacks\n";
-    foreach2(it, m_stacks.begin(), m_stacks.end()) {
+    foreach2(it, m_stacks->begin(), m_stacks->end()) {
         g_s2e->getDebugStream() << (*it).second << "\n";
     }
 }
 
 bool StackMonitorState::getCallStacks(S2EExecutionState *state, CallStacks &callStacks) const
 {
-    foreach2(it, m_stacks.begin(), m_stacks.end()) {
+    foreach2(it, m_stacks->begin(), m_stacks->end()) {
         callStacks.push_back(CallStack());
         CallStack &cs = callStacks.back();
 
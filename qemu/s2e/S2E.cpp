@@ -82,6 +82,8 @@ extern CPUArchState *env;
 
 #ifndef _WIN32
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 #endif
 
@@ -230,6 +232,9 @@ S2E::S2E(int argc, char** argv, TCGLLVMContext *tcgLLVMContext,
        other init* functions can use it. */
     initOutputDirectory(outputDirectory, verbose, false);
 
+    /* Must be mapped before forking so that all processes share it */
+    initSharedStats();
+
     /* Copy the config file into the output directory */
     {
         llvm::raw_ostream *out = openOutputFile("s2e.config.lua");
@@ -314,6 +319,17 @@ S2E::~S2E()
     delete m_s2eExecutor;
     delete m_s2eHandler;
 
+    //The executor writes the last statistics line when it is deleted
+    if (S2ESharedStatsSlot *slot = getSharedStatsSlot()) {
+        s2e_shared_stats_begin_update(slot);
+        slot->active = 0;
+        s2e_shared_stats_end_update(slot);
+#ifndef CONFIG_WIN32
+        munmap(m_sharedStats, sizeof(S2ESharedStats));
+#endif
+        m_sharedStats = NULL;
+    }
+
     //The execution engine deletion will also delete the module.
     m_tcgLLVMContext->deleteExecutionEngine();
 
@@ -358,6 +374,45 @@ llvm::raw_ostream* S2E::openOutputFile(const std::string &fileName)
     return f;
 }
 
+/**
+ *  Maps the statistics segment in the base output directory.
+ *  Child processes inherit the mapping when S2E forks.
+ */
+void S2E::initSharedStats()
+{
+    m_sharedStats = NULL;
+
+#ifndef CONFIG_WIN32
+    llvm::sys::Path filePath(m_outputDirectoryBase);
+    filePath.appendComponent(S2E_SHARED_STATS_FILE);
+
+    int fd = open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        getWarningsStream() << "Could not create " << filePath.str() << '\n';
+        return;
+    }
+
+    //The file is zero-filled, all slots are inactive
+    void *buffer = MAP_FAILED;
+    if (ftruncate(fd, sizeof(S2ESharedStats)) == 0) {
+        buffer = mmap(NULL, sizeof(S2ESharedStats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (buffer == MAP_FAILED) {
+        getWarningsStream() << "Could not map " << filePath.str() << '\n';
+        return;
+    }
+
+    m_sharedStats = static_cast<S2ESharedStats*>(buffer);
+    m_sharedStats->version = S2E_SHARED_STATS_VERSION;
+    m_sharedStats->slotCount = S2E_MAX_PROCESSES;
+    m_sharedStats->startTime = m_startTimeSeconds;
+    __sync_synchronize();
+    m_sharedStats->magic = S2E_SHARED_STATS_MAGIC;
+#endif
+}
+
 void S2E::initOutputDirectory(const string& outputDirectory, int verbose, bool forked)
 {
     if (!forked) {
@@ -756,13 +811,18 @@ bool S2E::checkDeadProcesses()
         //Check if pid is alive
         char buffer[64];
         snprintf(buffer, sizeof(buffer), "kill -0 %d", shared->processPids[i]);
-        int ret = system(buffer);
-        if (ret != 0) {
+        int status = system(buffer);
+        if (status != 0) {
             //Process is dead, we have to decrement everything
             shared->processIds[i] = (unsigned) -1;
             shared->processPids[i] = (unsigned) -1;
             --shared->currentProcessCount;
             ret = true;
+
+            //The process did not get to clear its statistics slot
+            if (m_sharedStats) {
+                s2e_shared_stats_release(&m_sharedStats->slots[i]);
+            }
         }
     }
 
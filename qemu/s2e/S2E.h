@@ -48,6 +48,7 @@
 #include "s2e_config.h"
 #include "Plugin.h"
 #include "Synchronization.h"
+#include "S2ESharedStats.h"
 
 namespace klee {
     class Interpreter;
@@ -126,6 +127,9 @@ protected:
 
     std::string m_outputDirectoryBase;
 
+    /* Statistics segment shared with other processes and external tools */
+    S2ESharedStats *m_sharedStats;
+
     /* The following members are late-initialized when
     QEMU pc creation is complete */
     S2EHandler* m_s2eHandler;
@@ -138,6 +142,7 @@ protected:
 
     /* forked indicates whether the current S2E process was forked from a parent S2E process */
     void initOutputDirectory(const std::string& outputDirectory, int verbose, bool forked);
+    void initSharedStats();
 
     void initKleeOptions();
     void initExecutor();
@@ -235,6 +240,11 @@ public:
 
     unsigned getCurrentProcessCount();
 
+    /** Get the shared statistics slot of the current process (may be NULL) */
+    S2ESharedStatsSlot *getSharedStatsSlot() const {
+        return m_sharedStats ? &m_sharedStats->slots[m_currentProcessId] : NULL;
+    }
+
     bool checkDeadProcesses();
 
     inline uint64_t getStartTime() const {
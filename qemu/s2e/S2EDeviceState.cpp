@@ -46,8 +46,10 @@ void vm_start(void);
 
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 #include <s2e/Utils.h>
 #include <s2e/S2E.h>
+#include <s2e/S2EStatsTracker.h>
 #include <s2e/s2e_qemu.h>
 #include "llvm/Support/CommandLine.h"
 #include "S2EDeviceState.h"
@@ -75,18 +77,22 @@ llvm::SmallVector<struct BlockDriverState*, 5> S2EDeviceState::s_blockDevices;
 
 QEMUFile *S2EDeviceState::s_memFile = NULL;
 
+S2EDeviceState::DeviceBlobs S2EDeviceState::s_loadedBlobs;
+std::vector<uint8_t> S2EDeviceState::s_saveBuffer;
+const S2EDeviceState::DeviceBlob *S2EDeviceState::s_restoreBlob = NULL;
+
 bool S2EDeviceState::s_devicesInited=false;
 
 extern "C" {
 
 static int s2e_qemu_get_buffer(uint8_t *buf, int64_t pos, int size)
 {
-    return g_s2e_state->getDeviceState()->getBuffer(buf, pos, size);
+    return S2EDeviceState::getBuffer(buf, pos, size);
 }
 
 static int s2e_qemu_put_buffer(const uint8_t *buf, int64_t pos, int size)
 {
-    return g_s2e_state->getDeviceState()->putBuffer(buf, pos, size);
+    return S2EDeviceState::putBuffer(buf, pos, size);
 }
 
 void s2e_init_device_state(S2EExecutionState *s)
@@ -98,33 +104,28 @@ void s2e_init_device_state(S2EExecutionState *s)
 
 
 S2EDeviceState::S2EDeviceState(const S2EDeviceState &state):
-        m_deviceState(state.m_deviceState)
+        m_deviceBlobs(state.m_deviceBlobs),
+        m_diskOverlay(state.m_diskOverlay),
+        m_diskOverlaySectors(state.m_diskOverlaySectors),
+        m_diskCowKey(++state.m_diskCowKey)
 {
-    assert(state.m_stateBuffer);
-    m_stateBuffer = (uint8_t*) malloc(state.m_stateBufferSize);
-    m_stateBufferSize = state.m_stateBufferSize;
-    memcpy(m_stateBuffer, state.m_stateBuffer, m_stateBufferSize);
+    assert(!m_deviceBlobs.empty() || s_devices.empty());
     s_memFile = state.s_memFile;
 }
 
-S2EDeviceState::S2EDeviceState(klee::ExecutionState *state):m_deviceState(state)
+S2EDeviceState::S2EDeviceState():
+        m_diskOverlaySectors(0), m_diskCowKey(1)
 {
-    m_stateBuffer = NULL;
-    m_stateBufferSize = 0;
     s_memFile = NULL;
 }
 
 S2EDeviceState::~S2EDeviceState()
 {
-    if (m_stateBuffer) {
-        free(m_stateBuffer);
-    }
+
 }
 
 void S2EDeviceState::initDeviceState()
 {
-    m_stateBuffer = NULL;
-    
     assert(!s_devicesInited);
 
     s_memFile = qemu_memfile_open(s2e_qemu_get_buffer, s2e_qemu_put_buffer);
@@ -179,78 +180,98 @@ void S2EDeviceState::initDeviceState()
     }
 }
 
-void S2EDeviceState::saveDeviceState()
+uint64_t S2EDeviceState::hashBuffer(const std::vector<uint8_t> &buffer)
 {
-    qemu_make_readable(s_memFile);
-
-    //DPRINTF("Saving device state %p\n", this);
-    /* Iterate through all device descritors and call
-    * their snapshot function */
-    for (vector<void*>::iterator it = s_devices.begin(); it != s_devices.end(); it++) {
-        void *se = *it;
-        //DPRINTF("%s ", s2e_qemu_get_se_idstr(se));
-        s2e_qemu_save_state(s_memFile, se);
+    /* FNV-1a */
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned i = 0; i < buffer.size(); ++i) {
+        hash ^= buffer[i];
+        hash *= 0x100000001b3ULL;
     }
-    //DPRINTF("\n");
-    qemu_fflush(s_memFile);
+    return hash;
 }
 
-void S2EDeviceState::restoreDeviceState()
+void S2EDeviceState::saveDeviceState()
 {
-    assert(m_stateBuffer);
-
-    qemu_make_readable(s_memFile);
-    //DPRINTF("Restoring device state %p\n", this);
-    for (vector<void*>::iterator it = s_devices.begin(); it != s_devices.end(); it++) {
-        void *se = *it;
-        //DPRINTF("%s ", s2e_qemu_get_se_idstr(se));  
-        s2e_qemu_load_state(s_memFile, se);
+    unsigned count = s_devices.size();
+    m_deviceBlobs.resize(count);
+    s_loadedBlobs.resize(count);
+
+    /* Snapshot every device separately, so that unchanged
+       devices can keep sharing their previous blob */
+    for (unsigned i = 0; i < count; ++i) {
+        s_saveBuffer.clear();
+        qemu_make_readable(s_memFile);
+        s2e_qemu_save_state(s_memFile, s_devices[i]);
+        qemu_fflush(s_memFile);
+
+        uint64_t hash = hashBuffer(s_saveBuffer);
+        DeviceBlobRef &blob = m_deviceBlobs[i];
+        const DeviceBlobRef &loaded = s_loadedBlobs[i];
+
+        if (!blob.isNull() && blob->hash == hash && blob->data == s_saveBuffer) {
+            /* Device did not change since the last snapshot */
+        } else if (!loaded.isNull() && loaded->hash == hash &&
+                   loaded->data == s_saveBuffer) {
+            /* Same content as the device restored from another state */
+            blob = loaded;
+        } else {
+            blob = new DeviceBlob(hash, s_saveBuffer);
+        }
+
+        s_loadedBlobs[i] = blob;
     }
-    //DPRINTF("\n");
 }
 
+void S2EDeviceState::restoreDeviceState(bool devicesSaved)
+{
+    unsigned count = s_devices.size();
+    assert(m_deviceBlobs.size() == count);
+    s_loadedBlobs.resize(count);
 
-/*****************************************************************************/
-/*****************************************************************************/
-/*****************************************************************************/
+    for (unsigned i = 0; i < count; ++i) {
+        const DeviceBlobRef &blob = m_deviceBlobs[i];
+        assert(!blob.isNull());
 
-void S2EDeviceState::allocateBuffer(unsigned int size)
-{
-    if (size < m_stateBufferSize) {
-        return;
-    }
+        if (devicesSaved && s_loadedBlobs[i].get() == blob.get()) {
+            continue;
+        }
 
-    /* Need to expand the buffer */
-    uint8_t *new_buffer = (uint8_t*) realloc(m_stateBuffer, size);
-    if (!new_buffer) {
-        cerr << "Cannot reallocate memory for device state snapshot" << endl;
-        exit(-1);
+        s_restoreBlob = blob.get();
+        qemu_make_readable(s_memFile);
+        s2e_qemu_load_state(s_memFile, s_devices[i]);
+        s_restoreBlob = NULL;
+
+        s_loadedBlobs[i] = blob;
     }
-    m_stateBuffer = new_buffer;
-    m_stateBufferSize = size;
 }
 
+
+/*****************************************************************************/
+/*****************************************************************************/
+/*****************************************************************************/
+
 int S2EDeviceState::putBuffer(const uint8_t *buf, int64_t pos, int size)
 {
-    uint8_t *dest;
-
-    allocateBuffer(pos + size);
-    dest = &m_stateBuffer[pos];
+    if (s_saveBuffer.size() < pos + size) {
+        s_saveBuffer.resize(pos + size);
+    }
 
-    memcpy(dest, buf, size);
+    memcpy(&s_saveBuffer[pos], buf, size);
     return size;
 }
 
 int S2EDeviceState::getBuffer(uint8_t *buf, int64_t pos, int size)
 {
-    assert(m_stateBuffer);
-    int toCopy = pos + size <= m_stateBufferSize ? size : m_stateBufferSize - pos;
-    memcpy(buf, &m_stateBuffer[pos], toCopy);
-    return size;
-
+    assert(s_restoreBlob);
+    const std::vector<uint8_t> &data = s_restoreBlob->data;
 
-    //memcpy(buf, &m_state[pos], toCopy);
-    //return toCopy;
+    /* QEMU reads ahead, the bytes past the end of the blob are not used */
+    if (pos < (int64_t) data.size()) {
+        int toCopy = pos + size <= (int64_t) data.size() ? size : data.size() - pos;
+        memcpy(buf, &data[pos], toCopy);
+    }
+    return size;
 }
 
 
@@ -277,27 +298,50 @@ uint64_t S2EDeviceState::getBlockDeviceStart(struct BlockDriverState* dev)
     return id * BLOCK_DEV_AS;
 }
 
+S2EDeviceState::DiskChunk *S2EDeviceState::getWriteableChunk(uint64_t chunkIndex)
+{
+    const DiskOverlay::value_type *entry = m_diskOverlay.lookup(chunkIndex);
+    if (!entry) {
+        DiskChunkRef chunk = new DiskChunk(m_diskCowKey);
+        m_diskOverlay = m_diskOverlay.insert(std::make_pair(chunkIndex, chunk));
+        ++stats::diskOverlayChunks;
+        return chunk.get();
+    }
+
+    DiskChunk *chunk = entry->second.get();
+    if (chunk->owner == m_diskCowKey) {
+        return chunk;
+    }
+
+    DiskChunkRef copy = new DiskChunk(*chunk, m_diskCowKey);
+    m_diskOverlay = m_diskOverlay.replace(std::make_pair(chunkIndex, copy));
+    ++stats::diskOverlayChunkCopies;
+    return copy.get();
+}
+
 /* Return 0 upon success */
 int S2EDeviceState::writeSector(struct BlockDriverState *bs, int64_t sector, const uint8_t *buf, int nb_sectors)
 {
     uint64_t bstart = getBlockDeviceStart(bs);
 
     while (nb_sectors > 0) {
-        uintptr_t address = (uintptr_t) bstart + sector * SECTOR_SIZE;
-        ObjectPair op = m_deviceState.findObject(address);
-        if (op.first == NULL) {
-            MemoryObject *mo = new MemoryObject(address, SECTOR_SIZE, false, false, false, NULL);
-            ObjectState *os = new ObjectState(mo);
-            m_deviceState.bindObject(mo, os);
-            op.first = mo;
-            op.second = os;
+        uint64_t address = bstart + sector * SECTOR_SIZE;
+        unsigned first = (address % CHUNK_SIZE) / SECTOR_SIZE;
+        unsigned count = std::min((unsigned) nb_sectors, CHUNK_SECTORS - first);
+
+        DiskChunk *chunk = getWriteableChunk(address / CHUNK_SIZE);
+        memcpy(&chunk->data[first * SECTOR_SIZE], buf, count * SECTOR_SIZE);
+
+        for (unsigned i = first; i < first + count; ++i) {
+            if (!chunk->isValid(i)) {
+                chunk->setValid(i);
+                ++m_diskOverlaySectors;
+            }
         }
 
-        ObjectState *os = m_deviceState.getWriteable(op.first, op.second);
-        memcpy(os->getConcreteStore(false), buf, SECTOR_SIZE);
-        buf += SECTOR_SIZE;
-        --nb_sectors;
-        ++sector;
+        buf += count * SECTOR_SIZE;
+        nb_sectors -= count;
+        sector += count;
     }
 
     return 0;
@@ -311,17 +355,32 @@ int S2EDeviceState::readSector(struct BlockDriverState *bs, int64_t sector, uint
     uint64_t bstart = getBlockDeviceStart(bs);
 
     while (nb_sectors > 0) {
-        uintptr_t address = (uintptr_t) bstart + sector * SECTOR_SIZE;
-        ObjectPair op = m_deviceState.findObject(address);
-        if (!op.first) {
+        uint64_t address = bstart + sector * SECTOR_SIZE;
+        const DiskOverlay::value_type *entry = m_diskOverlay.lookup(address / CHUNK_SIZE);
+        if (!entry) {
             return readCount;
         }
 
-        memcpy(buf, op.second->getConcreteStore(false), SECTOR_SIZE);
-        buf += SECTOR_SIZE;
-        ++readCount;
-        --nb_sectors;
-        ++sector;
+        const DiskChunk *chunk = entry->second.get();
+        unsigned first = (address % CHUNK_SIZE) / SECTOR_SIZE;
+        unsigned last = std::min((unsigned) nb_sectors, CHUNK_SECTORS - first) + first;
+
+        /* Copy the run of written sectors starting at the requested one */
+        unsigned end = first;
+        while (end < last && chunk->isValid(end)) {
+            ++end;
+        }
+
+        unsigned count = end - first;
+        memcpy(buf, &chunk->data[first * SECTOR_SIZE], count * SECTOR_SIZE);
+        buf += count * SECTOR_SIZE;
+        readCount += count;
+        nb_sectors -= count;
+        sector += count;
+
+        if (end < last) {
+            return readCount;
+        }
     }
 
     return readCount;
@@ -47,7 +47,8 @@ extern "C" {
 #include <stdint.h>
 #include <llvm/ADT/SmallVector.h>
 
-#include <klee/AddressSpace.h>
+#include <klee/util/Ref.h>
+#include <klee/Internal/ADT/ImmutableMap.h>
 
 #include "s2e_block.h"
 
@@ -62,46 +63,120 @@ private:
     /* Give 64GB of KLEE address space for each block device */
     static const uint64_t BLOCK_DEV_AS = (1024 * 1024 * 1024) * 64;
 
+    /* Written sectors are kept in chunks of 64KB */
+    static const unsigned CHUNK_SECTORS = 128;
+    static const unsigned CHUNK_SIZE = CHUNK_SECTORS * SECTOR_SIZE;
+
     static std::vector<void *> s_devices;
     static std::set<std::string> s_customDevices;
     static bool s_devicesInited;
 
     static QEMUFile *s_memFile;
 
-    uint8_t *m_stateBuffer;
-    unsigned m_stateBufferSize;
+    /** Immutable snapshot of one device, shared between states */
+    struct DeviceBlob {
+        unsigned refCount;
+        uint64_t hash;
+        std::vector<uint8_t> data;
+
+        DeviceBlob(uint64_t h, const std::vector<uint8_t> &d):
+            refCount(0), hash(h), data(d) {}
+    };
+
+    typedef klee::ref<DeviceBlob> DeviceBlobRef;
+    typedef std::vector<DeviceBlobRef> DeviceBlobs;
+
+    /** One blob per entry of s_devices */
+    DeviceBlobs m_deviceBlobs;
+
+    /** Blobs whose content is currently loaded in QEMU's devices */
+    static DeviceBlobs s_loadedBlobs;
+
+    /** Buffers used by the QEMU memory file while saving/loading a device */
+    static std::vector<uint8_t> s_saveBuffer;
+    static const DeviceBlob *s_restoreBlob;
 
+    static uint64_t hashBuffer(const std::vector<uint8_t> &buffer);
 
     static llvm::SmallVector<struct BlockDriverState*, 5> s_blockDevices;
-    klee::AddressSpace m_deviceState;
 
-    void allocateBuffer(unsigned int Sz);
+    /**
+     * Run of disk sectors written by the guest. A chunk may be shared
+     * by several states and is copied on the first write of a state that
+     * does not own it (same scheme as klee::AddressSpace).
+     */
+    struct DiskChunk {
+        unsigned refCount;
+        unsigned owner;
+        uint64_t valid[CHUNK_SECTORS / 64];
+        uint8_t data[CHUNK_SIZE];
+
+        DiskChunk(unsigned _owner): refCount(0), owner(_owner) {
+            memset(valid, 0, sizeof(valid));
+        }
+
+        DiskChunk(const DiskChunk &chunk, unsigned _owner):
+            refCount(0), owner(_owner) {
+            memcpy(valid, chunk.valid, sizeof(valid));
+            memcpy(data, chunk.data, sizeof(data));
+        }
+
+        bool isValid(unsigned sector) const {
+            return valid[sector / 64] & (1ULL << (sector % 64));
+        }
+
+        void setValid(unsigned sector) {
+            valid[sector / 64] |= 1ULL << (sector % 64);
+        }
+    };
+
+    typedef klee::ref<DiskChunk> DiskChunkRef;
+
+    /* Indexed by (device start + sector offset) / CHUNK_SIZE */
+    typedef klee::ImmutableMap<uint64_t, DiskChunkRef> DiskOverlay;
+
+    DiskOverlay m_diskOverlay;
+    uint64_t m_diskOverlaySectors;
+
+    /* Chunks owned by m_diskCowKey can be written in place */
+    mutable unsigned m_diskCowKey;
+
+    DiskChunk *getWriteableChunk(uint64_t chunkIndex);
 
     static unsigned getBlockDeviceId(struct BlockDriverState* dev);
     static uint64_t getBlockDeviceStart(struct BlockDriverState* dev);
 
 public:
-    S2EDeviceState(klee::ExecutionState *state);
+    S2EDeviceState();
     S2EDeviceState(const S2EDeviceState &state);
     ~S2EDeviceState();
 
-    void setExecutionState(klee::ExecutionState *state) {
-        m_deviceState.state = state;
-    }
-
     void initDeviceState();
 
-    //From QEMU to KLEE
+    //From QEMU to KLEE. Devices whose state did not change keep
+    //sharing their previous snapshot.
     void saveDeviceState();
-    
-    //From KLEE to QEMU
-    void restoreDeviceState();
 
-    int putBuffer(const uint8_t *buf, int64_t pos, int size);
-    int getBuffer(uint8_t *buf, int64_t pos, int size);
+    //From KLEE to QEMU. When devicesSaved is set, QEMU still holds the
+    //devices of the last saveDeviceState() call and only the devices
+    //whose snapshot differs are reloaded.
+    void restoreDeviceState(bool devicesSaved = false);
+
+    static int putBuffer(const uint8_t *buf, int64_t pos, int size);
+    static int getBuffer(uint8_t *buf, int64_t pos, int size);
 
     int writeSector(struct BlockDriverState *bs, int64_t sector, const uint8_t *buf, int nb_sectors);
     int readSector(struct BlockDriverState *bs, int64_t sector, uint8_t *buf, int nb_sectors);
+
+    /** Number of distinct sectors written in this state */
+    uint64_t getDiskOverlaySectors() const {
+        return m_diskOverlaySectors;
+    }
+
+    /** Number of chunks referenced by this state, possibly shared */
+    uint64_t getDiskOverlayChunks() const {
+        return m_diskOverlay.size();
+    }
 };
 
 }
@@ -46,10 +46,10 @@ extern "C" {
 
 extern CPUArchState *env;
 
-#if S2E_RAM_OBJECT_BITS > TARGET_PAGE_BITS
-#pragma message ( "S2E_RAM_OBJECT_BITS: " STRING(S2E_RAM_OBJECT_BITS) )
+#if defined(S2E_ENABLE_S2E_TLB) && S2E_RAM_OBJECT_MIN_BITS > TARGET_PAGE_BITS
+#pragma message ( "S2E_RAM_OBJECT_MIN_BITS: " STRING(S2E_RAM_OBJECT_MIN_BITS) )
 #pragma message ( "TARGET_PAGE_BITS: " STRING(TARGET_PAGE_BITS) )
-#error S2E_RAM_OBJECTS should be smaller (or equal to) TARGET_PAGE_BITS
+#error S2E_RAM_OBJECT_MIN_BITS should be smaller (or equal to) TARGET_PAGE_BITS
 #endif
 
 }
@@ -58,6 +58,7 @@ extern CPUArchState *env;
 #include <s2e/s2e_config.h>
 #include <s2e/S2EDeviceState.h>
 #include <s2e/S2EExecutor.h>
+#include <s2e/S2EStateSwapper.h>
 #include <s2e/Plugin.h>
 #include <s2e/Utils.h>
 
@@ -70,6 +71,7 @@ extern CPUArchState *env;
 
 #include <llvm/Support/CommandLine.h>
 
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 
@@ -90,6 +92,7 @@ extern llvm::cl::opt<bool> PrintForkingStatus;
 extern llvm::cl::opt<bool> ConcolicMode;
 extern llvm::cl::opt<bool> VerboseStateDeletion;
 extern llvm::cl::opt<bool> DebugConstraints;
+extern llvm::cl::opt<bool> LazyForkMaterialization;
 
 namespace s2e {
 
@@ -104,9 +107,8 @@ unsigned S2EExecutionState::s_lastSymbolicId = 0;
 S2EExecutionState::S2EExecutionState(klee::KFunction *kf) :
         klee::ExecutionState(kf), m_stateID(g_s2e->fetchAndIncrementStateId()),
         m_symbexEnabled(true), m_startSymbexAtPC((uint64_t) -1),
-        m_active(true), m_zombie(false), m_yielded(false), m_runningConcrete(true),
+        m_active(true), m_suspended(false), m_zombie(false), m_yielded(false), m_runningConcrete(true),
         m_cpuRegistersObject(NULL), m_cpuSystemObject(NULL),
-        m_deviceState(this),
         m_qemuIcount(0),
         m_lastS2ETb(NULL),
         m_lastMergeICount((uint64_t)-1),
@@ -315,7 +317,6 @@ ExecutionState* S2EExecutionState::clone()
     clearTlbOwnership();
     S2EExecutionState *ret = new S2EExecutionState(*this);
     ret->addressSpace.state = ret;
-    ret->m_deviceState.setExecutionState(ret);
 
     if(m_lastS2ETb)
         m_lastS2ETb->refCount += 1;
@@ -332,24 +333,61 @@ ExecutionState* S2EExecutionState::clone()
         ret->m_PluginState.insert(std::make_pair((*it).first, (*it).second->clone()));
     }
 
-    // This objects are not in TLB and won't cause any changes to it
-    ret->m_cpuRegistersObject = ret->addressSpace.getWriteable(
-                            m_cpuRegistersState, m_cpuRegistersObject);
-    ret->m_cpuSystemObject = ret->addressSpace.getWriteable(
-                            m_cpuSystemState, m_cpuSystemObject);
-
+    // This objects are not in TLB and won't cause any changes to it.
+    // The parent always gets new copies, which leaves the old ones to
+    // the child alone until it is materialized.
     m_cpuRegistersObject = addressSpace.getWriteable(
                             m_cpuRegistersState, m_cpuRegistersObject);
     m_cpuSystemObject = addressSpace.getWriteable(
                             m_cpuSystemState, m_cpuSystemObject);
 
-    ret->m_dirtyMaskObject = ret->addressSpace.getWriteable(
+    m_dirtyMaskObject = addressSpace.getWriteable(
             m_dirtyMask, m_dirtyMaskObject);
 
+    // Most forked states are killed or stay pending for a long time
+    // before they run, don't copy their cpu state until then.
+    ret->m_suspended = true;
+    if (!LazyForkMaterialization) {
+        ret->materialize();
+    }
+
+    return ret;
+}
+
+/**
+ * Gives a forked state its own copies of the objects that are written
+ * in place when switching states. Until then, nobody else refers to the
+ * objects the state got from its parent, so writing to them (e.g., from
+ * onStateFork handlers) is fine, but they must be owned by the address
+ * space before the state can be switched to.
+ */
+void S2EExecutionState::materialize()
+{
+    if (!m_suspended) {
+        return;
+    }
+
+    m_cpuRegistersObject = addressSpace.getWriteable(
+                            m_cpuRegistersState, m_cpuRegistersObject);
+    m_cpuSystemObject = addressSpace.getWriteable(
+                            m_cpuSystemState, m_cpuSystemObject);
     m_dirtyMaskObject = addressSpace.getWriteable(
             m_dirtyMask, m_dirtyMaskObject);
 
-    return ret;
+    m_suspended = false;
+}
+
+void S2EExecutionState::getMemoryUsage(S2EStateMemoryUsage &usage) const
+{
+    usage.ownedBytes = addressSpace.getOwnedBytes();
+
+    S2EStateSwapper *swapper = g_s2e->getExecutor()->getStateSwapper();
+    usage.swappedOutBytes = swapper ?
+        swapper->getSwappedOutBytes(const_cast<S2EExecutionState*>(this)) : 0;
+
+    usage.constraints = constraints.size();
+    usage.symbolics = symbolics.size();
+    usage.pluginStates = m_PluginState.size();
 }
 
 ref<Expr> S2EExecutionState::readCpuRegister(unsigned offset,
@@ -764,6 +802,18 @@ bool S2EExecutionState::bypassFunction(unsigned paramCount)
 
 }
 
+void S2EExecutionState::setReturnValue(uint64_t value)
+{
+    target_ulong t_value = value;
+#if defined(TARGET_I386)
+    writeCpuRegisterConcrete(CPU_OFFSET(regs[R_EAX]), &t_value, sizeof(t_value));
+#elif defined(TARGET_ARM)
+    writeCpuRegisterConcrete(CPU_OFFSET(regs[0]), &t_value, sizeof(t_value));
+#else
+    assert(false && "Not implemented for this architecture");
+#endif
+}
+
 //May be called right after the machine call instruction
 bool S2EExecutionState::getReturnAddress(uint64_t *retAddr)
 {
@@ -924,19 +974,42 @@ uint64_t S2EExecutionState::getSymbolicRegistersMask() const
     return mask;
 }
 
+ObjectPair S2EExecutionState::findRamObject(uint64_t hostPage) const
+{
+    ObjectPair op = m_memcache.get(hostPage);
+    if (!op.first) {
+        op = addressSpace.findObject(hostPage);
+        m_memcache.put(hostPage, op);
+    }
+
+    assert(op.first && op.first->isUserSpecified &&
+           op.first->address == hostPage &&
+           op.first->size == S2E_RAM_OBJECT_SIZE);
+    return op;
+}
+
 bool S2EExecutionState::readMemoryConcrete(uint64_t address, void *buf,
                                    uint64_t size, AddressType addressType)
 {
     uint8_t *d = (uint8_t*)buf;
     while (size>0) {
-        ref<Expr> v = readMemory(address, Expr::Int8, addressType);
-        if (v.isNull() || !isa<ConstantExpr>(v)) {
+        /* RAM objects never cross a page boundary */
+        uint64_t offset = address & ~S2E_RAM_OBJECT_MASK;
+        uint64_t length = std::min(size, S2E_RAM_OBJECT_SIZE - offset);
+
+        uint64_t hostAddress = getHostAddress(address, addressType);
+        if (hostAddress == (uint64_t) -1) {
             return false;
         }
-        *d = (uint8_t)cast<ConstantExpr>(v)->getZExtValue(8);
-        size--;
-        d++;
-        address++;
+
+        ObjectPair op = findRamObject(hostAddress & S2E_RAM_OBJECT_MASK);
+        if (!op.second->readConcrete(offset, d, length)) {
+            return false;
+        }
+
+        size -= length;
+        d += length;
+        address += length;
     }
     return true;
 }
@@ -946,14 +1019,25 @@ bool S2EExecutionState::writeMemoryConcrete(uint64_t address, void *buf,
 {
     uint8_t *d = (uint8_t*)buf;
     while (size>0) {
-        klee::ref<klee::ConstantExpr> val = klee::ConstantExpr::create(*d, klee::Expr::Int8);
-        bool b = writeMemory(address, val,  addressType);
-        if (!b) {
+        uint64_t offset = address & ~S2E_RAM_OBJECT_MASK;
+        uint64_t length = std::min(size, S2E_RAM_OBJECT_SIZE - offset);
+
+        uint64_t hostAddress = getHostAddress(address, addressType);
+        if (hostAddress == (uint64_t) -1) {
             return false;
         }
-        size--;
-        d++;
-        address++;
+
+        ObjectPair op = findRamObject(hostAddress & S2E_RAM_OBJECT_MASK);
+        if (op.first->isSharedConcrete) {
+            memcpy((uint8_t*) op.first->address + offset, d, length);
+        } else {
+            ObjectState *wos = addressSpace.getWriteable(op.first, op.second);
+            wos->writeConcrete(offset, d, length);
+        }
+
+        size -= length;
+        d += length;
+        address += length;
     }
     return true;
 }
@@ -1254,17 +1338,11 @@ void S2EExecutionState::readRamConcreteCheck(uint64_t hostAddress, uint8_t* buf,
 
         uint64_t page_addr = hostAddress & S2E_RAM_OBJECT_MASK;
 
-        //ObjectPair op = addressSpace.findObject(page_addr);
-        ObjectPair op = m_memcache.get(page_addr);
-        if (!op.first) {
-            op = addressSpace.findObject(page_addr);
-            m_memcache.put(page_addr, op);
-        }
+        ObjectPair op = findRamObject(page_addr);
 
-
-        assert(op.first && op.first->isUserSpecified &&
-               op.first->address == page_addr &&
-               op.first->size == S2E_RAM_OBJECT_SIZE);
+        if (op.second->readConcrete(page_offset, buf, size)) {
+            return;
+        }
 
         for(uint64_t i=0; i<size; ++i) {
             if(!op.second->readConcrete8(page_offset+i, buf+i)) {
@@ -1295,17 +1373,11 @@ void S2EExecutionState::readRamConcrete(uint64_t hostAddress, uint8_t* buf, uint
 
         uint64_t page_addr = hostAddress & S2E_RAM_OBJECT_MASK;
 
-        //ObjectPair op = addressSpace.findObject(page_addr);
-        ObjectPair op = m_memcache.get(page_addr);
-        if (!op.first) {
-            op = addressSpace.findObject(page_addr);
-            m_memcache.put(page_addr, op);
-        }
-
+        ObjectPair op = findRamObject(page_addr);
 
-        assert(op.first && op.first->isUserSpecified &&
-               op.first->address == page_addr &&
-               op.first->size == S2E_RAM_OBJECT_SIZE);
+        if (op.second->readConcrete(page_offset, buf, size)) {
+            return;
+        }
 
         ObjectState *wos = NULL;
         for(uint64_t i=0; i<size; ++i) {
@@ -1337,21 +1409,14 @@ void S2EExecutionState::writeRamConcrete(uint64_t hostAddress, const uint8_t* bu
         uint64_t page_addr = hostAddress & S2E_RAM_OBJECT_MASK;
 
 
-        //ObjectPair op = addressSpace.findObject(page_addr);
-        ObjectPair op = m_memcache.get(page_addr);
-        if (!op.first) {
-            op = addressSpace.findObject(page_addr);
-            m_memcache.put(page_addr, op);
-        }
-
-        assert(op.first && op.first->isUserSpecified &&
-               op.first->address == page_addr &&
-               op.first->size == S2E_RAM_OBJECT_SIZE);
+        ObjectPair op = findRamObject(page_addr);
 
-        ObjectState* wos =
-                addressSpace.getWriteable(op.first, op.second);
-        for(uint64_t i=0; i<size; ++i) {
-            wos->write8(page_offset+i, buf[i]);
+        if (op.first->isSharedConcrete) {
+            memcpy((uint8_t*) page_addr + page_offset, buf, size);
+        } else {
+            ObjectState* wos =
+                    addressSpace.getWriteable(op.first, op.second);
+            wos->writeConcrete(page_offset, buf, size);
         }
 
     } else {
@@ -1929,29 +1994,12 @@ void S2EExecutionState::dmaRead(uint64_t hostAddress, uint8_t *buf, unsigned siz
             length = size;
         }
 
-        ObjectPair op = m_memcache.get(hostPage);
-        if (!op.first) {
-            op = addressSpace.findObject(hostPage);
-            m_memcache.put(hostAddress, op);
-        }
-        assert(op.first && op.second && op.first->address == hostPage);
-        ObjectState *os = const_cast<ObjectState*>(op.second);
-        uint8_t *concreteStore;
-
+        ObjectPair op = findRamObject(hostPage);
         unsigned offset = hostAddress & (S2E_RAM_OBJECT_SIZE-1);
 
-        if (op.first->isSharedConcrete) {
-            concreteStore = (uint8_t*)op.first->address;
-            memcpy(buf, concreteStore + offset, length);
-        } else {
-            concreteStore = os->getConcreteStore(true);
-            for (unsigned i=0; i<length; ++i) {
-                if (_s2e_check_concrete(os, offset+i, 1)) {
-                    buf[i] = concreteStore[offset+i];
-                }else {
-                    readRamConcrete(hostAddress+i, &buf[i], sizeof(buf[i]));
-                }
-            }
+        if (!op.second->readConcrete(offset, buf, length)) {
+            /* Concretizes the symbolic bytes of this object only */
+            readRamConcrete(hostAddress, buf, length);
         }
 
         buf+=length;
@@ -1969,33 +2017,17 @@ void S2EExecutionState::dmaWrite(uint64_t hostAddress, uint8_t *buf, unsigned si
             length = size;
         }
 
-
-        ObjectPair op = m_memcache.get(hostPage);
-        if (!op.first) {
-            op = addressSpace.findObject(hostPage);
-            m_memcache.put(hostAddress, op);
-        }
-
-        assert(op.first && op.second && op.first->address == hostPage);
-        ObjectState *os = addressSpace.getWriteable(op.first, op.second);
-        uint8_t *concreteStore;
-
+        ObjectPair op = findRamObject(hostPage);
         unsigned offset = hostAddress & (S2E_RAM_OBJECT_SIZE-1);
 
         if (op.first->isSharedConcrete) {
-            concreteStore = (uint8_t*)op.first->address;
-            memcpy(concreteStore + offset, buf, length);
+            /* No need to copy the object state for shared memory */
+            memcpy((uint8_t*)hostPage + offset, buf, length);
         } else {
-            concreteStore = os->getConcreteStore(true);
-
-            for (unsigned i=0; i<length; ++i) {
-                if (_s2e_check_concrete(os, offset+i, 1)) {
-                    concreteStore[offset+i] = buf[i];
-                }else {
-                    writeRamConcrete(hostAddress+i, &buf[i], sizeof(buf[i]));
-                }
-            }
+            ObjectState *os = addressSpace.getWriteable(op.first, op.second);
+            os->writeConcrete(offset, buf, length);
         }
+
         buf+=length;
         hostAddress+=length;
         size -= length;
@@ -91,7 +91,6 @@ typedef std::map<const Plugin*, PluginState*> PluginStateMap;
 typedef PluginState* (*PluginStateFactory)(Plugin *p, S2EExecutionState *s);
 
 typedef MemoryCachePool<klee::ObjectPair,
-                S2E_RAM_OBJECT_BITS,
                 TARGET_PAGE_BITS,
                 S2E_MEMCACHE_SUPERPAGE_BITS> S2EMemoryCache;
 
@@ -130,6 +129,12 @@ protected:
               in shared locations, for inactive - in ObjectStates. */
     bool m_active;
 
+    /** Set to true for forked states that have not been selected yet.
+        Such states still use the cpu and dirty mask objects they had at
+        the fork point, and get their own writable copies in materialize()
+        when the searcher first picks them. */
+    bool m_suspended;
+
     /** Set to true when the state is killed. The cpu loop actively checks
         for such a condition, and, when met, asks the scheduler to get a new
         state */
@@ -196,12 +201,16 @@ protected:
     bool m_runningExceptionEmulationCode;
 
     ExecutionState* clone();
+    void materialize();
     void addressSpaceChange(const klee::MemoryObject *mo,
                             const klee::ObjectState *oldState,
                             klee::ObjectState *newState);
 
     std::string getUniqueVarName(const std::string &name);
 
+    /** Return the RAM object that starts at hostPage, using the memory cache */
+    klee::ObjectPair findRamObject(uint64_t hostPage) const;
+
 public:
     enum AddressType {
         VirtualAddress, PhysicalAddress, HostAddress
@@ -235,6 +244,12 @@ public:
     /** Returns true if this is the active state */
     bool isActive() const { return m_active; }
 
+    /** Returns true if this state was forked but never selected since */
+    bool isSuspended() const { return m_suspended; }
+
+    /** Returns the memory attributed to this state */
+    void getMemoryUsage(S2EStateMemoryUsage &usage) const;
+
     bool isZombie() const { return m_zombie; }
     void zombify() { m_zombie = true; }
 
@@ -296,6 +311,9 @@ public:
     bool getReturnAddress(uint64_t *retAddr);
     bool bypassFunction(unsigned paramCount);
 
+    /** Write the register that holds the return value of functions */
+    void setReturnValue(uint64_t value);
+
     void jumpToSymbolic();
     void jumpToSymbolicCpp();
     bool needToJumpToSymbolic() const;
@@ -335,11 +353,12 @@ public:
     bool isRamSharedConcrete(uint64_t hostAddress);
 
 
-    /** Read value from memory, returning false if the value is symbolic */
+    /** Read value from memory, returning false if the value is symbolic.
+        The buffer is copied one memory object at a time. */
     bool readMemoryConcrete(uint64_t address, void *buf, uint64_t size,
                             AddressType addressType = VirtualAddress);
 
-    /** Write concrete value to memory */
+    /** Write concrete value to memory, one memory object at a time */
     bool writeMemoryConcrete(uint64_t address, void *buf,
                              uint64_t size, AddressType addressType=VirtualAddress);
 
@@ -414,7 +433,8 @@ public:
     bool writeMemory64(uint64_t address, uint64_t value,
                        AddressType addressType = VirtualAddress);
 
-    /** Fast routines used by the DMA subsystem */
+    /** Fast routines used by the DMA subsystem. Symbolic bytes
+        are concretized on read and overwritten on write. */
     void dmaRead(uint64_t hostAddress, uint8_t *buf, unsigned size);
     void dmaWrite(uint64_t hostAddress, uint8_t *buf, unsigned size);
 
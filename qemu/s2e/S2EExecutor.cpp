@@ -85,6 +85,7 @@ uint64_t helper_set_cc_op_eflags(void);
 #include <s2e/S2EDeviceState.h>
 #include <s2e/SelectRemovalPass.h>
 #include <s2e/S2EStatsTracker.h>
+#include <s2e/S2EStateSwapper.h>
 
 //XXX: Remove this from executor
 #include <s2e/Plugins/ModuleExecutionDetector.h>
@@ -112,6 +113,7 @@ uint64_t helper_set_cc_op_eflags(void);
 #include <klee/CoreStats.h>
 #include <klee/TimerStatIncrementer.h>
 #include <klee/Solver.h>
+#include <klee/MemoryUsage.h>
 
 #include <llvm/Support/TimeValue.h>
 
@@ -150,6 +152,23 @@ namespace {
         }
         return initial;
     }
+
+    /* LLVM functions generated for translation blocks and not removed yet.
+       The bytes are a lower bound: the size of the IR objects without
+       their types, names, metadata and KLEE instructions. */
+    klee::MemoryCounter tbLlvmFunctions("TbLlvmFunctions");
+
+    uint64_t getLlvmFunctionBytes(const llvm::Function *f) {
+        uint64_t bytes = sizeof(llvm::Function);
+        foreach2(bb, f->begin(), f->end()) {
+            bytes += sizeof(llvm::BasicBlock);
+            foreach2(i, bb->begin(), bb->end()) {
+                bytes += sizeof(llvm::Instruction) +
+                         i->getNumOperands() * sizeof(llvm::Use);
+            }
+        }
+        return bytes;
+    }
 }
 
 namespace {
@@ -164,6 +183,27 @@ namespace {
             cl::init(false));
 
 
+    cl::opt<unsigned>
+    StateSwapHighWatermark("state-swap-high-watermark",
+            cl::desc("Swap inactive states out to disk when the memory usage exceeds this many MB (0 to disable)"),
+            cl::init(0));
+
+    cl::opt<unsigned>
+    StateSwapLowWatermark("state-swap-low-watermark",
+            cl::desc("Memory usage in MB to get back to when swapping states out (default: 3/4 of the high watermark)"),
+            cl::init(0));
+
+    cl::opt<std::string>
+    StateSwapDirectory("state-swap-dir",
+            cl::desc("Directory where swapped out states are stored (default: swap in the output directory)"));
+
+#ifdef S2E_ENABLE_S2E_TLB
+    cl::opt<unsigned>
+    RamObjectBits("ram-object-bits",
+            cl::desc("Split guest RAM into symbolic memory objects of 2^N bytes"),
+            cl::init(S2E_RAM_OBJECT_MIN_BITS));
+#endif
+
     cl::opt<bool>
     FlushTBsOnStateSwitch("flush-tbs-on-state-switch",
             cl::desc("Flush translation blocks when switching states -"
@@ -251,12 +291,20 @@ cl::opt<bool>
 DebugConstraints("debug-constraints",
                cl::desc("Check that added constraints are satisfiable"),  cl::init(false));
 
+cl::opt<bool>
+LazyForkMaterialization("lazy-fork-materialization",
+               cl::desc("Copy the cpu state of forked states only when they are first selected"),
+               cl::init(true));
+
 
 
 
 extern cl::opt<bool> UseExprSimplifier;
 
 extern "C" {
+#ifdef S2E_ENABLE_S2E_TLB
+    unsigned g_s2e_ram_object_bits = S2E_RAM_OBJECT_MIN_BITS;
+#endif
     int g_s2e_fork_on_symbolic_address = 0;
     int g_s2e_concretize_io_addresses = 1;
     int g_s2e_concretize_io_writes = 1;
@@ -425,7 +473,10 @@ void S2EExecutor::handlerTraceMemoryAccess(Executor* executor,
     assert(dynamic_cast<S2EExecutor*>(executor));
 
     S2EExecutor* s2eExecutor = static_cast<S2EExecutor*>(executor);
-    if(!s2eExecutor->m_s2e->getCorePlugin()->onDataMemoryAccess.empty()) {
+    CorePlugin *core = s2eExecutor->m_s2e->getCorePlugin();
+    bool traceConcrete = core->hasConcreteDataMemoryAccessListeners();
+
+    if(traceConcrete || !core->onDataMemoryAccess.empty()) {
         assert(dynamic_cast<S2EExecutionState*>(state));
         S2EExecutionState* s2eState = static_cast<S2EExecutionState*>(state);
 
@@ -437,8 +488,31 @@ void S2EExecutor::handlerTraceMemoryAccess(Executor* executor,
 
         ref<Expr> value = klee::ExtractExpr::create(args[2], 0, width);
 
-        s2eExecutor->m_s2e->getCorePlugin()->onDataMemoryAccess.emit(
-                s2eState, args[0], args[1], value, isWrite, isIO);
+        klee::ConstantExpr *vaddr = dyn_cast<klee::ConstantExpr>(args[0]);
+        klee::ConstantExpr *haddr = dyn_cast<klee::ConstantExpr>(args[1]);
+        if (traceConcrete && vaddr && haddr) {
+            unsigned flags = (isWrite ? MEM_TRACE_FLAG_WRITE : 0) |
+                             (isIO ? MEM_TRACE_FLAG_IO : 0);
+            uint64_t concreteValue = 0;
+            if (klee::ConstantExpr *ce = dyn_cast<klee::ConstantExpr>(value)) {
+                concreteValue = ce->getZExtValue();
+            } else {
+                flags |= MEM_TRACE_FLAG_SYMBOLIC_VALUE;
+                if (ConcolicMode) {
+                    ref<Expr> cv = s2eState->concolics.evaluate(value);
+                    concreteValue = cast<klee::ConstantExpr>(cv)->getZExtValue();
+                }
+            }
+
+            core->emitConcreteDataMemoryAccess(s2eState,
+                    vaddr->getZExtValue(), haddr->getZExtValue(),
+                    concreteValue, Expr::getMinBytesForWidth(width), flags);
+        }
+
+        if (!core->onDataMemoryAccess.empty()) {
+            core->onDataMemoryAccess.emit(
+                    s2eState, args[0], args[1], value, isWrite, isIO);
+        }
     }
 }
 
@@ -621,7 +695,8 @@ S2EExecutor::S2EExecutor(S2E* s2e, TCGLLVMContext *tcgLLVMContext,
         : Executor(opts, ie, tcgLLVMContext->getExecutionEngine()),
           m_s2e(s2e), m_tcgLLVMContext(tcgLLVMContext),
           m_executeAlwaysKlee(false), m_forkProcTerminateCurrentState(false),
-          m_inLoadBalancing(false), yieldedState(NULL)
+          m_inLoadBalancing(false), yieldedState(NULL),
+          m_stateSwapper(NULL)
 {
     delete externalDispatcher;
     externalDispatcher = new S2EExternalDispatcher(
@@ -648,6 +723,9 @@ S2EExecutor::S2EExecutor(S2E* s2e, TCGLLVMContext *tcgLLVMContext,
     __DEFINE_EXT_VARIABLE(g_s2e_concretize_io_addresses)
     __DEFINE_EXT_VARIABLE(g_s2e_concretize_io_writes)
     __DEFINE_EXT_VARIABLE(g_s2e_fork_on_symbolic_address)
+#ifdef S2E_ENABLE_S2E_TLB
+    __DEFINE_EXT_VARIABLE(g_s2e_ram_object_bits)
+#endif
 
     __DEFINE_EXT_VARIABLE(g_s2e_enable_mmio_checks)
 
@@ -891,8 +969,41 @@ S2EExecutor::S2EExecutor(S2E* s2e, TCGLLVMContext *tcgLLVMContext,
 
     searcher = constructUserSearcher(*this);
 
+    if (StateSwapHighWatermark) {
+        uint64_t high = (uint64_t) StateSwapHighWatermark * 1024 * 1024;
+        uint64_t low = (uint64_t) StateSwapLowWatermark * 1024 * 1024;
+        if (!low) {
+            low = high / 4 * 3;
+        } else if (low > high) {
+            s2e->getWarningsStream()
+                    << StateSwapLowWatermark.ArgStr << " must not exceed "
+                    << StateSwapHighWatermark.ArgStr << "\n";
+            exit(-1);
+        }
+
+        std::string directory = StateSwapDirectory;
+        if (directory.empty()) {
+            directory = s2e->getOutputFilename("swap");
+        }
+
+        m_stateSwapper = new S2EStateSwapper(directory, high, low);
+    }
+
     m_forceConcretizations = false;
 
+#ifdef S2E_ENABLE_S2E_TLB
+    /* The S2E TLB of the CPU state only has room down to the minimum */
+    if (RamObjectBits < S2E_RAM_OBJECT_MIN_BITS ||
+        RamObjectBits > TARGET_PAGE_BITS) {
+        s2e->getWarningsStream()
+                << RamObjectBits.ArgStr << " must be between "
+                << S2E_RAM_OBJECT_MIN_BITS << " and " << TARGET_PAGE_BITS
+                << "\n";
+        exit(-1);
+    }
+    g_s2e_ram_object_bits = RamObjectBits;
+#endif
+
     g_s2e_fork_on_symbolic_address = ForkOnSymbolicAddress;
     g_s2e_concretize_io_addresses = ConcretizeIoAddress;
     g_s2e_concretize_io_writes = ConcretizeIoWrites;
@@ -930,6 +1041,8 @@ S2EExecutor::~S2EExecutor()
 {
     if(statsTracker)
         statsTracker->done();
+
+    delete m_stateSwapper;
 }
 
 S2EExecutionState* S2EExecutor::createInitialState()
@@ -1138,7 +1251,8 @@ void S2EExecutor::registerRam(S2EExecutionState *initialState,
         m_unusedMemoryRegions.push_back(make_pair(hostAddress, size));
     }
 
-    initialState->m_memcache.registerPool(hostAddress, size);
+    initialState->m_memcache.registerPool(hostAddress, size,
+                                          S2E_RAM_OBJECT_BITS);
 
 }
 
@@ -1419,7 +1533,7 @@ void S2EExecutor::doStateSwitch(S2EExecutionState* oldState,
         //after the state is activated
         //XXX: assigning g_s2e_state here is ugly but is required for restoreDeviceState...
         g_s2e_state = newState;
-        newState->getDeviceState()->restoreDeviceState();
+        newState->getDeviceState()->restoreDeviceState(oldState != NULL);
 
         /**
          * Memory region layout may change in between state switches.
@@ -1464,6 +1578,10 @@ ExecutionState* S2EExecutor::selectNonSpeculativeState(S2EExecutionState *state)
 
         newState = &searcher->selectState();
 
+        if (m_stateSwapper) {
+            m_stateSwapper->swapIn(static_cast<S2EExecutionState*>(newState));
+        }
+
         if (newState->isSpeculative()) {
             //The searcher wants us to execute a speculative state.
             //The engine must make sure that such a state
@@ -1534,7 +1652,16 @@ S2EExecutionState* S2EExecutor::selectNextState(S2EExecutionState *state)
     // so that we can schedule it again.
     restoreYieldedState();
 
+    //Speculative states were resolved above, infeasible ones
+    //were killed without ever copying their cpu state.
+    newState->materialize();
+
+    if (m_stateSwapper) {
+        m_stateSwapper->stateSelected(newState);
+    }
+
     if(newState != state) {
+        g_s2e->getCorePlugin()->flushMemoryAccessBatch();
         g_s2e->getCorePlugin()->onStateSwitch.emit(state, newState);
         vm_stop(RUN_STATE_SAVE_VM);
         doStateSwitch(state, newState);
@@ -1551,56 +1678,70 @@ S2EExecutionState* S2EExecutor::selectNextState(S2EExecutionState *state)
     }
     m_deletedStates.clear();
 
+    //The previous state is now inactive and may be swapped out
+    if (m_stateSwapper) {
+        m_stateSwapper->checkMemoryUsage(states);
+    }
+
     return newState;
 }
 
-/** Simulate start of function execution, creating KLEE structs of required */
-void S2EExecutor::prepareFunctionExecution(S2EExecutionState *state,
-                            llvm::Function *function,
-                            const std::vector<klee::ref<klee::Expr> > &args)
+/** Create KLEE structs for the function if required */
+KFunction *S2EExecutor::prepareKFunction(llvm::Function *function)
 {
-    KFunction *kf;
     typeof(kmodule->functionMap.begin()) it =
             kmodule->functionMap.find(function);
     if(it != kmodule->functionMap.end()) {
-        kf = it->second;
-    } else {
+        return it->second;
+    }
 
-        unsigned cIndex = kmodule->constants.size();
-        kf = kmodule->updateModuleWithFunction(function);
-
-        for(unsigned i = 0; i < kf->numInstructions; ++i)
-            bindInstructionConstants(kf->instructions[i]);
-
-        /* Update global functions (new functions can be added
-           while creating added function) */
-        for (Module::iterator i = kmodule->module->begin(),
-                              ie = kmodule->module->end(); i != ie; ++i) {
-            Function *f = i;
-            ref<klee::ConstantExpr> addr(0);
-
-            // If the symbol has external weak linkage then it is implicitly
-            // not defined in this module; if it isn't resolvable then it
-            // should be null.
-            if (f->hasExternalWeakLinkage() &&
-                    !externalDispatcher->resolveSymbol(f->getName())) {
-                addr = Expr::createPointer(0);
-            } else {
-                addr = Expr::createPointer((uintptr_t) (void*) f);
-                legalFunctions.insert((uint64_t) (uintptr_t) (void*) f);
-            }
+    unsigned cIndex = kmodule->constants.size();
+    KFunction *kf = kmodule->updateModuleWithFunction(function);
 
-            globalAddresses.insert(std::make_pair(f, addr));
-        }
+    for(unsigned i = 0; i < kf->numInstructions; ++i)
+        bindInstructionConstants(kf->instructions[i]);
 
-        kmodule->constantTable.resize(kmodule->constants.size());
+    /* Update global functions (new functions can be added
+       while creating added function) */
+    for (Module::iterator i = kmodule->module->begin(),
+                          ie = kmodule->module->end(); i != ie; ++i) {
+        Function *f = i;
+        ref<klee::ConstantExpr> addr(0);
 
-        for(unsigned i = cIndex; i < kmodule->constants.size(); ++i) {
-            Cell &c = kmodule->constantTable[i];
-            c.value = evalConstant(kmodule->constants[i]);
+        // If the symbol has external weak linkage then it is implicitly
+        // not defined in this module; if it isn't resolvable then it
+        // should be null.
+        if (f->hasExternalWeakLinkage() &&
+                !externalDispatcher->resolveSymbol(f->getName())) {
+            addr = Expr::createPointer(0);
+        } else {
+            addr = Expr::createPointer((uintptr_t) (void*) f);
+            legalFunctions.insert((uint64_t) (uintptr_t) (void*) f);
         }
+
+        globalAddresses.insert(std::make_pair(f, addr));
+    }
+
+    kmodule->constantTable.resize(kmodule->constants.size());
+
+    for(unsigned i = cIndex; i < kmodule->constants.size(); ++i) {
+        Cell &c = kmodule->constantTable[i];
+        c.value = evalConstant(kmodule->constants[i]);
     }
 
+    if(statsTracker)
+        statsTracker->functionAdded(kf);
+
+    return kf;
+}
+
+/** Simulate start of function execution, creating KLEE structs of required */
+void S2EExecutor::prepareFunctionExecution(S2EExecutionState *state,
+                            llvm::Function *function,
+                            const std::vector<klee::ref<klee::Expr> > &args)
+{
+    KFunction *kf = prepareKFunction(function);
+
     /* Emulate call to a TB function */
     state->prevPC = state->pc;
 
@@ -2149,6 +2290,9 @@ void S2EExecutor::notifyBranch(ExecutionState &state)
 {
     S2EExecutionState *s2eState = dynamic_cast<S2EExecutionState*>(&state);
 
+    /* Accesses recorded so far belong to the parent only */
+    m_s2e->getCorePlugin()->flushMemoryAccessBatch();
+
     /* Checkpoint the device state before branching */
     qemu_aio_flush();
     bdrv_flush_all();
@@ -2222,6 +2366,14 @@ bool S2EExecutor::merge(klee::ExecutionState &_base, klee::ExecutionState &_othe
     else if(other.m_active)
         doStateSwitch(&other, NULL);
 
+    if (m_stateSwapper) {
+        m_stateSwapper->swapIn(&base);
+        m_stateSwapper->swapIn(&other);
+    }
+
+    /* The merged cpu state is written in place */
+    base.materialize();
+
     if(base.merge(other)) {
         m_s2e->getMessagesStream(&base)
                 << "Merged with state " << other.getID() << '\n';
@@ -2244,6 +2396,13 @@ void S2EExecutor::terminateStateEarly(klee::ExecutionState &state, const llvm::T
 void S2EExecutor::terminateState(ExecutionState &s)
 {
     S2EExecutionState& state = static_cast<S2EExecutionState&>(s);
+    m_s2e->getCorePlugin()->flushMemoryAccessBatch();
+
+    //Handlers may look at the memory of the state
+    if (m_stateSwapper) {
+        m_stateSwapper->swapIn(&state);
+    }
+
     m_s2e->getCorePlugin()->onStateKill.emit(&state);
 
     terminateStateAtFork(state);
@@ -2306,6 +2465,10 @@ void S2EExecutor::yieldState(ExecutionState &s)
 
 void S2EExecutor::terminateStateAtFork(S2EExecutionState &state)
 {
+    if (m_stateSwapper) {
+        m_stateSwapper->stateDiscarded(&state);
+    }
+
     Executor::terminateState(state);
 }
 
@@ -2453,7 +2616,11 @@ void S2EExecutor::unrefS2ETb(S2ETranslationBlock* s2e_tb)
         if(s2e_tb->llvm_function && !KeepLLVMFunctions) {
             S2EExternalDispatcher *s2eDispatcher = static_cast<S2EExternalDispatcher*>(externalDispatcher);
             s2eDispatcher->removeFunction(s2e_tb->llvm_function);
+            if(statsTracker)
+                statsTracker->functionRemoved(
+                        kmodule->functionMap[s2e_tb->llvm_function]);
             kmodule->removeFunction(s2e_tb->llvm_function);
+            tbLlvmFunctions.freed(s2e_tb->llvmFunctionBytes);
         }
         foreach(void* s, s2e_tb->executionSignals) {
             delete static_cast<ExecutionSignal*>(s);
@@ -2461,6 +2628,32 @@ void S2EExecutor::unrefS2ETb(S2ETranslationBlock* s2e_tb)
     }
 }
 
+void S2EExecutor::prefetchLlvmCode(TranslationBlock *tb)
+{
+    tb->s2e_tb->prefetchLlvm = true;
+}
+
+/**
+ *  Generates LLVM code for blocks flagged by prefetchLlvmCode().
+ *  This runs right after QEMU translated the block, while the guest
+ *  code it was translated from is still mapped at the same place.
+ *  The translator, the LLVM context, and the KLEE module are not
+ *  thread-safe, so the work cannot be moved to a separate thread.
+ *  It is moved out of executeTranslationBlockKlee() instead, which
+ *  then only has to look up the KFunction.
+ */
+void S2EExecutor::onTranslationComplete(CPUArchState *env, TranslationBlock *tb)
+{
+    if (!tb->s2e_tb->prefetchLlvm || tb->llvm_function) {
+        return;
+    }
+
+    cpu_gen_llvm(env, tb);
+    assert(tb->llvm_function);
+
+    prepareKFunction(tb->llvm_function);
+}
+
 void S2EExecutor::queueStateForMerge(S2EExecutionState *state)
 {
     if(dynamic_cast<MergingSearcher*>(searcher) == NULL) {
@@ -2557,8 +2750,10 @@ uintptr_t s2e_qemu_tb_exec(CPUArchState* env1, struct TranslationBlock* tb)
 
     try {
         uintptr_t ret = g_s2e->getExecutor()->executeTranslationBlock(g_s2e_state, tb);
+        g_s2e->getCorePlugin()->flushMemoryAccessBatch();
         return ret;
     } catch(s2e::CpuExitException&) {
+        g_s2e->getCorePlugin()->flushMemoryAccessBatch();
         g_s2e->getExecutor()->updateStates(g_s2e_state);
         s2e_longjmp(env->jmp_env, 1);
     }
@@ -2648,6 +2843,11 @@ void s2e_tb_alloc(S2E*, TranslationBlock *tb)
 {
     tb->s2e_tb = new S2ETranslationBlock;
     tb->s2e_tb->llvm_function = NULL;
+    tb->s2e_tb->llvmFunctionBytes = 0;
+    tb->s2e_tb->prefetchLlvm = false;
+    tb->s2e_tb->module = NULL;
+    tb->s2e_tb->modulePid = 0;
+    tb->s2e_tb->moduleIndexId = (uint64_t) -1;
     tb->s2e_tb->refCount = 1;
 
     /* Push one copy of a signal to use it as a cache */
@@ -2660,6 +2860,13 @@ void s2e_tb_alloc(S2E*, TranslationBlock *tb)
 void s2e_set_tb_function(S2E*, TranslationBlock *tb)
 {
     tb->s2e_tb->llvm_function = tb->llvm_function;
+    tb->s2e_tb->llvmFunctionBytes = getLlvmFunctionBytes(tb->llvm_function);
+    tbLlvmFunctions.allocated(tb->s2e_tb->llvmFunctionBytes);
+}
+
+void s2e_on_translation_complete(S2E *s2e, CPUArchState *env1, TranslationBlock *tb)
+{
+    s2e->getExecutor()->onTranslationComplete(env1, tb);
 }
 
 void s2e_tb_free(S2E* s2e, TranslationBlock *tb)
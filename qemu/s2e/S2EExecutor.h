@@ -53,7 +53,9 @@ namespace s2e {
 
 class S2E;
 class S2EExecutionState;
+class S2EStateSwapper;
 struct S2ETranslationBlock;
+struct ModuleDescriptor;
 
 class CpuExitException
 {
@@ -115,6 +117,9 @@ protected:
     /** Holds the yielded state, if any */
     S2EExecutionState* yieldedState;
 
+    /** Swaps inactive states out under memory pressure, if enabled */
+    S2EStateSwapper *m_stateSwapper;
+
     /** Moves yielded state back into list of schedulable states */
     void restoreYieldedState(void);
 
@@ -213,6 +218,14 @@ public:
 
     void unrefS2ETb(S2ETranslationBlock* s2e_tb);
 
+    /** Request LLVM code generation for a block that is being translated.
+        Meant to be called from onTranslateBlockStart/End handlers
+        for blocks that are likely to run symbolically. */
+    void prefetchLlvmCode(TranslationBlock *tb);
+
+    /** Called by QEMU once the translation of the block is complete */
+    void onTranslationComplete(CPUArchState *env, TranslationBlock *tb);
+
     void queueStateForMerge(S2EExecutionState *state);
 
     void initializeStatistics();
@@ -232,6 +245,12 @@ public:
         return yieldedState;
     }
 
+    /** Plugins that access the memory of inactive states must swap
+        them in first. Returns NULL if swapping is disabled. */
+    S2EStateSwapper* getStateSwapper() const {
+        return m_stateSwapper;
+    }
+
 protected:
     static void handlerTraceMemoryAccess(klee::Executor* executor,
                                     klee::ExecutionState* state,
@@ -269,6 +288,8 @@ protected:
                                klee::KInstruction* target,
                                std::vector<klee::ref<klee::Expr> > &args);
     
+    klee::KFunction *prepareKFunction(llvm::Function *function);
+
     void prepareFunctionExecution(S2EExecutionState *state,
                            llvm::Function* function,
                            const std::vector<klee::ref<klee::Expr> >& args);
@@ -438,6 +459,21 @@ struct S2ETranslationBlock
         even after TranslationBlock is destroyed */
     llvm::Function* llvm_function;
 
+    /** Size of llvm_function reported to the TbLlvmFunctions counter */
+    uint64_t llvmFunctionBytes;
+
+    /** Set when a plugin expects the block to run symbolically.
+        LLVM code and the KLEE function for such blocks are generated
+        right after translation instead of on first symbolic execution. */
+    bool prefetchLlvm;
+
+    /** Module containing the first instruction of the block, as resolved
+        by ModuleExecutionDetector. The entry is only valid for the given
+        pid and version of that process' module index. */
+    const ModuleDescriptor *module;
+    uint64_t modulePid;
+    uint64_t moduleIndexId;
+
     /** A list of all instruction execution signals associated with
         this basic block. All signals in the list will be deleted
         when this translation block will be flushed.
@@ -0,0 +1,157 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2E_SHAREDSTATS_H
+#define S2E_SHAREDSTATS_H
+
+#include <inttypes.h>
+
+#include "s2e_config.h"
+
+/**
+ *  Layout of the statistics segment shared by all S2E processes.
+ *
+ *  The segment is a file in the base output directory that every process
+ *  maps. Each process owns one slot and refreshes it each time it writes
+ *  a run.stats line. Slots are updated without locks using a sequence
+ *  counter: the writer makes it odd before touching the fields and even
+ *  afterwards, readers retry when they see an odd or changed sequence.
+ *
+ *  This header is also used by the offline tools, it must not depend
+ *  on QEMU or KLEE.
+ */
+
+#define S2E_SHARED_STATS_FILE "stats.shm"
+#define S2E_SHARED_STATS_MAGIC 0x53324553544154ULL
+#define S2E_SHARED_STATS_VERSION 1
+
+namespace s2e {
+
+struct S2ESharedStatsSlot {
+    uint64_t sequence;
+
+    //Set while the process is running
+    uint64_t active;
+    uint64_t pid;
+    uint64_t processIndex;
+
+    //All times are in microseconds
+    uint64_t updateTime;
+    uint64_t wallTime;
+    uint64_t userTime;
+
+    uint64_t statesCount;
+    uint64_t translationBlocks;
+    uint64_t translationBlocksConcrete;
+    uint64_t translationBlocksKlee;
+    uint64_t cpuInstructions;
+    uint64_t cpuInstructionsConcrete;
+    uint64_t cpuInstructionsKlee;
+    uint64_t queries;
+    uint64_t queryTime;
+    uint64_t solverTime;
+    uint64_t forkTime;
+    uint64_t memoryUsage;
+
+    //Keep slots on separate cache lines
+    uint64_t reserved[5];
+};
+
+struct S2ESharedStats {
+    uint64_t magic;
+    uint64_t version;
+    uint64_t slotCount;
+    uint64_t startTime;
+    uint64_t reserved[4];
+
+    S2ESharedStatsSlot slots[S2E_MAX_PROCESSES];
+};
+
+static inline void s2e_shared_stats_begin_update(S2ESharedStatsSlot *slot)
+{
+    ++*(volatile uint64_t*) &slot->sequence;
+    __sync_synchronize();
+}
+
+static inline void s2e_shared_stats_end_update(S2ESharedStatsSlot *slot)
+{
+    __sync_synchronize();
+    ++*(volatile uint64_t*) &slot->sequence;
+}
+
+/**
+ *  Ends the update of a slot whose owner died, possibly in the middle
+ *  of its own update, and marks it inactive.
+ */
+static inline void s2e_shared_stats_release(S2ESharedStatsSlot *slot)
+{
+    if (!(*(volatile uint64_t*) &slot->sequence & 1)) {
+        s2e_shared_stats_begin_update(slot);
+    }
+    slot->active = 0;
+    s2e_shared_stats_end_update(slot);
+}
+
+/**
+ *  Takes a consistent snapshot of a slot written by another process.
+ *  Returns false if the slot stays in the middle of an update, which
+ *  happens when its owner died while writing it.
+ */
+static inline bool s2e_shared_stats_read(const S2ESharedStatsSlot *slot, S2ESharedStatsSlot *result)
+{
+    const volatile uint64_t *src = (const volatile uint64_t*) slot;
+    uint64_t *dst = (uint64_t*) result;
+    uint64_t seq;
+    unsigned tries = 0;
+
+    do {
+        if (++tries > 100000) {
+            return false;
+        }
+        seq = src[0];
+        __sync_synchronize();
+        for (unsigned i = 1; i < sizeof(*slot) / sizeof(uint64_t); ++i) {
+            dst[i] = src[i];
+        }
+        __sync_synchronize();
+    } while ((seq & 1) || seq != src[0]);
+
+    result->sequence = seq;
+    return true;
+}
+
+} // namespace s2e
+
+#endif // S2E_SHAREDSTATS_H
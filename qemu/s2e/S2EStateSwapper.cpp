@@ -0,0 +1,327 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include "S2EStateSwapper.h"
+
+#include <s2e/S2E.h>
+#include <s2e/S2EExecutionState.h>
+#include <s2e/S2EExecutor.h>
+#include <s2e/S2EStatsTracker.h>
+#include <s2e/Utils.h>
+#include <s2e/s2e_config.h>
+
+#include <klee/Memory.h>
+#include <klee/util/Assignment.h>
+#include <klee/Internal/System/Time.h>
+
+#include <llvm/Support/Path.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace s2e {
+
+using namespace klee;
+
+S2EStateSwapper::S2EStateSwapper(const std::string &directory,
+                                 uint64_t highWatermark, uint64_t lowWatermark):
+        m_directory(directory),
+        m_highWatermark(highWatermark), m_lowWatermark(lowWatermark),
+        m_usageAfterSwapOut(0), m_lastCheck(0),
+        m_swappedBytes(0), m_selections(0)
+{
+    assert(m_lowWatermark <= m_highWatermark);
+
+    llvm::sys::Path dirPath(m_directory);
+    std::string mkdirError;
+    if (dirPath.createDirectoryOnDisk(true, &mkdirError)) {
+        g_s2e->getWarningsStream() << "Could not create the state swap directory "
+                << m_directory << ": " << mkdirError << '\n';
+        exit(-1);
+    }
+
+    ObjectState::releasedStoreLoader = &S2EStateSwapper::loadReleasedStore;
+}
+
+S2EStateSwapper::~S2EStateSwapper()
+{
+    ObjectState::releasedStoreLoader = NULL;
+
+    foreach2(it, m_swapped.begin(), m_swapped.end()) {
+        unlink((*it).second.path.c_str());
+    }
+
+    //Fails if other processes still have states in there
+    rmdir(m_directory.c_str());
+}
+
+void S2EStateSwapper::checkMemoryUsage(const std::set<ExecutionState*> &states)
+{
+    //Reading the memory usage is not free, once per second is enough
+    double now = util::getWallTime();
+    if (now - m_lastCheck < 1.0) {
+        return;
+    }
+    m_lastCheck = now;
+
+    uint64_t usage = S2EStatsTracker::getProcessMemoryUsage();
+    if (usage <= m_highWatermark || usage <= m_usageAfterSwapOut) {
+        return;
+    }
+
+    //Coldest states first, i.e., the ones that were never selected
+    //or that were selected the longest time ago
+    typedef std::pair<std::pair<uint64_t, int>, S2EExecutionState*> Candidate;
+    std::vector<Candidate> candidates;
+
+    foreach2(it, states.begin(), states.end()) {
+        S2EExecutionState *state = static_cast<S2EExecutionState*>(*it);
+        if (state->isActive() || state->isZombie() || isSwappedOut(state)) {
+            continue;
+        }
+
+        std::map<S2EExecutionState*, uint64_t>::iterator sit =
+                m_lastSelected.find(state);
+        uint64_t lastSelected = sit == m_lastSelected.end() ? 0 : (*sit).second;
+        candidates.push_back(Candidate(std::make_pair(lastSelected,
+                                                      state->getID()), state));
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    uint64_t toRelease = usage - m_lowWatermark;
+    uint64_t released = 0;
+    unsigned count = 0;
+
+    foreach2(it, candidates.begin(), candidates.end()) {
+        if (released >= toRelease) {
+            break;
+        }
+
+        uint64_t bytes = swapOut((*it).second);
+        if (bytes) {
+            released += bytes;
+            ++count;
+        }
+    }
+
+    m_usageAfterSwapOut = S2EStatsTracker::getProcessMemoryUsage();
+
+    g_s2e->getDebugStream() << "Swapped out " << count << " states ("
+            << released / 1024 << " KB), memory usage was "
+            << usage / (1024 * 1024) << " MB, now "
+            << m_usageAfterSwapOut / (1024 * 1024) << " MB\n";
+}
+
+uint64_t S2EStateSwapper::swapOut(S2EExecutionState *state)
+{
+    assert(!state->isActive() && !isSwappedOut(state));
+
+    //Processes created by load balancing share the directory
+    std::stringstream ss;
+    ss << m_directory << "/state-" << getpid() << "-" << state->getID();
+
+    SwappedState swapped;
+    swapped.path = ss.str();
+    swapped.bytes = 0;
+
+    FILE *fp = fopen(swapped.path.c_str(), "wb");
+    if (!fp) {
+        g_s2e->getWarningsStream(state) << "Could not create "
+                << swapped.path << ": " << strerror(errno) << '\n';
+        return 0;
+    }
+
+    bool ok = true;
+
+    const MemoryMap &objects = state->addressSpace.objects;
+    for (MemoryMap::iterator it = objects.begin(), ie = objects.end();
+         ok && it != ie; ++it) {
+        const MemoryObject *mo = (*it).first;
+        ObjectState *os = (*it).second;
+
+        //Only guest RAM is worth it
+        if (mo->size != S2E_RAM_OBJECT_SIZE || !mo->isSharedConcrete ||
+            mo->isValueIgnored) {
+            continue;
+        }
+
+        //Other states may refer to objects that are not ours
+        if (!state->addressSpace.isOwnedByUs(os) || !os->isAllConcrete()) {
+            continue;
+        }
+
+        ok = fwrite(os->getConcreteStore(), os->size, 1, fp) == 1;
+        swapped.objects.push_back(os);
+        swapped.bytes += os->size;
+    }
+
+    Assignment::bindings_ty &bindings = state->concolics.bindings;
+    foreach2(it, bindings.begin(), bindings.end()) {
+        uint32_t size = (*it).second.size();
+        if (!ok || !size) {
+            continue;
+        }
+
+        ok = fwrite(&size, sizeof(size), 1, fp) == 1 &&
+             fwrite(&(*it).second[0], size, 1, fp) == 1;
+        swapped.concolics.push_back((*it).first);
+        swapped.bytes += size;
+    }
+
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+
+    if (!ok || !swapped.bytes) {
+        if (!ok) {
+            g_s2e->getWarningsStream(state) << "Could not write "
+                    << swapped.path << ": " << strerror(errno) << '\n';
+        }
+        unlink(swapped.path.c_str());
+        return 0;
+    }
+
+    //Everything is on disk, release the memory
+    foreach2(it, swapped.objects.begin(), swapped.objects.end()) {
+        (*it)->releaseConcreteStore();
+        m_swappedObjects[*it] = state;
+    }
+
+    foreach2(it, swapped.concolics.begin(), swapped.concolics.end()) {
+        std::vector<unsigned char>().swap(bindings[*it]);
+    }
+
+    ++stats::stateSwapOuts;
+    stats::stateSwapOutBytes += swapped.bytes;
+    m_swappedBytes += swapped.bytes;
+
+    m_swapped[state] = swapped;
+    return swapped.bytes;
+}
+
+void S2EStateSwapper::swapIn(S2EExecutionState *state)
+{
+    SwappedStates::iterator it = m_swapped.find(state);
+    if (it == m_swapped.end()) {
+        return;
+    }
+
+    const SwappedState &swapped = (*it).second;
+
+    FILE *fp = fopen(swapped.path.c_str(), "rb");
+    bool ok = fp != NULL;
+
+    foreach2(oit, swapped.objects.begin(), swapped.objects.end()) {
+        ObjectState *os = *oit;
+        uint8_t *store = os->allocateConcreteStore();
+        ok = ok && fread(store, os->size, 1, fp) == 1;
+    }
+
+    foreach2(ait, swapped.concolics.begin(), swapped.concolics.end()) {
+        std::vector<unsigned char> &values = state->concolics.bindings[*ait];
+        uint32_t size = 0;
+        ok = ok && fread(&size, sizeof(size), 1, fp) == 1 && size;
+        if (ok) {
+            values.resize(size);
+            ok = fread(&values[0], size, 1, fp) == 1;
+        }
+    }
+
+    if (fp) {
+        fclose(fp);
+    }
+
+    if (!ok) {
+        //The state is unusable without its memory
+        g_s2e->getWarningsStream(state) << "Could not read "
+                << swapped.path << ", aborting\n";
+        exit(-1);
+    }
+
+    unlink(swapped.path.c_str());
+
+    ++stats::stateSwapIns;
+    stats::stateSwapInBytes += swapped.bytes;
+    m_swappedBytes -= swapped.bytes;
+
+    forgetObjects(swapped);
+    m_swapped.erase(it);
+}
+
+void S2EStateSwapper::forgetObjects(const SwappedState &swapped)
+{
+    foreach2(it, swapped.objects.begin(), swapped.objects.end()) {
+        m_swappedObjects.erase(*it);
+    }
+}
+
+//Called when anything accesses the memory of a swapped-out state
+//without swapping it in first
+void S2EStateSwapper::loadReleasedStore(const ObjectState *os)
+{
+    S2EStateSwapper *swapper = g_s2e->getExecutor()->getStateSwapper();
+    assert(swapper);
+
+    SwappedObjects::iterator it = swapper->m_swappedObjects.find(os);
+    assert(it != swapper->m_swappedObjects.end() && "object was not swapped out");
+    swapper->swapIn((*it).second);
+}
+
+void S2EStateSwapper::stateSelected(S2EExecutionState *state)
+{
+    assert(!isSwappedOut(state));
+    m_lastSelected[state] = ++m_selections;
+}
+
+void S2EStateSwapper::stateDiscarded(S2EExecutionState *state)
+{
+    SwappedStates::iterator it = m_swapped.find(state);
+    if (it != m_swapped.end()) {
+        m_swappedBytes -= (*it).second.bytes;
+        forgetObjects((*it).second);
+        m_swapped.erase(it);
+    }
+
+    m_lastSelected.erase(state);
+}
+
+}
@@ -0,0 +1,152 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2E_STATESWAPPER_H
+#define S2E_STATESWAPPER_H
+
+#include <inttypes.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace klee {
+    class Array;
+    class ExecutionState;
+    class ObjectState;
+}
+
+namespace s2e {
+
+class S2EExecutionState;
+
+/**
+ * Saves the memory of inactive states to disk when the process uses too
+ * much memory, and loads it back when the states are needed again.
+ *
+ * Only the parts of a state that are plain bytes and that no other state
+ * refers to are swapped out: the concrete RAM objects owned by the state
+ * (inactive states own all their RAM after a state switch) and the values
+ * of its concolic assignment. Constraints, symbolic objects and plugin
+ * states stay in memory. Swapped-out states remain in the searcher. They
+ * are swapped in when they are selected, merged or terminated, or when
+ * anything else (e.g., a plugin) accesses one of their released objects.
+ * The concolic values are only restored with the objects, they must not
+ * be read while the state is swapped out.
+ */
+class S2EStateSwapper
+{
+public:
+    S2EStateSwapper(const std::string &directory,
+                    uint64_t highWatermark, uint64_t lowWatermark);
+    ~S2EStateSwapper();
+
+    /** If the memory usage is above the high watermark, swaps out the
+        states that were selected least recently, until enough memory
+        was released to get back to the low watermark. */
+    void checkMemoryUsage(const std::set<klee::ExecutionState*> &states);
+
+    /** Loads the state back if it was swapped out */
+    void swapIn(S2EExecutionState *state);
+
+    /** Records that the state is about to run */
+    void stateSelected(S2EExecutionState *state);
+
+    /** Forgets about the state, which is going to be deleted or belongs
+        to another process after load balancing. Its swap file is left
+        to whoever swaps it in. */
+    void stateDiscarded(S2EExecutionState *state);
+
+    bool isSwappedOut(S2EExecutionState *state) const {
+        return m_swapped.find(state) != m_swapped.end();
+    }
+
+    /** Size of the swapped out data of the state, 0 if it is in memory */
+    uint64_t getSwappedOutBytes(S2EExecutionState *state) const {
+        SwappedStates::const_iterator it = m_swapped.find(state);
+        return it == m_swapped.end() ? 0 : it->second.bytes;
+    }
+
+    unsigned getSwappedOutCount() const { return m_swapped.size(); }
+    uint64_t getSwappedOutBytes() const { return m_swappedBytes; }
+
+private:
+    struct SwappedState {
+        std::string path;
+
+        /** Objects whose concrete store is in the file, in file order */
+        std::vector<klee::ObjectState*> objects;
+
+        /** Concolic values in the file, after the objects */
+        std::vector<const klee::Array*> concolics;
+
+        uint64_t bytes;
+    };
+
+    typedef std::map<S2EExecutionState*, SwappedState> SwappedStates;
+    typedef std::map<const klee::ObjectState*, S2EExecutionState*> SwappedObjects;
+
+    std::string m_directory;
+    uint64_t m_highWatermark;
+    uint64_t m_lowWatermark;
+
+    /** Memory usage measured after the last swap-out. The allocator may
+        keep the released memory, in which case the usage only grows
+        again once it is reused. */
+    uint64_t m_usageAfterSwapOut;
+
+    double m_lastCheck;
+
+    SwappedStates m_swapped;
+    uint64_t m_swappedBytes;
+
+    /** State of every released object */
+    SwappedObjects m_swappedObjects;
+
+    /** Selection time of every state, in number of selections */
+    std::map<S2EExecutionState*, uint64_t> m_lastSelected;
+    uint64_t m_selections;
+
+    uint64_t swapOut(S2EExecutionState *state);
+    void forgetObjects(const SwappedState &swapped);
+
+    /** ObjectState::releasedStoreLoader */
+    static void loadReleasedStore(const klee::ObjectState *os);
+};
+
+}
+
+#endif
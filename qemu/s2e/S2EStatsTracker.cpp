@@ -35,15 +35,21 @@
 
 #include "S2EStatsTracker.h"
 
+#include <s2e/S2E.h>
 #include <s2e/S2EExecutor.h>
 #include <s2e/S2EExecutionState.h>
+#include <s2e/Utils.h>
+#include <s2e/s2e_qemu.h>
 
 #include <klee/CoreStats.h>
 #include <klee/SolverStats.h>
+#include <klee/BitfieldSimplifier.h>
+#include <klee/MemoryUsage.h>
 #include <klee/Internal/System/Time.h>
 
 #include <llvm/Support/Process.h>
 
+#include <algorithm>
 #include <sstream>
 
 #include <unistd.h>
@@ -74,6 +80,14 @@ namespace stats {
 
     Statistic concreteModeTime("ConcreteModeTime", "ConcModeTime");
     Statistic symbolicModeTime("SymbolicModeTime", "SymbModeTime");
+
+    Statistic diskOverlayChunks("DiskOverlayChunks", "DiskChunks");
+    Statistic diskOverlayChunkCopies("DiskOverlayChunkCopies", "DiskChunkCopies");
+
+    Statistic stateSwapOuts("StateSwapOuts", "SwapOuts");
+    Statistic stateSwapOutBytes("StateSwapOutBytes", "SwapOutBytes");
+    Statistic stateSwapIns("StateSwapIns", "SwapIns");
+    Statistic stateSwapInBytes("StateSwapInBytes", "SwapInBytes");
 } // namespace stats
 } // namespace klee
 
@@ -165,7 +179,28 @@ void S2EStatsTracker::writeStatsHeader() {
              << "'ForkTime',"
              << "'ResolveTime',"
              << "'MemoryUsage',"
-             << ")\n";
+             << "'CopyOnWriteObjects',"
+             << "'CopyOnWriteBytes',"
+             << "'DiskOverlayChunks',"
+             << "'DiskOverlayChunkCopies',"
+             << "'StateSwapOuts',"
+             << "'StateSwapOutBytes',"
+             << "'StateSwapIns',"
+             << "'StateSwapInBytes',"
+             << "'SimplifierCacheHits',"
+             << "'SimplifierCacheMisses',"
+             << "'SimplifierCacheEvictions',"
+             << "'LiveExpressions',"
+             << "'StateOwnedBytes',"
+             << "'MaxStateOwnedBytes',";
+
+  const std::vector<MemoryCounter*> &counters = MemoryCounter::getCounters();
+  foreach2(it, counters.begin(), counters.end()) {
+    *statsFile << "'" << (*it)->getName() << "Count',"
+               << "'" << (*it)->getName() << "Bytes',";
+  }
+
+  *statsFile << ")\n";
   statsFile->flush();
 }
 
@@ -196,8 +231,84 @@ void S2EStatsTracker::writeStatsLine() {
              << "," << stats::forkTime / 1000000.
              << "," << stats::resolveTime / 1000000.
              << "," << getProcessMemoryUsage() //sys::Process::GetTotalMemoryUsage()
-             << ")\n";
+             << "," << stats::copyOnWriteObjects
+             << "," << stats::copyOnWriteBytes
+             << "," << stats::diskOverlayChunks
+             << "," << stats::diskOverlayChunkCopies
+             << "," << stats::stateSwapOuts
+             << "," << stats::stateSwapOutBytes
+             << "," << stats::stateSwapIns
+             << "," << stats::stateSwapInBytes
+             << "," << stats::simplifierCacheHits
+             << "," << stats::simplifierCacheMisses
+             << "," << stats::simplifierCacheEvictions;
+  writeMemoryStats();
+  *statsFile << ")\n";
   statsFile->flush();
+
+  writeSharedStats();
+}
+
+/**
+ *  Writes the memory accounting columns: the live expressions, the
+ *  memory owned by the states, and the live objects of each subsystem,
+ *  including the LLVM functions of translation blocks.
+ *  This walks all the states, but only does constant work for each.
+ *  Only the total and the largest owned sizes are written, use
+ *  S2EExecutionState::getMemoryUsage() for the breakdown of one state.
+ */
+void S2EStatsTracker::writeMemoryStats()
+{
+    uint64_t totalOwned = 0, maxOwned = 0;
+    const std::set<ExecutionState*> &states = executor.getStates();
+    foreach2(it, states.begin(), states.end()) {
+        uint64_t owned = (*it)->addressSpace.getOwnedBytes();
+        totalOwned += owned;
+        maxOwned = std::max(maxOwned, owned);
+    }
+
+    *statsFile << "," << Expr::count
+               << "," << totalOwned
+               << "," << maxOwned;
+
+    const std::vector<MemoryCounter*> &counters = MemoryCounter::getCounters();
+    foreach2(it, counters.begin(), counters.end()) {
+        *statsFile << "," << (*it)->getCount()
+                   << "," << (*it)->getBytes();
+    }
+}
+
+/**
+ *  Publishes the counters in the shared statistics segment.
+ *  This runs at the same (low) frequency as the run.stats updates.
+ */
+void S2EStatsTracker::writeSharedStats()
+{
+    S2ESharedStatsSlot *slot = g_s2e->getSharedStatsSlot();
+    if (!slot) {
+        return;
+    }
+
+    s2e_shared_stats_begin_update(slot);
+    slot->active = 1;
+    slot->pid = getpid();
+    slot->processIndex = g_s2e->getCurrentProcessIndex();
+    slot->updateTime = util::getWallTime() * 1000000.;
+    slot->wallTime = elapsed() * 1000000.;
+    slot->userTime = util::getUserTime() * 1000000.;
+    slot->statesCount = executor.getStatesCount();
+    slot->translationBlocks = stats::translationBlocks;
+    slot->translationBlocksConcrete = stats::translationBlocksConcrete;
+    slot->translationBlocksKlee = stats::translationBlocksKlee;
+    slot->cpuInstructions = stats::cpuInstructions;
+    slot->cpuInstructionsConcrete = stats::cpuInstructionsConcrete;
+    slot->cpuInstructionsKlee = stats::cpuInstructionsKlee;
+    slot->queries = stats::queries;
+    slot->queryTime = stats::queryTime;
+    slot->solverTime = stats::solverTime;
+    slot->forkTime = stats::forkTime;
+    slot->memoryUsage = getProcessMemoryUsage();
+    s2e_shared_stats_end_update(slot);
 }
 
 S2EStateStats::S2EStateStats():
@@ -51,6 +51,14 @@ namespace stats {
 
     extern klee::Statistic concreteModeTime;
     extern klee::Statistic symbolicModeTime;
+
+    extern klee::Statistic diskOverlayChunks;
+    extern klee::Statistic diskOverlayChunkCopies;
+
+    extern klee::Statistic stateSwapOuts;
+    extern klee::Statistic stateSwapOutBytes;
+    extern klee::Statistic stateSwapIns;
+    extern klee::Statistic stateSwapInBytes;
 } // namespace stats
 } // namespace klee
 
@@ -67,10 +75,28 @@ public:
 protected:
     void writeStatsHeader();
     void writeStatsLine();
+    void writeSharedStats();
+
+private:
+    void writeMemoryStats();
 };
 
 class S2EExecutionState;
 
+/** Memory used by one state, see S2EExecutionState::getMemoryUsage() */
+struct S2EStateMemoryUsage {
+    /** Size of the memory objects that the state does not share with
+        any other state, i.e., that it wrote since it was forked */
+    uint64_t ownedBytes;
+
+    /** Part of ownedBytes that is swapped out to disk */
+    uint64_t swappedOutBytes;
+
+    unsigned constraints;
+    unsigned symbolics;
+    unsigned pluginStates;
+};
+
 class S2EStateStats {
 public:
 
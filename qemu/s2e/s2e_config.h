@@ -46,10 +46,32 @@
 
 /** This defines the size of each MemoryObject that represents physical RAM.
     Larger values save some memory, smaller (exponentially) decrease solving
-    time for constraints with symbolic addresses */
+    time for constraints with symbolic addresses.
+
+    The granularity is chosen at startup with the --ram-object-bits option
+    (kleeArgs of the configuration file), between S2E_RAM_OBJECT_MIN_BITS
+    and TARGET_PAGE_BITS. S2E_RAM_OBJECT_MIN_BITS sets the size of the S2E
+    TLB that every CPU state holds; it can be lowered with the
+    --s2e-ram-object-min-bits=N option of configure (EXTRA_QEMU_FLAGS of
+    the top-level Makefile). The CopyOnWriteObjects and CopyOnWriteBytes
+    columns of run.stats show the effect of a given setting on the cost of
+    forking. */
 
 #ifdef S2E_ENABLE_S2E_TLB
-#define S2E_RAM_OBJECT_BITS 7
+#ifndef S2E_RAM_OBJECT_MIN_BITS
+#define S2E_RAM_OBJECT_MIN_BITS 7
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/** Set by S2EExecutor before any memory is registered */
+extern unsigned g_s2e_ram_object_bits;
+#ifdef __cplusplus
+}
+#endif
+
+#define S2E_RAM_OBJECT_BITS g_s2e_ram_object_bits
 #else
 /* Do not touch this */
 #define S2E_RAM_OBJECT_BITS TARGET_PAGE_BITS
@@ -256,6 +256,10 @@ void s2e_tb_free(struct S2E* s2e, struct TranslationBlock *tb);
     in order to update tb->s2e_tb->llvm_function */
 void s2e_set_tb_function(struct S2E* s2e, struct TranslationBlock *tb);
 
+/** Called by tb_gen_code() once the block is translated and linked */
+void s2e_on_translation_complete(struct S2E* s2e, CPUArchState *env,
+                                 struct TranslationBlock *tb);
+
 void s2e_flush_tb_cache(void);
 void s2e_flush_tlb_cache(void);
 void s2e_flush_tlb_cache_page(void *objectState, int mmu_idx, int index);
@@ -40,14 +40,22 @@
 #include "Macho.h"
 
 #include "llvm/Support/system_error.h"
+#include "llvm/Support/CommandLine.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <cassert>
 
 #include <algorithm>
 #include <iostream>
 #include <vector>
 
+namespace {
+    llvm::cl::opt<bool>
+            SymbolCache("symbol-cache",
+                        llvm::cl::desc("Save the symbol tables of the modules next to them for reuse"),
+                        llvm::cl::init(true));
+}
 
 namespace s2etools
 {
@@ -64,6 +72,8 @@ BFDInterface::BFDInterface(const std::string &fileName):ExecutableFile(fileName)
     llvm::MemoryBuffer::getFile(fileName.c_str(), m_file);
 
     m_binary = NULL;
+    m_lineTableInited = false;
+    m_lineTableMissingBlocks = 0;
 }
 
 BFDInterface::BFDInterface(const std::string &fileName, bool requireSymbols):ExecutableFile(fileName)
@@ -73,6 +83,8 @@ BFDInterface::BFDInterface(const std::string &fileName, bool requireSymbols):Exe
     m_requireSymbols = requireSymbols;
     llvm::MemoryBuffer::getFile(fileName.c_str(), m_file);
     m_binary = NULL;
+    m_lineTableInited = false;
+    m_lineTableMissingBlocks = 0;
 }
 
 BFDInterface::~BFDInterface()
@@ -229,6 +241,61 @@ bool BFDInterface::getInfo(uint64_t addr, std::string &source, uint64_t &line, s
     //std::cout << "Section " << section->name << " " << std::hex << section->vma << " - size=0x"  << section->size <<
     //        " for address " << addr << std::endl;
 
+    if (section->flags & SEC_CODE) {
+        initLineTable();
+        symbolizeBlock(section, addr);
+        finalizeLineTable();
+        return m_lineTable.lookup(addr, source, line, function);
+    }
+
+    return findNearestLine(section, addr, source, line, function);
+}
+
+unsigned BFDInterface::getInfo(AddressInfoList &infos)
+{
+    if (!initialize()) {
+        return 0;
+    }
+
+    initLineTable();
+
+    //Symbolize the blocks of all the requested addresses,
+    //then merge them into the table at once
+    AddressInfoList::iterator it;
+    for (it = infos.begin(); it != infos.end(); ++it) {
+        asection *section = getSection((*it).address, 1);
+        if (section && (section->flags & SEC_CODE)) {
+            symbolizeBlock(section, (*it).address);
+        }
+    }
+    finalizeLineTable();
+
+    unsigned found = m_lineTable.lookup(infos);
+
+    //Only code sections are in the table, query the rest directly
+    for (it = infos.begin(); it != infos.end(); ++it) {
+        AddressInfo &info = *it;
+        if (info.found) {
+            continue;
+        }
+
+        asection *section = getSection(info.address, 1);
+        if (section && (section->flags & SEC_CODE)) {
+            continue;
+        }
+
+        info.found = getInfo(info.address, info.source, info.line, info.function);
+        if (info.found) {
+            ++found;
+        }
+    }
+
+    return found;
+}
+
+bool BFDInterface::findNearestLine(asection *section, uint64_t addr,
+                                   std::string &source, uint64_t &line, std::string &function)
+{
     const char *filename;
     const char *funcname;
     unsigned int sourceline;
@@ -248,7 +315,114 @@ bool BFDInterface::getInfo(uint64_t addr, std::string &source, uint64_t &line, s
     }
 
     return false;
+}
+
+//Loads the table of the whole module saved by a previous run,
+//as long as the module file did not change. Otherwise, the table
+//is built block by block as addresses are looked up.
+void BFDInterface::initLineTable()
+{
+    if (m_lineTableInited) {
+        return;
+    }
+    m_lineTableInited = true;
+
+    m_lineTable.clear();
+    m_lineTableBlocks.clear();
+    m_lineTableMissingBlocks = 0;
+
+    std::string cacheFile = m_fileName + ".symtab";
+    if (SymbolCache && m_lineTable.load(cacheFile, m_fileName)) {
+        return;
+    }
+
+    Sections::const_iterator it;
+    for (it = m_sections.begin(); it != m_sections.end(); ++it) {
+        asection *section = (*it).second;
+        if (!(section->flags & SEC_CODE) || !section->size) {
+            continue;
+        }
 
+        uint64_t first = section->vma & ~(LineTableBlockSize - 1);
+        uint64_t last = (section->vma + section->size - 1) & ~(LineTableBlockSize - 1);
+        m_lineTableMissingBlocks += (last - first) / LineTableBlockSize + 1;
+    }
+}
+
+//Symbolizes every byte of the part of the section that lies in the
+//block of addr, merging the results into ranges.
+//finalizeLineTable() must be called before the next lookup.
+void BFDInterface::symbolizeBlock(asection *section, uint64_t addr)
+{
+    if (!m_lineTableMissingBlocks) {
+        return;
+    }
+
+    uint64_t blockStart = addr & ~(LineTableBlockSize - 1);
+    uint64_t start = std::max<uint64_t>(blockStart, section->vma);
+    uint64_t end = std::min<uint64_t>(blockStart + LineTableBlockSize,
+                                      section->vma + section->size);
+
+    //Sections may share a block, each of them has its own start
+    if (!m_lineTableBlocks.insert(start).second) {
+        return;
+    }
+    --m_lineTableMissingBlocks;
+
+    const char *prevFile = NULL, *prevFunc = NULL;
+    unsigned prevLine = 0;
+    bool prevValid = false;
+
+    for (uint64_t offset = start - section->vma; offset < end - section->vma; ++offset) {
+        const char *filename = NULL;
+        const char *funcname = NULL;
+        unsigned int sourceline = 0;
+
+        if (!bfd_find_nearest_line(m_bfd, section, m_symbolTable, offset,
+                                   &filename, &funcname, &sourceline) ||
+            (!filename && !sourceline && !funcname)) {
+            prevValid = false;
+            continue;
+        }
+
+        uint64_t va = section->vma + offset;
+
+        //BFD returns pointers into its own string tables,
+        //identical pointers mean identical strings.
+        if (prevValid && filename == prevFile && funcname == prevFunc &&
+            sourceline == prevLine && m_lineTable.extend(va)) {
+            continue;
+        }
+
+        m_lineTable.add(va,
+                        filename ? filename : "<unknown source>",
+                        sourceline,
+                        funcname ? funcname : "<unknown function>");
+
+        prevFile = filename;
+        prevFunc = funcname;
+        prevLine = sourceline;
+        prevValid = true;
+    }
+}
+
+//Makes the blocks symbolized so far visible to lookups.
+//The table is saved once it covers all the code of the module.
+void BFDInterface::finalizeLineTable()
+{
+    m_lineTable.finalize();
+
+    if (m_lineTableMissingBlocks || m_lineTableBlocks.empty()) {
+        return;
+    }
+
+    //Save only once
+    m_lineTableBlocks.clear();
+
+    std::string cacheFile = m_fileName + ".symtab";
+    if (SymbolCache && !m_lineTable.save(cacheFile, m_fileName)) {
+        std::cerr << "Could not save symbol table to " << cacheFile << std::endl;
+    }
 }
 
 bool BFDInterface::getModuleName(std::string &name ) const
@@ -316,11 +490,19 @@ bool BFDInterface::read(uint64_t va, void *dest, unsigned size) const
     }
 
     bool b = bfd_get_section_contents(m_bfd, section, dest, va - section->vma, size);
+
     //Check for written changes
-    for (unsigned i=0; i<size; ++i) {
-        std::map<uint64_t, uint8_t>::const_iterator it = m_cowBuffer.find(va+i);
-        if (it != m_cowBuffer.end()) {
-            *(((uint8_t*)dest) + i) = (*it).second;
+    uint64_t end = va + size;
+    CowPages::const_iterator it = m_cowPages.lower_bound(va & ~(uint64_t)(CowPageSize - 1));
+    for (; it != m_cowPages.end() && (*it).first < end; ++it) {
+        const CowPage &page = (*it).second;
+        uint64_t start = std::max(va, (*it).first);
+        uint64_t pageEnd = std::min(end, (*it).first + CowPageSize);
+        for (uint64_t a = start; a < pageEnd; ++a) {
+            unsigned offset = a - (*it).first;
+            if (page.valid[offset / 64] & (1ULL << (offset % 64))) {
+                *(((uint8_t*)dest) + (a - va)) = page.data[offset];
+            }
         }
     }
     return b;
@@ -334,8 +516,19 @@ bool BFDInterface::write(uint64_t va, void *source, unsigned size)
     }
 
     //Write data to a local buffer instead of the bfd
-    for (unsigned i=0; i<size; ++i) {
-        m_cowBuffer[va+i] = *(((uint8_t*)source) + i);
+    unsigned i = 0;
+    while (i < size) {
+        uint64_t a = va + i;
+        uint64_t base = a & ~(uint64_t)(CowPageSize - 1);
+        unsigned offset = a - base;
+        unsigned count = std::min(size - i, CowPageSize - offset);
+
+        CowPage &page = m_cowPages[base];
+        memcpy(page.data + offset, ((uint8_t*)source) + i, count);
+        for (unsigned j = offset; j < offset + count; ++j) {
+            page.valid[j / 64] |= 1ULL << (j % 64);
+        }
+        i += count;
     }
     return true;
     //XXX: This always seems to fail, because bfd_direction is not properly set for
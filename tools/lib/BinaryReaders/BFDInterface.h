@@ -47,6 +47,7 @@ extern "C" {
 #include <inttypes.h>
 
 #include "ExecutableFile.h"
+#include "SymbolTable.h"
 #include <llvm/Support/MemoryBuffer.h>
 #include <llvm/ADT/OwningPtr.h>
 
@@ -126,8 +127,24 @@ private:
     llvm::OwningPtr<llvm::MemoryBuffer> m_file;
     Binary *m_binary;
 
-    //This for copy-on-write, when we need to write stuff to the BFD
-    std::map<uint64_t, uint8_t> m_cowBuffer;
+    //This for copy-on-write, when we need to write stuff to the BFD.
+    //Written bytes are kept in page-sized overlays with a per-byte valid mask.
+    static const unsigned CowPageSize = 0x1000;
+    struct CowPage {
+        uint8_t data[CowPageSize];
+        uint64_t valid[CowPageSize / 64];
+    };
+    typedef std::map<uint64_t, CowPage> CowPages;
+    CowPages m_cowPages;
+
+    //Debug info of the code sections. Each block of LineTableBlockSize
+    //bytes is symbolized on the first lookup of one of its addresses,
+    //unless the table of the whole module was loaded from the cache.
+    static const uint64_t LineTableBlockSize = 0x1000;
+    SymbolTable m_lineTable;
+    bool m_lineTableInited;
+    AddressSet m_lineTableBlocks;
+    unsigned m_lineTableMissingBlocks;
 
     RelocationEntries m_relocations;
     Imports m_imports;
@@ -137,6 +154,12 @@ private:
     bool initPeImports();
     asection *getSection(uint64_t va, unsigned size) const;
 
+    bool findNearestLine(asection *section, uint64_t addr,
+                         std::string &source, uint64_t &line, std::string &function);
+    void initLineTable();
+    void symbolizeBlock(asection *section, uint64_t addr);
+    void finalizeLineTable();
+
 public:
     BFDInterface(const std::string &fileName);
     BFDInterface(const std::string &fileName, bool requireSymbols);
@@ -149,6 +172,8 @@ public:
     bool initialize(const std::string &format);
 
     bool getInfo(uint64_t addr, std::string &source, uint64_t &line, std::string &function);
+    unsigned getInfo(AddressInfoList &infos);
+
     bool inited() const {
         return m_bfd != NULL;
     }
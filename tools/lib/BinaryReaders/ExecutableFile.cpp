@@ -50,6 +50,20 @@ ExecutableFile::~ExecutableFile()
 
 }
 
+unsigned ExecutableFile::getInfo(AddressInfoList &infos)
+{
+    unsigned found = 0;
+    AddressInfoList::iterator it;
+    for (it = infos.begin(); it != infos.end(); ++it) {
+        AddressInfo &info = *it;
+        info.found = getInfo(info.address, info.source, info.line, info.function);
+        if (info.found) {
+            ++found;
+        }
+    }
+    return found;
+}
+
 ExecutableFile *ExecutableFile::create(const std::string &fileName)
 {
     //Try to see if we can open the binary using BFD
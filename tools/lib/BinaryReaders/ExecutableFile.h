@@ -40,6 +40,8 @@
 #include <string>
 #include <inttypes.h>
 
+#include "SymbolTable.h"
+
 namespace s2etools
 {
 
@@ -58,6 +60,9 @@ public:
 
     virtual bool initialize() = 0;
     virtual bool getInfo(uint64_t addr, std::string &source, uint64_t &line, std::string &function) = 0;
+
+    //Resolves a batch of addresses, returns how many were found
+    virtual unsigned getInfo(AddressInfoList &infos);
     virtual bool inited() const = 0;
 
     static ExecutableFile *create(const std::string &fileName);
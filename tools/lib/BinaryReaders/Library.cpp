@@ -208,6 +208,38 @@ bool Library::getInfo(const ModuleInstance *mi, uint64_t pc, std::string &file,
     return true;
 }
 
+unsigned Library::getInfo(
+        const std::string &modName, uint64_t loadBase, uint64_t imageBase,
+        AddressInfoList &infos)
+{
+    ExecutableFile *exec = get(modName);
+    if (!exec) {
+        return 0;
+    }
+
+    AddressInfoList::iterator it;
+    for (it = infos.begin(); it != infos.end(); ++it) {
+        (*it).address = (*it).address - loadBase + imageBase;
+    }
+
+    unsigned found = exec->getInfo(infos);
+
+    for (it = infos.begin(); it != infos.end(); ++it) {
+        (*it).address = (*it).address - imageBase + loadBase;
+    }
+
+    return found;
+}
+
+unsigned Library::getInfo(const ModuleInstance *mi, AddressInfoList &infos)
+{
+    if (!mi) {
+        return 0;
+    }
+
+    return getInfo(mi->Name, mi->LoadBase, mi->ImageBase, infos);
+}
+
 //Helper function to quickly print debug info
 bool Library::print(
         const std::string &modName, uint64_t loadBase, uint64_t imageBase,
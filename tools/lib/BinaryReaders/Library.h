@@ -74,6 +74,13 @@ public:
     bool print(const ModuleInstance *ni, uint64_t pc, std::string &out, bool file, bool line, bool func);
     bool getInfo(const ModuleInstance *ni, uint64_t pc, std::string &file, uint64_t &line, std::string &func);
 
+    //Batched version, the addresses of the list are run-time pcs in the given module
+    unsigned getInfo(
+            const std::string &modName, uint64_t loadBase, uint64_t imageBase,
+            AddressInfoList &infos);
+
+    unsigned getInfo(const ModuleInstance *ni, AddressInfoList &infos);
+
     bool findLibrary(const std::string &libName, std::string &abspath);
     bool findSuffixedModule(const std::string &moduleName, const std::string &suffix, llvm::sys::Path &path);
     bool findBasicBlockList(const std::string &moduleName, llvm::sys::Path &path);
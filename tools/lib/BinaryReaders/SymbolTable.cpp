@@ -0,0 +1,336 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include "SymbolTable.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+
+namespace s2etools
+{
+
+namespace {
+static const char SymbolTableMagic[8] = {'S', '2', 'E', 'S', 'Y', 'M', 'T', 'B'};
+static const uint32_t SymbolTableVersion = 1;
+
+struct SymbolTableHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t stringCount;
+    uint64_t moduleSize;
+    uint64_t moduleTime;
+    uint64_t entryCount;
+};
+
+struct AddressInfoCmp {
+    const AddressInfoList &infos;
+    AddressInfoCmp(const AddressInfoList &i):infos(i) {}
+    bool operator()(unsigned a, unsigned b) const {
+        return infos[a].address < infos[b].address;
+    }
+};
+}
+
+SymbolTable::SymbolTable()
+{
+    m_pending = false;
+    m_sorted = 0;
+}
+
+void SymbolTable::clear()
+{
+    m_entries.clear();
+    m_strings.clear();
+    m_stringIndex.clear();
+    m_pending = false;
+    m_sorted = 0;
+}
+
+void SymbolTable::add(uint64_t address, const std::string &source, uint64_t line, const std::string &function)
+{
+    uint32_t src, fcn;
+
+    //Most of the time the address belongs to the same function/file
+    //as the previous one, avoid the string lookup in this case.
+    if (m_pending && m_strings[m_current.source] == source) {
+        src = m_current.source;
+    } else {
+        std::pair<StringIndex::iterator, bool> res =
+                m_stringIndex.insert(std::make_pair(source, (uint32_t)m_strings.size()));
+        if (res.second) {
+            m_strings.push_back(source);
+        }
+        src = (*res.first).second;
+    }
+
+    if (m_pending && m_strings[m_current.function] == function) {
+        fcn = m_current.function;
+    } else {
+        std::pair<StringIndex::iterator, bool> res =
+                m_stringIndex.insert(std::make_pair(function, (uint32_t)m_strings.size()));
+        if (res.second) {
+            m_strings.push_back(function);
+        }
+        fcn = (*res.first).second;
+    }
+
+    if (m_pending && m_current.start + m_current.size == address &&
+        m_current.line == line && m_current.source == src &&
+        m_current.function == fcn && m_current.size < (uint32_t)-1) {
+        ++m_current.size;
+        return;
+    }
+
+    if (m_pending) {
+        m_entries.push_back(m_current);
+    }
+
+    m_current.start = address;
+    m_current.size = 1;
+    m_current.line = line;
+    m_current.source = src;
+    m_current.function = fcn;
+    m_pending = true;
+}
+
+void SymbolTable::finalize()
+{
+    if (m_pending) {
+        m_entries.push_back(m_current);
+        m_pending = false;
+    }
+
+    if (m_sorted == m_entries.size()) {
+        return;
+    }
+
+    //Blocks are not necessarily symbolized in address order
+    Entries::iterator sorted = m_entries.begin() + m_sorted;
+    std::sort(sorted, m_entries.end());
+    std::inplace_merge(m_entries.begin(), sorted, m_entries.end());
+    m_sorted = m_entries.size();
+}
+
+const SymbolTable::Entry *SymbolTable::lookup(uint64_t address) const
+{
+    Entry e;
+    e.start = address;
+    Entries::const_iterator it = std::upper_bound(m_entries.begin(), m_entries.end(), e);
+    if (it == m_entries.begin()) {
+        return NULL;
+    }
+    --it;
+
+    if (address - (*it).start >= (*it).size) {
+        return NULL;
+    }
+    return &*it;
+}
+
+bool SymbolTable::lookup(uint64_t address, std::string &source, uint64_t &line, std::string &function) const
+{
+    const Entry *e = lookup(address);
+    if (!e) {
+        return false;
+    }
+
+    source = m_strings[e->source];
+    line = e->line;
+    function = m_strings[e->function];
+    return true;
+}
+
+unsigned SymbolTable::lookup(AddressInfoList &infos) const
+{
+    //Visit the addresses in increasing order so that the table
+    //is walked only once, whatever the size of the batch.
+    std::vector<unsigned> order(infos.size());
+    for (unsigned i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), AddressInfoCmp(infos));
+
+    unsigned found = 0;
+    Entries::const_iterator it = m_entries.begin();
+    for (unsigned i = 0; i < order.size(); ++i) {
+        AddressInfo &info = infos[order[i]];
+
+        Entry e;
+        e.start = info.address;
+        it = std::upper_bound(it, m_entries.end(), e);
+
+        info.found = false;
+        if (it == m_entries.begin()) {
+            continue;
+        }
+
+        const Entry &r = *(it - 1);
+        if (info.address - r.start >= r.size) {
+            continue;
+        }
+
+        info.source = m_strings[r.source];
+        info.line = r.line;
+        info.function = m_strings[r.function];
+        info.found = true;
+        ++found;
+    }
+
+    return found;
+}
+
+bool SymbolTable::getFileStamp(const std::string &path, uint64_t &size, uint64_t &mtime)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) < 0) {
+        return false;
+    }
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+bool SymbolTable::load(const std::string &cacheFile, const std::string &moduleFile)
+{
+    uint64_t size, mtime;
+    if (!getFileStamp(moduleFile, size, mtime)) {
+        return false;
+    }
+
+    std::ifstream is(cacheFile.c_str(), std::ios::binary);
+    if (!is.good()) {
+        return false;
+    }
+
+    SymbolTableHeader hdr;
+    if (!is.read((char*)&hdr, sizeof(hdr))) {
+        return false;
+    }
+
+    if (memcmp(hdr.magic, SymbolTableMagic, sizeof(hdr.magic)) ||
+        hdr.version != SymbolTableVersion ||
+        hdr.moduleSize != size || hdr.moduleTime != mtime) {
+        return false;
+    }
+
+    clear();
+
+    m_strings.resize(hdr.stringCount);
+    for (uint32_t i = 0; i < hdr.stringCount; ++i) {
+        uint32_t length;
+        if (!is.read((char*)&length, sizeof(length))) {
+            clear();
+            return false;
+        }
+        m_strings[i].resize(length);
+        if (length && !is.read(&m_strings[i][0], length)) {
+            clear();
+            return false;
+        }
+        m_stringIndex[m_strings[i]] = i;
+    }
+
+    m_entries.resize(hdr.entryCount);
+    if (hdr.entryCount &&
+        !is.read((char*)&m_entries[0], hdr.entryCount * sizeof(Entry))) {
+        clear();
+        return false;
+    }
+
+    for (Entries::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if ((*it).source >= m_strings.size() || (*it).function >= m_strings.size()) {
+            clear();
+            return false;
+        }
+    }
+
+    m_sorted = m_entries.size();
+    return true;
+}
+
+bool SymbolTable::save(const std::string &cacheFile, const std::string &moduleFile) const
+{
+    SymbolTableHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+
+    if (!getFileStamp(moduleFile, hdr.moduleSize, hdr.moduleTime)) {
+        return false;
+    }
+
+    memcpy(hdr.magic, SymbolTableMagic, sizeof(hdr.magic));
+    hdr.version = SymbolTableVersion;
+    hdr.stringCount = m_strings.size();
+    hdr.entryCount = m_entries.size();
+
+    //Write to a temporary file first, concurrent tools
+    //must never see a partially written table.
+    std::string tmpFile = cacheFile + ".tmp";
+    std::ofstream os(tmpFile.c_str(), std::ios::binary | std::ios::trunc);
+    if (!os.good()) {
+        return false;
+    }
+
+    os.write((const char*)&hdr, sizeof(hdr));
+    for (Strings::const_iterator it = m_strings.begin(); it != m_strings.end(); ++it) {
+        uint32_t length = (*it).size();
+        os.write((const char*)&length, sizeof(length));
+        os.write((*it).data(), length);
+    }
+
+    if (!m_entries.empty()) {
+        os.write((const char*)&m_entries[0], m_entries.size() * sizeof(Entry));
+    }
+
+    os.close();
+    if (!os.good()) {
+        unlink(tmpFile.c_str());
+        return false;
+    }
+
+    if (rename(tmpFile.c_str(), cacheFile.c_str()) < 0) {
+        unlink(tmpFile.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,164 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_SYMBOLTABLE_H
+#define S2ETOOLS_SYMBOLTABLE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <inttypes.h>
+
+namespace s2etools
+{
+
+//Result of a symbolization request, used for batched lookups
+struct AddressInfo
+{
+    uint64_t address;
+    std::string source;
+    uint64_t line;
+    std::string function;
+    bool found;
+
+    AddressInfo() {
+        address = 0;
+        line = 0;
+        found = false;
+    }
+
+    AddressInfo(uint64_t a) {
+        address = a;
+        line = 0;
+        found = false;
+    }
+};
+
+typedef std::vector<AddressInfo> AddressInfoList;
+
+/**
+ *  Sorted address -> (function, file, line) table of a module image.
+ *  Consecutive addresses that resolve to the same triple are merged
+ *  into one range, file and function names are interned.
+ *  The table can be saved next to the module and reloaded as long as
+ *  the module did not change (same size and modification time).
+ */
+class SymbolTable
+{
+public:
+    struct Entry {
+        uint64_t start;
+        uint32_t size;
+        uint32_t line;
+        uint32_t source;
+        uint32_t function;
+
+        bool operator < (const Entry &e) const {
+            return start < e.start;
+        }
+    };
+
+    typedef std::vector<Entry> Entries;
+    typedef std::vector<std::string> Strings;
+
+private:
+    typedef std::map<std::string, uint32_t> StringIndex;
+
+    Entries m_entries;
+    Strings m_strings;
+    StringIndex m_stringIndex;
+
+    //Range being built by add()
+    bool m_pending;
+    Entry m_current;
+
+    //Number of entries already sorted by finalize()
+    size_t m_sorted;
+
+    static bool getFileStamp(const std::string &path, uint64_t &size, uint64_t &mtime);
+
+public:
+    SymbolTable();
+
+    void clear();
+
+    //Extends the table with the debug info of one address. Consecutive
+    //addresses are merged into ranges. The ranges added between two calls
+    //to finalize() may come in any order, but must not overlap.
+    void add(uint64_t address, const std::string &source, uint64_t line, const std::string &function);
+
+    //Extends the last range by one byte if address immediately follows it.
+    //Lets callers skip add() when they know the debug info did not change.
+    bool extend(uint64_t address) {
+        if (!m_pending || m_current.start + m_current.size != address ||
+            m_current.size == (uint32_t)-1) {
+            return false;
+        }
+        ++m_current.size;
+        return true;
+    }
+
+    //Must be called after the last add() and before lookups.
+    //Merges the ranges added since the previous call into the table.
+    void finalize();
+
+    const Entry *lookup(uint64_t address) const;
+    bool lookup(uint64_t address, std::string &source, uint64_t &line, std::string &function) const;
+
+    //Resolves all the addresses of the list at once.
+    //Returns the number of resolved addresses.
+    unsigned lookup(AddressInfoList &infos) const;
+
+    //Loads a table previously stored for the given module.
+    //Fails if the module changed since the table was saved.
+    bool load(const std::string &cacheFile, const std::string &moduleFile);
+    bool save(const std::string &cacheFile, const std::string &moduleFile) const;
+
+    const Entries &getEntries() const {
+        return m_entries;
+    }
+
+    const std::string &getString(uint32_t index) const {
+        return m_strings[index];
+    }
+
+    bool empty() const {
+        return m_entries.empty();
+    }
+};
+
+}
+
+#endif
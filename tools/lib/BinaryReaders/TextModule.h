@@ -99,6 +99,7 @@ public:
     virtual ~TextModule();
 
     virtual bool initialize();
+    using ExecutableFile::getInfo;
     virtual bool getInfo(uint64_t addr, std::string &source, uint64_t &line, std::string &function);
     virtual bool inited() const;
 
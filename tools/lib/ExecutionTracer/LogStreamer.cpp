@@ -0,0 +1,189 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include <iostream>
+#include <cassert>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "LogStreamer.h"
+
+namespace s2etools
+{
+
+LogStreamer::LogStreamer(unsigned bufferSize):LogEvents()
+{
+    m_cachedProcessor = NULL;
+    m_cachedState = NULL;
+    m_buffer.resize(bufferSize);
+    m_currentItem = 0;
+    m_follow = false;
+    m_pollInterval = 500;
+    m_idleTimeout = 10;
+}
+
+LogStreamer::~LogStreamer()
+{
+    ItemProcessors::iterator it;
+    for (it = m_ItemProcessors.begin(); it != m_ItemProcessors.end(); ++it) {
+        delete (*it).second;
+    }
+}
+
+bool LogStreamer::parse(const std::vector<std::string> &fileNames)
+{
+    std::vector<std::string>::const_iterator it;
+    for (it = fileNames.begin(); it != fileNames.end(); ++it) {
+        if (!parse(*it)) {
+            std::cerr << *it << " is incomplete" << std::endl;
+        }
+    }
+    return true;
+}
+
+bool LogStreamer::parse(const std::string &fileName)
+{
+    int file = open(fileName.c_str(), O_RDONLY);
+    if (file < 0) {
+        std::cerr << "LogStreamer: Could not open " << fileName << std::endl;
+        return false;
+    }
+
+    const unsigned hdrSize = sizeof(s2e::plugins::ExecutionTraceItemHeader);
+    size_t filled = 0, pos = 0;
+    unsigned idleTime = 0;
+    bool error = false;
+
+    while (true) {
+        //Move the incomplete item to the start of the buffer
+        if (pos > 0) {
+            memmove(&m_buffer[0], &m_buffer[pos], filled - pos);
+            filled -= pos;
+            pos = 0;
+        }
+
+        ssize_t count = read(file, &m_buffer[filled], m_buffer.size() - filled);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "LogStreamer: Could not read " << fileName << std::endl;
+            error = true;
+            break;
+        }
+
+        if (count == 0) {
+            if (!m_follow || idleTime >= m_idleTimeout * 1000) {
+                break;
+            }
+            usleep(m_pollInterval * 1000);
+            idleTime += m_pollInterval;
+            continue;
+        }
+
+        idleTime = 0;
+        filled += count;
+
+        while (filled - pos >= hdrSize) {
+            const s2e::plugins::ExecutionTraceItemHeader *hdr =
+                    (const s2e::plugins::ExecutionTraceItemHeader *)&m_buffer[pos];
+
+            size_t itemSize = hdrSize + hdr->size;
+            if (itemSize > m_buffer.size()) {
+                //The buffer will be compacted before the next read
+                m_buffer.resize(itemSize);
+                break;
+            }
+
+            if (filled - pos < itemSize) {
+                break;
+            }
+
+            processItem(m_currentItem, *hdr, &m_buffer[pos + hdrSize]);
+            ++m_currentItem;
+            pos += itemSize;
+        }
+    }
+
+    close(file);
+
+    if (!error && filled != pos) {
+        std::cerr << "LogStreamer: " << fileName << " ends with a truncated item" << std::endl;
+    }
+
+    return !error && filled == pos;
+}
+
+ItemProcessorState* LogStreamer::getState(void *processor, ItemProcessorStateFactory f)
+{
+    if (processor == m_cachedProcessor) {
+        return m_cachedState;
+    }
+
+    ItemProcessorState *ret;
+    ItemProcessors::const_iterator it = m_ItemProcessors.find(processor);
+    if (it == m_ItemProcessors.end()) {
+        ret = f();
+        m_ItemProcessors[processor] = ret;
+    } else {
+        ret = (*it).second;
+    }
+
+    m_cachedProcessor = processor;
+    m_cachedState = ret;
+    return ret;
+}
+
+ItemProcessorState* LogStreamer::getState(void *processor, uint32_t pathId)
+{
+    assert(pathId == 0);
+    ItemProcessors::const_iterator it = m_ItemProcessors.find(processor);
+    if (it == m_ItemProcessors.end()) {
+        return NULL;
+    } else {
+        return (*it).second;
+    }
+}
+
+//A streamed trace is flat and has only one path
+void LogStreamer::getPaths(PathSet &s)
+{
+    s.clear();
+    s.insert(0);
+}
+
+}
@@ -0,0 +1,96 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_EXECTRACER_LOGSTREAMER_H
+#define S2ETOOLS_EXECTRACER_LOGSTREAMER_H
+
+#include <string>
+#include <vector>
+#include <inttypes.h>
+
+#include "LogParser.h"
+
+namespace s2etools
+{
+
+/**
+ *  Flat trace reader with bounded memory.
+ *  Unlike LogParser, the trace is read sequentially through a fixed-size
+ *  buffer and items are not indexed, so getItem() is not available and
+ *  the data passed to onEachItem is only valid during the callback.
+ *  In follow mode, the streamer waits for the file to grow when it
+ *  reaches the end, which allows processing traces of a running S2E.
+ */
+class LogStreamer: public LogEvents
+{
+private:
+    ItemProcessors m_ItemProcessors;
+    void *m_cachedProcessor;
+    ItemProcessorState* m_cachedState;
+
+    std::vector<uint8_t> m_buffer;
+    unsigned m_currentItem;
+
+    bool m_follow;
+    unsigned m_pollInterval;
+    unsigned m_idleTimeout;
+
+public:
+    LogStreamer(unsigned bufferSize = 1 << 20);
+    virtual ~LogStreamer();
+
+    //pollInterval is in milliseconds, idleTimeout in seconds.
+    //Streaming stops when the file did not grow for idleTimeout seconds.
+    void setFollow(bool follow, unsigned pollInterval, unsigned idleTimeout) {
+        m_follow = follow;
+        m_pollInterval = pollInterval;
+        m_idleTimeout = idleTimeout;
+    }
+
+    bool parse(const std::vector<std::string> &fileNames);
+    bool parse(const std::string &fileName);
+
+    unsigned getItemCount() const {
+        return m_currentItem;
+    }
+
+    virtual ItemProcessorState* getState(void *processor, ItemProcessorStateFactory f);
+    virtual ItemProcessorState* getState(void *processor, uint32_t pathId);
+    virtual void getPaths(PathSet &s);
+};
+
+}
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+/**
+ *  Replays the memory accesses recorded in execution traces on the cache
+ *  model of the CacheSim plugin and reports its throughput and miss rates.
+ *  The traces must be generated with the MemoryTracer and/or
+ *  TranslationBlockTracer plugins. Without traces, a synthetic stream
+ *  is used.
+ */
+
+#define __STDC_FORMAT_MACROS 1
+
+#include "llvm/Support/CommandLine.h"
+
+#include <lib/ExecutionTracer/LogParser.h>
+
+#include <s2e/Plugins/ExecutionTracers/TraceEntries.h>
+#include <s2e/Plugins/CacheModel.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+#include <inttypes.h>
+#include <sys/time.h>
+
+using namespace llvm;
+using namespace s2etools;
+using namespace s2e::plugins;
+
+namespace {
+
+cl::list<std::string>
+    TraceFiles("trace", llvm::cl::value_desc("Input trace"), llvm::cl::Prefix,
+               llvm::cl::desc("Specify an execution trace file"));
+
+cl::opt<unsigned>
+    L1Size("l1size", cl::desc("Size of the first level cache"), cl::init(32768));
+
+cl::opt<unsigned>
+    L1Associativity("l1assoc", cl::desc("Associativity of the first level cache"), cl::init(8));
+
+cl::opt<unsigned>
+    L2Size("l2size", cl::desc("Size of the second level cache (0 to disable)"), cl::init(262144));
+
+cl::opt<unsigned>
+    L2Associativity("l2assoc", cl::desc("Associativity of the second level cache"), cl::init(8));
+
+cl::opt<unsigned>
+    LineSize("linesize", cl::desc("Line size of all caches"), cl::init(64));
+
+cl::opt<unsigned>
+    Repeat("repeat", cl::desc("Number of times to replay the accesses"), cl::init(10));
+
+cl::opt<unsigned>
+    SyntheticCount("synthetic", cl::desc("Number of synthetic accesses if no trace is given"),
+                   cl::init(10000000));
+
+}
+
+namespace s2etools
+{
+
+struct RecordedAccess {
+    uint64_t address;
+    uint32_t size;
+    bool isCode;
+};
+
+class AccessCollector {
+private:
+    std::vector<RecordedAccess> &m_accesses;
+
+public:
+    AccessCollector(std::vector<RecordedAccess> &accesses): m_accesses(accesses) {}
+
+    void onItem(unsigned traceIndex,
+                const s2e::plugins::ExecutionTraceItemHeader &hdr,
+                void *item)
+    {
+        RecordedAccess a;
+
+        if (hdr.type == s2e::plugins::TRACE_MEMORY) {
+            const s2e::plugins::ExecutionTraceMemory *te =
+                    (const s2e::plugins::ExecutionTraceMemory*) item;
+            if (te->flags & (EXECTRACE_MEM_IO | EXECTRACE_MEM_SYMBADDR)) {
+                return;
+            }
+            a.address = te->address;
+            a.size = te->size;
+            a.isCode = false;
+        } else if (hdr.type == s2e::plugins::TRACE_TB_START) {
+            const s2e::plugins::ExecutionTraceTb *te =
+                    (const s2e::plugins::ExecutionTraceTb*) item;
+            a.address = te->pc;
+            a.size = te->size ? te->size : 1;
+            a.isCode = true;
+        } else {
+            return;
+        }
+
+        m_accesses.push_back(a);
+    }
+};
+
+static void generateSyntheticAccesses(std::vector<RecordedAccess> &accesses, unsigned count)
+{
+    //Mostly sequential accesses with some locality, similar to
+    //what a guest typically does
+    uint64_t pc = 0x400000, sp = 0x7ff000, heap = 0x10000000;
+    srand(0);
+
+    for (unsigned i = 0; i < count; ++i) {
+        RecordedAccess a;
+        a.isCode = false;
+        a.size = 4;
+
+        switch (rand() % 8) {
+            case 0: pc += 16 + (rand() % 64); if (rand() % 16 == 0) pc = 0x400000 + (rand() % 0x40000);
+                    a.address = pc; a.size = 16; a.isCode = true; break;
+            case 1: case 2: case 3: a.address = sp - (rand() % 256); break;
+            case 4: case 5: heap += 8; a.address = heap; break;
+            default: a.address = 0x10000000 + (rand() % (16 << 20)); break;
+        }
+
+        accesses.push_back(a);
+    }
+}
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    cl::ParseCommandLineOptions(argc, (char**) argv, " cachebench");
+
+    std::vector<RecordedAccess> accesses;
+
+    if (TraceFiles.size() > 0) {
+        LogParser parser;
+        AccessCollector collector(accesses);
+        parser.onEachItem.connect(sigc::mem_fun(collector, &AccessCollector::onItem));
+        if (!parser.parse(TraceFiles)) {
+            std::cerr << "Could not parse the traces\n";
+            return -1;
+        }
+    } else {
+        generateSyntheticAccesses(accesses, SyntheticCount);
+    }
+
+    if (accesses.empty()) {
+        std::cerr << "No memory accesses to replay\n";
+        return -1;
+    }
+
+    Cache *l2 = NULL;
+    if (L2Size) {
+        l2 = new Cache("l2", L2Size, L2Associativity, LineSize);
+    }
+
+    Cache i1("i1", L1Size, L1Associativity, LineSize, 1, l2);
+    Cache d1("d1", L1Size, L1Associativity, LineSize, 1, l2);
+    unsigned levels = l2 ? 2 : 1;
+
+    uint64_t i1Misses = 0, d1Misses = 0, l2Misses = 0;
+    double start = now();
+
+    for (unsigned r = 0; r < Repeat; ++r) {
+        for (std::vector<RecordedAccess>::const_iterator it = accesses.begin();
+             it != accesses.end(); ++it) {
+            unsigned missCount[2] = {0, 0};
+            Cache &c = (*it).isCode ? i1 : d1;
+            c.access((*it).address, (*it).size, false, missCount, levels);
+            ((*it).isCode ? i1Misses : d1Misses) += missCount[0];
+            l2Misses += missCount[1];
+        }
+    }
+
+    double elapsed = now() - start;
+    uint64_t total = (uint64_t) accesses.size() * Repeat;
+
+    printf("Replayed %" PRIu64 " accesses (%u recorded) in %.3f s: %.1f M accesses/s\n",
+           total, (unsigned) accesses.size(), elapsed, total / elapsed / 1000000.);
+    printf("i1 misses: %" PRIu64 " d1 misses: %" PRIu64 " l2 misses: %" PRIu64 "\n",
+           i1Misses, d1Misses, l2Misses);
+
+    delete l2;
+    return 0;
+}
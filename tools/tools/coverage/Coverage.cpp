@@ -41,6 +41,7 @@
 #include <llvm/Support/Path.h>
 
 #include <lib/ExecutionTracer/ModuleParser.h>
+#include <lib/ExecutionTracer/LogStreamer.h>
 #include <lib/ExecutionTracer/Path.h>
 #include <lib/ExecutionTracer/TestCase.h>
 #include <lib/BinaryReaders/BFDInterface.h>
@@ -55,7 +56,10 @@
 #include <sstream>
 #include <inttypes.h>
 #include <iomanip>
+#include <algorithm>
+#include <pthread.h>
 #include "Coverage.h"
+#include "CoverageBitmap.h"
 
 using namespace llvm;
 using namespace s2etools;
@@ -77,6 +81,21 @@ ModDir("moddir", cl::desc("Directory containing binary modules, the basic block
 cl::opt<bool>
     Compact("compact", cl::desc("Do not display non-covered blocks"), cl::init(false));
 
+cl::opt<bool>
+    Streaming("stream", cl::desc("Read the traces sequentially with bounded memory and compute coverage bitmaps"), cl::init(false));
+
+cl::opt<bool>
+    Follow("follow", cl::desc("In streaming mode, wait for the traces to grow until they are idle"), cl::init(false));
+
+cl::opt<unsigned>
+    IdleTimeout("idle-timeout", cl::desc("Seconds without trace growth after which -follow stops"), cl::init(10));
+
+cl::opt<unsigned>
+    Jobs("jobs", cl::desc("Number of traces processed in parallel in streaming mode"), cl::init(1));
+
+cl::list<std::string>
+    BitmapFiles("bitmap", cl::desc("Merge a coverage bitmap (*.covmap) produced by a previous streaming run"));
+
 
 //cl::opt<std::string>
 //    CovType("covtype", cl::desc("Coverage type"), cl::init("basicblock"));
@@ -394,6 +413,15 @@ Coverage::Coverage(Library *lib, ModuleCache *cache, LogEvents *events)
     m_unknownModuleCount = 0;
 }
 
+Coverage::Coverage(Library *lib)
+{
+    m_events = NULL;
+    m_cache = NULL;
+    m_library = lib;
+    m_pathCount = 1;
+    m_unknownModuleCount = 0;
+}
+
 Coverage::~Coverage()
 {
     m_connection.disconnect();
@@ -406,21 +434,26 @@ Coverage::~Coverage()
 
 BasicBlockCoverage *Coverage::loadCoverage(const ModuleInstance *mi)
 {
-    BasicBlockCoverage *bbcov = NULL;
     assert(mi);
+    return loadCoverage(mi->Name);
+}
+
+BasicBlockCoverage *Coverage::loadCoverage(const std::string &moduleName)
+{
+    BasicBlockCoverage *bbcov = NULL;
 
-    BbCoverageMap::iterator it = m_bbCov.find(mi->Name);
+    BbCoverageMap::iterator it = m_bbCov.find(moduleName);
     if (it == m_bbCov.end()) {
         //Look for the file containing the bbs.
         std::string path;
-        if (m_library->findLibrary(mi->Name, path)) {
+        if (m_library->findLibrary(moduleName, path)) {
             llvm::sys::Path modPath(path);
             modPath.eraseComponent();
-            BasicBlockCoverage *bb = new BasicBlockCoverage(modPath.str(), mi->Name);
-            m_bbCov[mi->Name] = bb;
+            BasicBlockCoverage *bb = new BasicBlockCoverage(modPath.str(), moduleName);
+            m_bbCov[moduleName] = bb;
             bbcov = bb;
         } else {
-            m_notFoundModuleImages.insert(mi->Name);
+            m_notFoundModuleImages.insert(moduleName);
         }
     }else {
         bbcov = (*it).second;
@@ -429,6 +462,22 @@ BasicBlockCoverage *Coverage::loadCoverage(const ModuleInstance *mi)
     return bbcov;
 }
 
+void Coverage::addBlock(const std::string &moduleName, uint64_t ts, uint64_t start, uint64_t end)
+{
+    BasicBlockCoverage *bbcov = loadCoverage(moduleName);
+    if (!bbcov) {
+        return;
+    }
+
+    bbcov->addTranslationBlock(ts, start, end);
+}
+
+void Coverage::addErrors(uint64_t unknownModuleCount, const std::set<std::string> &notFoundModules)
+{
+    m_unknownModuleCount += unknownModuleCount;
+    m_notFoundModuleImages.insert(notFoundModules.begin(), notFoundModules.end());
+}
+
 void Coverage::onItem(unsigned traceIndex,
             const s2e::plugins::ExecutionTraceItemHeader &hdr,
             void *item)
@@ -545,6 +594,132 @@ void CoverageTool::flatTrace()
     cov.outputCoverage(LogDir);
 }
 
+namespace {
+struct StreamQueue {
+    pthread_mutex_t mutex;
+    unsigned nextTrace;
+    BasicBlockListCache *lists;
+    StreamingCoverage *result;
+};
+
+//Each worker streams whole trace files, i.e., the traces of whole
+//S2E processes, and merges its bitmaps into the result when done.
+void *streamWorker(void *opaque)
+{
+    StreamQueue *queue = static_cast<StreamQueue*>(opaque);
+
+    while (true) {
+        pthread_mutex_lock(&queue->mutex);
+        unsigned index = queue->nextTrace++;
+        pthread_mutex_unlock(&queue->mutex);
+
+        if (index >= TraceFiles.size()) {
+            break;
+        }
+
+        LogStreamer streamer;
+        streamer.setFollow(Follow, 500, IdleTimeout);
+
+        ModuleCache mc(&streamer);
+        StreamingCoverage cov(queue->lists, &mc, &streamer);
+
+        if (!streamer.parse(TraceFiles[index])) {
+            std::cerr << TraceFiles[index] << " is incomplete" << std::endl;
+        }
+
+        pthread_mutex_lock(&queue->mutex);
+        queue->result->merge(cov);
+        pthread_mutex_unlock(&queue->mutex);
+    }
+
+    return NULL;
+}
+}
+
+void CoverageTool::streamTraces()
+{
+    BasicBlockListCache lists(&m_binaries);
+    StreamingCoverage result(&lists);
+
+    StreamQueue queue;
+    pthread_mutex_init(&queue.mutex, NULL);
+    queue.nextTrace = 0;
+    queue.lists = &lists;
+    queue.result = &result;
+
+    //Growing traces must all be followed at the same time
+    unsigned jobs = Follow ? TraceFiles.size() : std::min<unsigned>(Jobs, TraceFiles.size());
+
+    std::vector<pthread_t> threads;
+    for (unsigned i = 0; i < jobs; ++i) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, streamWorker, &queue)) {
+            std::cerr << "Could not create worker thread " << i << std::endl;
+            break;
+        }
+        threads.push_back(thread);
+    }
+
+    //Process the traces in this thread if no worker could be started
+    if (threads.empty()) {
+        streamWorker(&queue);
+    }
+
+    for (unsigned i = 0; i < threads.size(); ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&queue.mutex);
+
+    //Merge the partial results of other runs or processes
+    for (unsigned i = 0; i < BitmapFiles.size(); ++i) {
+        std::string module;
+        if (!CoverageBitmap::getModuleName(BitmapFiles[i], module)) {
+            std::cerr << BitmapFiles[i] << " is not a coverage bitmap" << std::endl;
+            continue;
+        }
+
+        CoverageBitmap *bitmap = result.getBitmap(module);
+        if (!bitmap) {
+            continue;
+        }
+
+        CoverageBitmap partial(module, bitmap->getBlocks());
+        if (partial.load(BitmapFiles[i])) {
+            bitmap->merge(partial);
+        }
+    }
+
+    Coverage cov(&m_binaries);
+    cov.setPathCount(1 + result.getForkedPaths());
+    cov.addErrors(result.getUnknownModuleCount(), result.getNotFoundModules());
+
+    const StreamingCoverage::Bitmaps &bitmaps = result.getBitmaps();
+    StreamingCoverage::Bitmaps::const_iterator it;
+    for (it = bitmaps.begin(); it != bitmaps.end(); ++it) {
+        const CoverageBitmap *bitmap = (*it).second;
+        if (!bitmap || !bitmap->getCoveredCount()) {
+            continue;
+        }
+
+        std::stringstream ss;
+        ss << LogDir << "/" << (*it).first << ".covmap";
+        if (!bitmap->save(ss.str())) {
+            std::cerr << "Could not save " << ss.str() << std::endl;
+        }
+
+        const BasicBlockList *blocks = bitmap->getBlocks();
+        for (unsigned ordinal = 0; ordinal < blocks->size(); ++ordinal) {
+            if (bitmap->isCovered(ordinal)) {
+                const BasicBlockList::Entry &e = blocks->get(ordinal);
+                cov.addBlock((*it).first, bitmap->getFirstHit(ordinal), e.start, e.end);
+            }
+        }
+    }
+
+    cov.printErrors();
+    cov.outputCoverage(LogDir);
+}
+
 
 }
 
@@ -555,7 +730,11 @@ int main(int argc, char **argv)
 
     s2etools::CoverageTool cov;
 
-    cov.flatTrace();
+    if (Streaming) {
+        cov.streamTraces();
+    } else {
+        cov.flatTrace();
+    }
 
     return 0;
 }
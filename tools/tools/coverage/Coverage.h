@@ -173,6 +173,7 @@ private:
     std::set<std::string> m_notFoundBbList;
 
     BasicBlockCoverage *loadCoverage(const ModuleInstance *mi);
+    BasicBlockCoverage *loadCoverage(const std::string &moduleName);
 
     void onItem(unsigned traceIndex,
                 const s2e::plugins::ExecutionTraceItemHeader &hdr,
@@ -180,14 +181,25 @@ private:
 
 public:
     Coverage(Library *lib, ModuleCache *cache, LogEvents *events);
+
+    //For reports of coverage computed elsewhere, see addBlock
+    Coverage(Library *lib);
     virtual ~Coverage();
 
+    //Start and end must be local to the module
+    void addBlock(const std::string &moduleName, uint64_t ts, uint64_t start, uint64_t end);
+    void addErrors(uint64_t unknownModuleCount, const std::set<std::string> &notFoundModules);
+
     void outputCoverage(const std::string &Path) const;
 
     uint64_t getPathCount() const {
         return m_pathCount;
     }
 
+    void setPathCount(uint64_t count) {
+        m_pathCount = count;
+    }
+
     void printErrors() const;
 
 };
@@ -205,6 +217,9 @@ public:
 
     void process();
     void flatTrace();
+
+    //Bounded-memory alternative to flatTrace, see StreamingCoverage
+    void streamTraces();
 };
 
 
@@ -0,0 +1,451 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#define __STDC_FORMAT_MACROS 1
+
+#include <llvm/Support/Path.h>
+
+#include <s2e/Plugins/ExecutionTracers/TraceEntries.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include "CoverageBitmap.h"
+
+namespace s2etools
+{
+
+namespace {
+static const char CoverageBitmapMagic[8] = {'S', '2', 'E', 'C', 'O', 'V', 'B', 'M'};
+
+struct CoverageBitmapHeader {
+    char magic[8];
+    char module[64];
+    uint64_t checksum;
+    uint32_t blockCount;
+    uint32_t coveredCount;
+};
+
+//Orders overlapping blocks as equal, to detect duplicates in the list
+struct OverlapCmp {
+    bool operator()(const BasicBlockList::Entry &b1, const BasicBlockList::Entry &b2) const {
+        return b1.end < b2.start;
+    }
+};
+
+struct StartCmp {
+    const std::vector<BasicBlockList::Entry> &blocks;
+    StartCmp(const std::vector<BasicBlockList::Entry> &b):blocks(b) {}
+    bool operator()(unsigned o1, unsigned o2) const {
+        return blocks[o1].start < blocks[o2].start;
+    }
+};
+
+struct EndCmp {
+    const std::vector<BasicBlockList::Entry> &blocks;
+    EndCmp(const std::vector<BasicBlockList::Entry> &b):blocks(b) {}
+    bool operator()(unsigned o, uint64_t address) const {
+        return blocks[o].end < address;
+    }
+};
+}
+
+///////////////////////////////////////////////////////////////////////////////
+BasicBlockList::BasicBlockList()
+{
+    m_checksum = 0;
+}
+
+bool BasicBlockList::load(const std::string &moduleDir, const std::string &moduleName)
+{
+    llvm::sys::Path basicBlockListFile(moduleDir);
+    basicBlockListFile.appendComponent(moduleName + ".bblist");
+
+    FILE *fp = fopen(basicBlockListFile.str().c_str(), "r");
+    if (!fp) {
+        std::cerr << "Could not open file " << basicBlockListFile.str() << std::endl;
+        return false;
+    }
+
+    std::set<Entry, OverlapCmp> unique;
+
+    //FNV-1a over the block boundaries
+    m_checksum = 0xcbf29ce484222325ULL;
+
+    char buffer[512];
+    while (fgets(buffer, sizeof(buffer), fp)) {
+        Entry e;
+        if (sscanf(buffer, "0x%"PRIx64" 0x%"PRIx64, &e.start, &e.end) != 2) {
+            continue;
+        }
+
+        if (!unique.insert(e).second) {
+            std::cout << "Won't insert this block : existing block: " << e.start << std::endl;
+            continue;
+        }
+
+        m_blocks.push_back(e);
+        for (unsigned i = 0; i < sizeof(e.start); ++i) {
+            m_checksum = (m_checksum ^ ((e.start >> (i * 8)) & 0xff)) * 0x100000001b3ULL;
+            m_checksum = (m_checksum ^ ((e.end >> (i * 8)) & 0xff)) * 0x100000001b3ULL;
+        }
+    }
+
+    fclose(fp);
+
+    if (m_blocks.size() == 0) {
+        std::cerr << "No basic blocks found in the list for " << moduleName << ". Check the format of the file." << std::endl;
+        return false;
+    }
+
+    m_byAddress.resize(m_blocks.size());
+    for (unsigned i = 0; i < m_blocks.size(); ++i) {
+        m_byAddress[i] = i;
+    }
+    std::sort(m_byAddress.begin(), m_byAddress.end(), StartCmp(m_blocks));
+
+    return true;
+}
+
+void BasicBlockList::getBlocks(uint64_t start, uint64_t end, std::vector<unsigned> &ordinals) const
+{
+    //Blocks do not overlap, so they are sorted by end address too
+    std::vector<unsigned>::const_iterator it =
+            std::lower_bound(m_byAddress.begin(), m_byAddress.end(), start, EndCmp(m_blocks));
+
+    for (; it != m_byAddress.end() && m_blocks[*it].start <= end; ++it) {
+        ordinals.push_back(*it);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+BasicBlockListCache::BasicBlockListCache(Library *lib)
+{
+    m_library = lib;
+    pthread_mutex_init(&m_mutex, NULL);
+}
+
+BasicBlockListCache::~BasicBlockListCache()
+{
+    Lists::iterator it;
+    for (it = m_lists.begin(); it != m_lists.end(); ++it) {
+        delete (*it).second;
+    }
+    pthread_mutex_destroy(&m_mutex);
+}
+
+const BasicBlockList *BasicBlockListCache::get(const std::string &moduleName)
+{
+    pthread_mutex_lock(&m_mutex);
+
+    Lists::iterator it = m_lists.find(moduleName);
+    if (it != m_lists.end()) {
+        pthread_mutex_unlock(&m_mutex);
+        return (*it).second;
+    }
+
+    BasicBlockList *list = NULL;
+    std::string path;
+    if (m_library->findLibrary(moduleName, path)) {
+        llvm::sys::Path modPath(path);
+        modPath.eraseComponent();
+
+        list = new BasicBlockList();
+        if (!list->load(modPath.str(), moduleName)) {
+            delete list;
+            list = NULL;
+        }
+    }
+
+    //Failures are cached too, to avoid looking for the files again
+    m_lists[moduleName] = list;
+
+    pthread_mutex_unlock(&m_mutex);
+    return list;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+CoverageBitmap::CoverageBitmap(const std::string &module, const BasicBlockList *blocks)
+{
+    m_module = module;
+    m_blocks = blocks;
+    m_bits.resize((blocks->size() + 63) / 64, 0);
+    m_firstHit.resize(blocks->size(), 0);
+    m_coveredCount = 0;
+}
+
+void CoverageBitmap::cover(unsigned ordinal, uint64_t timeStamp)
+{
+    uint64_t &word = m_bits[ordinal / 64];
+    uint64_t mask = 1ULL << (ordinal % 64);
+    if (!(word & mask)) {
+        word |= mask;
+        m_firstHit[ordinal] = timeStamp;
+        ++m_coveredCount;
+    } else if (timeStamp < m_firstHit[ordinal]) {
+        m_firstHit[ordinal] = timeStamp;
+    }
+}
+
+bool CoverageBitmap::addTranslationBlock(uint64_t timeStamp, uint64_t start, uint64_t end)
+{
+    unsigned prevCount = m_coveredCount;
+
+    m_ordinals.clear();
+    m_blocks->getBlocks(start, end, m_ordinals);
+    if (m_ordinals.empty()) {
+        std::cerr << "Missing TB: " << std::hex << "0x"
+                  << start << ":0x" << end << std::dec << std::endl;
+        return false;
+    }
+
+    for (unsigned i = 0; i < m_ordinals.size(); ++i) {
+        cover(m_ordinals[i], timeStamp);
+    }
+
+    return m_coveredCount != prevCount;
+}
+
+void CoverageBitmap::merge(const CoverageBitmap &other)
+{
+    assert(m_blocks->getChecksum() == other.m_blocks->getChecksum());
+
+    for (unsigned w = 0; w < m_bits.size(); ++w) {
+        uint64_t bits = other.m_bits[w];
+        while (bits) {
+            unsigned bit = __builtin_ctzll(bits);
+            bits &= bits - 1;
+
+            unsigned ordinal = w * 64 + bit;
+            cover(ordinal, other.m_firstHit[ordinal]);
+        }
+    }
+}
+
+bool CoverageBitmap::save(const std::string &fileName) const
+{
+    CoverageBitmapHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CoverageBitmapMagic, sizeof(hdr.magic));
+    strncpy(hdr.module, m_module.c_str(), sizeof(hdr.module) - 1);
+    hdr.checksum = m_blocks->getChecksum();
+    hdr.blockCount = m_blocks->size();
+    hdr.coveredCount = m_coveredCount;
+
+    std::ofstream os(fileName.c_str(), std::ios::binary | std::ios::trunc);
+    if (!os.good()) {
+        return false;
+    }
+
+    os.write((const char*)&hdr, sizeof(hdr));
+    os.write((const char*)&m_bits[0], m_bits.size() * sizeof(m_bits[0]));
+    os.write((const char*)&m_firstHit[0], m_firstHit.size() * sizeof(m_firstHit[0]));
+    os.close();
+
+    return os.good();
+}
+
+bool CoverageBitmap::getModuleName(const std::string &fileName, std::string &module)
+{
+    CoverageBitmapHeader hdr;
+    std::ifstream is(fileName.c_str(), std::ios::binary);
+    if (!is.read((char*)&hdr, sizeof(hdr))) {
+        return false;
+    }
+
+    if (memcmp(hdr.magic, CoverageBitmapMagic, sizeof(hdr.magic))) {
+        return false;
+    }
+
+    hdr.module[sizeof(hdr.module) - 1] = 0;
+    module = hdr.module;
+    return true;
+}
+
+bool CoverageBitmap::load(const std::string &fileName)
+{
+    CoverageBitmapHeader hdr;
+    std::ifstream is(fileName.c_str(), std::ios::binary);
+    if (!is.read((char*)&hdr, sizeof(hdr))) {
+        return false;
+    }
+
+    hdr.module[sizeof(hdr.module) - 1] = 0;
+    if (memcmp(hdr.magic, CoverageBitmapMagic, sizeof(hdr.magic)) ||
+        m_module != hdr.module ||
+        hdr.checksum != m_blocks->getChecksum() ||
+        hdr.blockCount != m_blocks->size()) {
+        std::cerr << fileName << " does not match the block list of " << m_module << std::endl;
+        return false;
+    }
+
+    if (!is.read((char*)&m_bits[0], m_bits.size() * sizeof(m_bits[0])) ||
+        !is.read((char*)&m_firstHit[0], m_firstHit.size() * sizeof(m_firstHit[0]))) {
+        std::cerr << fileName << " is truncated" << std::endl;
+        std::fill(m_bits.begin(), m_bits.end(), 0);
+        std::fill(m_firstHit.begin(), m_firstHit.end(), 0);
+        m_coveredCount = 0;
+        return false;
+    }
+
+    m_coveredCount = 0;
+    for (unsigned w = 0; w < m_bits.size(); ++w) {
+        m_coveredCount += __builtin_popcountll(m_bits[w]);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+StreamingCoverage::StreamingCoverage(BasicBlockListCache *lists, ModuleCache *cache, LogEvents *events)
+{
+    m_events = events;
+    m_connection = events->onEachItem.connect(
+            sigc::mem_fun(*this, &StreamingCoverage::onItem)
+            );
+    m_cache = cache;
+    m_lists = lists;
+    m_forkedPaths = 0;
+    m_unknownModuleCount = 0;
+    m_lastInstance = NULL;
+    m_lastBitmap = NULL;
+}
+
+StreamingCoverage::StreamingCoverage(BasicBlockListCache *lists)
+{
+    m_events = NULL;
+    m_cache = NULL;
+    m_lists = lists;
+    m_forkedPaths = 0;
+    m_unknownModuleCount = 0;
+    m_lastInstance = NULL;
+    m_lastBitmap = NULL;
+}
+
+StreamingCoverage::~StreamingCoverage()
+{
+    m_connection.disconnect();
+
+    Bitmaps::iterator it;
+    for (it = m_bitmaps.begin(); it != m_bitmaps.end(); ++it) {
+        delete (*it).second;
+    }
+}
+
+CoverageBitmap *StreamingCoverage::getBitmap(const std::string &moduleName)
+{
+    Bitmaps::iterator it = m_bitmaps.find(moduleName);
+    if (it != m_bitmaps.end()) {
+        return (*it).second;
+    }
+
+    CoverageBitmap *bitmap = NULL;
+    const BasicBlockList *list = m_lists->get(moduleName);
+    if (list) {
+        bitmap = new CoverageBitmap(moduleName, list);
+    } else {
+        m_notFoundModules.insert(moduleName);
+    }
+
+    m_bitmaps[moduleName] = bitmap;
+    return bitmap;
+}
+
+void StreamingCoverage::merge(const StreamingCoverage &other)
+{
+    Bitmaps::const_iterator it;
+    for (it = other.m_bitmaps.begin(); it != other.m_bitmaps.end(); ++it) {
+        if (!(*it).second) {
+            continue;
+        }
+
+        CoverageBitmap *bitmap = getBitmap((*it).first);
+        if (bitmap) {
+            bitmap->merge(*(*it).second);
+        }
+    }
+
+    m_forkedPaths += other.m_forkedPaths;
+    m_unknownModuleCount += other.m_unknownModuleCount;
+    m_notFoundModules.insert(other.m_notFoundModules.begin(), other.m_notFoundModules.end());
+}
+
+void StreamingCoverage::onItem(unsigned traceIndex,
+            const s2e::plugins::ExecutionTraceItemHeader &hdr,
+            void *item)
+{
+    if (hdr.type == s2e::plugins::TRACE_FORK) {
+        s2e::plugins::ExecutionTraceFork *f = (s2e::plugins::ExecutionTraceFork*)item;
+        m_forkedPaths += f->stateCount - 1;
+        return;
+    }
+
+    if (hdr.type == s2e::plugins::TRACE_MOD_LOAD || hdr.type == s2e::plugins::TRACE_MOD_UNLOAD) {
+        //The cached instance may have been freed
+        m_lastInstance = NULL;
+        return;
+    }
+
+    if (hdr.type != s2e::plugins::TRACE_TB_START) {
+        return;
+    }
+
+    const s2e::plugins::ExecutionTraceTb *te =
+            (const s2e::plugins::ExecutionTraceTb*) item;
+
+    const ModuleInstance *mi = m_lastInstance;
+    if (!mi || Library::translatePid(hdr.pid, te->pc) != mi->Pid ||
+        te->pc < mi->LoadBase || te->pc >= mi->LoadBase + mi->Size) {
+        ModuleCacheState *mcs = static_cast<ModuleCacheState*>(m_events->getState(m_cache, &ModuleCacheState::factory));
+        mi = mcs->getInstance(hdr.pid, te->pc);
+        if (!mi) {
+            ++m_unknownModuleCount;
+            return;
+        }
+        m_lastInstance = mi;
+        m_lastBitmap = getBitmap(mi->Name);
+    }
+
+    if (!m_lastBitmap) {
+        return;
+    }
+
+    uint64_t relPc = te->pc - mi->LoadBase + mi->ImageBase;
+    m_lastBitmap->addTranslationBlock(hdr.timeStamp, relPc, relPc + te->size - 1);
+}
+
+}
@@ -0,0 +1,231 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_COVERAGE_BITMAP_H
+#define S2ETOOLS_COVERAGE_BITMAP_H
+
+#include <lib/ExecutionTracer/LogParser.h>
+#include <lib/ExecutionTracer/ModuleParser.h>
+
+#include <lib/BinaryReaders/Library.h>
+
+#include <pthread.h>
+#include <inttypes.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace s2etools
+{
+
+/**
+ *  Basic blocks of a module, as listed in its .bblist file.
+ *  The position of a block in the list is its ordinal,
+ *  which indexes the coverage bitmaps.
+ */
+class BasicBlockList
+{
+public:
+    struct Entry {
+        uint64_t start;
+        uint64_t end;
+    };
+
+private:
+    std::vector<Entry> m_blocks;
+
+    //Ordinals sorted by start address, blocks do not overlap
+    std::vector<unsigned> m_byAddress;
+    uint64_t m_checksum;
+
+public:
+    BasicBlockList();
+
+    bool load(const std::string &moduleDir, const std::string &moduleName);
+
+    unsigned size() const {
+        return m_blocks.size();
+    }
+
+    const Entry &get(unsigned ordinal) const {
+        return m_blocks[ordinal];
+    }
+
+    //Identifies the list, bitmaps can only be merged if their checksums match
+    uint64_t getChecksum() const {
+        return m_checksum;
+    }
+
+    //Appends the ordinals of the blocks that intersect [start, end]
+    void getBlocks(uint64_t start, uint64_t end, std::vector<unsigned> &ordinals) const;
+};
+
+/**
+ *  Loads block lists on demand, can be shared by several threads.
+ */
+class BasicBlockListCache
+{
+private:
+    typedef std::map<std::string, BasicBlockList*> Lists;
+
+    Library *m_library;
+    Lists m_lists;
+    pthread_mutex_t m_mutex;
+
+public:
+    BasicBlockListCache(Library *lib);
+    ~BasicBlockListCache();
+
+    //Returns NULL if the module image or its block list could not be found
+    const BasicBlockList *get(const std::string &moduleName);
+};
+
+/**
+ *  Covered blocks of one module. Memory usage only depends
+ *  on the number of blocks of the module, not on the trace size.
+ */
+class CoverageBitmap
+{
+private:
+    std::string m_module;
+    const BasicBlockList *m_blocks;
+    std::vector<uint64_t> m_bits;
+
+    //Timestamp of the first execution of each block
+    std::vector<uint64_t> m_firstHit;
+    unsigned m_coveredCount;
+
+    //Scratch buffer for addTranslationBlock
+    std::vector<unsigned> m_ordinals;
+
+    void cover(unsigned ordinal, uint64_t timeStamp);
+
+public:
+    CoverageBitmap(const std::string &module, const BasicBlockList *blocks);
+
+    //Start and end must be local to the module
+    //Returns true if the block resulted in covering new basic blocks
+    bool addTranslationBlock(uint64_t timeStamp, uint64_t start, uint64_t end);
+
+    void merge(const CoverageBitmap &other);
+
+    bool isCovered(unsigned ordinal) const {
+        return m_bits[ordinal / 64] & (1ULL << (ordinal % 64));
+    }
+
+    uint64_t getFirstHit(unsigned ordinal) const {
+        return m_firstHit[ordinal];
+    }
+
+    unsigned getCoveredCount() const {
+        return m_coveredCount;
+    }
+
+    const std::string &getModule() const {
+        return m_module;
+    }
+
+    const BasicBlockList *getBlocks() const {
+        return m_blocks;
+    }
+
+    bool save(const std::string &fileName) const;
+
+    //Reads the module name stored in a bitmap file
+    static bool getModuleName(const std::string &fileName, std::string &module);
+    bool load(const std::string &fileName);
+};
+
+/**
+ *  Computes coverage bitmaps while a trace is being read.
+ *  Unlike Coverage, no per-TB data is kept.
+ */
+class StreamingCoverage
+{
+public:
+    typedef std::map<std::string, CoverageBitmap*> Bitmaps;
+
+private:
+    LogEvents *m_events;
+    ModuleCache *m_cache;
+    BasicBlockListCache *m_lists;
+
+    sigc::connection m_connection;
+
+    Bitmaps m_bitmaps;
+    uint64_t m_forkedPaths;
+    uint64_t m_unknownModuleCount;
+    std::set<std::string> m_notFoundModules;
+
+    //Last module hit, consecutive TBs usually belong to the same module
+    const ModuleInstance *m_lastInstance;
+    CoverageBitmap *m_lastBitmap;
+
+    void onItem(unsigned traceIndex,
+                const s2e::plugins::ExecutionTraceItemHeader &hdr,
+                void *item);
+
+public:
+    StreamingCoverage(BasicBlockListCache *lists, ModuleCache *cache, LogEvents *events);
+    StreamingCoverage(BasicBlockListCache *lists);
+    ~StreamingCoverage();
+
+    CoverageBitmap *getBitmap(const std::string &moduleName);
+
+    //Adds the coverage of other to this one, other is left unchanged
+    void merge(const StreamingCoverage &other);
+
+    const Bitmaps &getBitmaps() const {
+        return m_bitmaps;
+    }
+
+    //Number of paths created by forks, excluding the initial one
+    uint64_t getForkedPaths() const {
+        return m_forkedPaths;
+    }
+
+    uint64_t getUnknownModuleCount() const {
+        return m_unknownModuleCount;
+    }
+
+    const std::set<std::string> &getNotFoundModules() const {
+        return m_notFoundModules;
+    }
+};
+
+}
+
+#endif
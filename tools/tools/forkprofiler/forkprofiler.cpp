@@ -103,8 +103,6 @@ void ForkProfiler::doProfile(
     fp.count = 1;
     fp.line = 0;
 
-    m_library->getInfo(mi, te->pc, fp.file, fp.line, fp.function);
-
     ForkPoints::iterator it = m_forkPoints.find(fp);
     if (it == m_forkPoints.end()) {
         if (mi) {
@@ -167,6 +165,52 @@ void ForkProfiler::onItem(unsigned traceIndex,
 
 }
 
+//Looks up the debug information of all fork points at once,
+//one batch per module instance
+void ForkProfiler::resolveDebugInfo()
+{
+    typedef std::pair<std::string, std::pair<uint64_t, uint64_t> > ModuleKey;
+    typedef std::map<ModuleKey, std::vector<unsigned> > ModuleForkPoints;
+
+    std::vector<ForkPoint> forkPoints(m_forkPoints.begin(), m_forkPoints.end());
+    ModuleForkPoints byModule;
+
+    for (unsigned i = 0; i < forkPoints.size(); ++i) {
+        const ForkPoint &fp = forkPoints[i];
+        if (fp.module.size() == 0) {
+            continue;
+        }
+        ModuleKey key(fp.module, std::make_pair(fp.loadbase, fp.imagebase));
+        byModule[key].push_back(i);
+    }
+
+    ModuleForkPoints::iterator it;
+    for (it = byModule.begin(); it != byModule.end(); ++it) {
+        const ModuleKey &key = (*it).first;
+        const std::vector<unsigned> &indices = (*it).second;
+
+        AddressInfoList infos;
+        for (unsigned i = 0; i < indices.size(); ++i) {
+            infos.push_back(AddressInfo(forkPoints[indices[i]].pc));
+        }
+
+        m_library->getInfo(key.first, key.second.first, key.second.second, infos);
+
+        for (unsigned i = 0; i < indices.size(); ++i) {
+            if (!infos[i].found) {
+                continue;
+            }
+            ForkPoint &fp = forkPoints[indices[i]];
+            fp.file = infos[i].source;
+            fp.line = infos[i].line;
+            fp.function = infos[i].function;
+        }
+    }
+
+    m_forkPoints.clear();
+    m_forkPoints.insert(forkPoints.begin(), forkPoints.end());
+}
+
 static std::string getColor(unsigned val, unsigned maxval)
 {
     uint32_t index = val * 10 / maxval;
@@ -291,6 +335,7 @@ int main(int argc, char **argv)
     ForkProfiler fp(&library, &mc, &pb);
 
     pb.processTree();
+    fp.resolveDebugInfo();
 
     fp.outputProfile(LogDir);
     fp.outputGraph(LogDir);
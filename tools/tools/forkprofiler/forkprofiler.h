@@ -116,6 +116,7 @@ public:
     virtual ~ForkProfiler();
 
     void process();
+    void resolveDebugInfo();
 
     void outputProfile(const std::string &path) const;
     void outputGraph(const std::string &path) const;
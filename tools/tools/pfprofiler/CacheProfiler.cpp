@@ -333,18 +333,54 @@ void TopMissesPerModule::printAggregatedStatistics(std::ostream &os) const
 
 void TopMissesPerModule::print(std::ostream &os)
 {
-    TopMissesPerModuleSet::const_reverse_iterator sit;
-    os << std::setw(15) << std::left << "Module" << std::setw(10) << " PC" <<
-            std::setw(6) << "       ReadMissCount" <<
-            std::setw(6) << " WriteMissCount" <<
-            std::endl;
+    typedef std::pair<std::string, std::pair<uint64_t, uint64_t> > ModuleKey;
+    typedef std::map<ModuleKey, std::vector<unsigned> > ModuleRows;
+
+    //Collect the printed rows first to look up their debug information
+    //in one batch per module instance
+    std::vector<const InstructionCacheStatistics*> rows;
+    ModuleRows byModule;
 
+    TopMissesPerModuleSet::const_reverse_iterator sit;
     for (sit = m_stats.rbegin(); sit != m_stats.rend(); ++sit) {
         const InstructionCacheStatistics &s = (*sit);
         if (s.stats.readMissCount + s.stats.writeMissCount < m_minCacheMissThreshold) {
             continue;
         }
 
+        if (s.instr.m) {
+            ModuleKey key(s.instr.m->Name, std::make_pair(s.instr.loadBase, s.instr.m->ImageBase));
+            byModule[key].push_back(rows.size());
+        }
+        rows.push_back(&s);
+    }
+
+    AddressInfoList infos(rows.size());
+    ModuleRows::iterator mit;
+    for (mit = byModule.begin(); mit != byModule.end(); ++mit) {
+        const ModuleKey &key = (*mit).first;
+        const std::vector<unsigned> &indices = (*mit).second;
+
+        AddressInfoList moduleInfos;
+        for (unsigned i = 0; i < indices.size(); ++i) {
+            moduleInfos.push_back(AddressInfo(rows[indices[i]]->instr.pc));
+        }
+
+        m_library->getInfo(key.first, key.second.first, key.second.second, moduleInfos);
+
+        for (unsigned i = 0; i < indices.size(); ++i) {
+            infos[indices[i]] = moduleInfos[i];
+        }
+    }
+
+    os << std::setw(15) << std::left << "Module" << std::setw(10) << " PC" <<
+            std::setw(6) << "       ReadMissCount" <<
+            std::setw(6) << " WriteMissCount" <<
+            std::endl;
+
+    for (unsigned i = 0; i < rows.size(); ++i) {
+        const InstructionCacheStatistics &s = *rows[i];
+
         std::string modName = s.instr.m ? s.instr.m->Name : "<unknown>";
         os << std::setw(15) << modName << std::hex
                 << " 0x" << std::setw(8) << s.instr.pc << " - ";
@@ -355,13 +391,10 @@ void TopMissesPerModule::print(std::ostream &os)
         os << std::dec  << std::setw(13)<< s.stats.readMissCount
                  << " " << std::setw(14)<< s.stats.writeMissCount;
 
-        if (s.instr.m) {
-            std::string dbg;
-            if (m_library->print(modName, s.instr.loadBase, s.instr.m->ImageBase,
-                                 s.instr.pc, dbg, true, true, true)) {
-                os << " - " << dbg;
-            }
-    }
+        if (infos[i].found) {
+            os << " - " << infos[i].source << ":" << infos[i].line
+               << " - " << infos[i].function;
+        }
         os << std::endl;
     }
 
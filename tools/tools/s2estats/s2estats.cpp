@@ -0,0 +1,261 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+/**
+ *  Prints live statistics of a running (possibly multi-process) S2E session.
+ *  The tool only reads the shared statistics segment that S2E maps in its
+ *  output directory, it never interferes with the running processes.
+ */
+
+#define __STDC_FORMAT_MACROS 1
+
+#include "llvm/Support/CommandLine.h"
+
+#include <s2e/S2ESharedStats.h>
+
+#include <stdio.h>
+#include <iostream>
+#include <iomanip>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace llvm;
+using namespace s2e;
+
+namespace {
+
+cl::opt<std::string>
+    SharedStatsFile("statsfile", cl::desc("Shared statistics file of the S2E session"),
+                    cl::init("s2e-last/" S2E_SHARED_STATS_FILE));
+
+cl::opt<unsigned>
+    Interval("interval", cl::desc("Refresh interval in seconds"), cl::init(2));
+
+cl::opt<unsigned>
+    Count("count", cl::desc("Number of refreshes (0 for infinite)"), cl::init(0));
+
+cl::opt<bool>
+    PerProcess("per-process", cl::desc("Print the rates of each process"), cl::init(false));
+
+cl::opt<unsigned>
+    StaleAfter("stale-after", cl::desc("Ignore processes that did not update their statistics "
+                                       "for this many seconds (0 to disable)"), cl::init(60));
+
+}
+
+namespace s2etools
+{
+
+struct ProcessRates {
+    double tbs, instructions, queries, solverLoad;
+
+    ProcessRates() {
+        tbs = instructions = queries = solverLoad = 0;
+    }
+};
+
+class SharedStatsReader {
+private:
+    const S2ESharedStats *m_stats;
+    S2ESharedStatsSlot m_previous[S2E_MAX_PROCESSES];
+    ProcessRates m_rates[S2E_MAX_PROCESSES];
+
+    static bool sameProcess(const S2ESharedStatsSlot &a, const S2ESharedStatsSlot &b) {
+        return a.pid == b.pid && a.processIndex == b.processIndex;
+    }
+
+    static double rate(uint64_t cur, uint64_t prev, double seconds) {
+        return cur >= prev ? (cur - prev) / seconds : 0;
+    }
+
+    static bool isAlive(const S2ESharedStatsSlot &slot, uint64_t now);
+
+public:
+    SharedStatsReader(const S2ESharedStats *stats) {
+        m_stats = stats;
+        memset(m_previous, 0, sizeof(m_previous));
+    }
+
+    void refresh(std::ostream &os);
+};
+
+/**
+ *  Processes that crash or are killed leave their slot active until
+ *  another S2E process notices it.
+ */
+bool SharedStatsReader::isAlive(const S2ESharedStatsSlot &slot, uint64_t now)
+{
+    if (kill(slot.pid, 0) < 0 && errno == ESRCH) {
+        return false;
+    }
+
+    if (StaleAfter && slot.updateTime + StaleAfter * 1000000ULL < now) {
+        return false;
+    }
+
+    return true;
+}
+
+void SharedStatsReader::refresh(std::ostream &os)
+{
+    unsigned processes = 0;
+    uint64_t states = 0, memory = 0;
+    ProcessRates total;
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    uint64_t nowUs = tv.tv_sec * 1000000ULL + tv.tv_usec;
+
+    for (unsigned i = 0; i < S2E_MAX_PROCESSES; ++i) {
+        S2ESharedStatsSlot cur;
+        if (!s2e_shared_stats_read(&m_stats->slots[i], &cur)) {
+            cur.active = 0;
+        }
+
+        if (cur.active && !isAlive(cur, nowUs)) {
+            cur.active = 0;
+        }
+
+        if (!cur.active) {
+            m_previous[i] = cur;
+            m_rates[i] = ProcessRates();
+            continue;
+        }
+
+        const S2ESharedStatsSlot &prev = m_previous[i];
+
+        //Rates only change when the process published new counters.
+        //Forked processes inherit the counters of their parent, so
+        //the first sample of a new process only serves as a baseline.
+        if (!prev.active || !sameProcess(prev, cur)) {
+            m_rates[i] = ProcessRates();
+            m_previous[i] = cur;
+        } else if (cur.updateTime > prev.updateTime) {
+            double seconds = (cur.updateTime - prev.updateTime) / 1000000.;
+            ProcessRates &r = m_rates[i];
+            r.tbs = rate(cur.translationBlocks, prev.translationBlocks, seconds);
+            r.instructions = rate(cur.cpuInstructions, prev.cpuInstructions, seconds);
+            r.queries = rate(cur.queries, prev.queries, seconds);
+            r.solverLoad = rate(cur.solverTime, prev.solverTime, seconds) / 1000000.;
+            m_previous[i] = cur;
+        }
+
+        const ProcessRates &r = m_rates[i];
+        ++processes;
+        states += cur.statesCount;
+        memory += cur.memoryUsage;
+        total.tbs += r.tbs;
+        total.instructions += r.instructions;
+        total.queries += r.queries;
+        total.solverLoad += r.solverLoad;
+
+        if (PerProcess) {
+            os << "  [" << std::setw(3) << cur.processIndex << "] pid=" << cur.pid
+               << " states=" << cur.statesCount
+               << " TBs/s=" << (uint64_t) r.tbs
+               << " instr/s=" << (uint64_t) r.instructions
+               << " queries/s=" << std::setprecision(3) << r.queries
+               << " solver=" << (unsigned) (r.solverLoad * 100) << "%"
+               << " mem=" << (cur.memoryUsage >> 20) << "MB\n";
+        }
+    }
+
+    time_t now = time(NULL);
+    os << "[" << (uint64_t) (now - m_stats->startTime) << "s]"
+       << " processes=" << processes
+       << " states=" << states
+       << " TBs/s=" << (uint64_t) total.tbs
+       << " instr/s=" << (uint64_t) total.instructions
+       << " queries/s=" << std::setprecision(3) << total.queries
+       << " solver=" << (unsigned) (processes ? total.solverLoad * 100 / processes : 0) << "%"
+       << " mem=" << (memory >> 20) << "MB\n";
+    os.flush();
+}
+
+}
+
+using namespace s2etools;
+
+int main(int argc, char **argv)
+{
+    cl::ParseCommandLineOptions(argc, (char**) argv, " s2estats");
+
+    int fd = open(SharedStatsFile.c_str(), O_RDONLY);
+    if (fd < 0) {
+        perror(SharedStatsFile.c_str());
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(S2ESharedStats)) {
+        std::cerr << SharedStatsFile << " is not a valid statistics file\n";
+        return -1;
+    }
+
+    void *buffer = mmap(NULL, sizeof(S2ESharedStats), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (buffer == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    const S2ESharedStats *stats = static_cast<const S2ESharedStats*>(buffer);
+    if (stats->magic != S2E_SHARED_STATS_MAGIC || stats->version != S2E_SHARED_STATS_VERSION ||
+        stats->slotCount != S2E_MAX_PROCESSES) {
+        std::cerr << SharedStatsFile << " was written by an incompatible version of S2E\n";
+        return -1;
+    }
+
+    SharedStatsReader reader(stats);
+    reader.refresh(std::cout);
+
+    for (unsigned i = 1; !Count || i < Count; ++i) {
+        sleep(Interval);
+        reader.refresh(std::cout);
+    }
+
+    munmap(buffer, sizeof(S2ESharedStats));
+    return 0;
+}
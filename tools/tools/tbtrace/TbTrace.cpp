@@ -116,6 +116,65 @@ TbTrace::TbTrace(Library *lib, ModuleCache *cache, LogEvents *events, std::ofstr
 TbTrace::~TbTrace()
 {
     m_connection.disconnect();
+    flush();
+}
+
+//Writes the buffered trace, looking up the debug information of
+//all its program counters in one batch per module instance
+void TbTrace::flush()
+{
+    typedef std::pair<std::string, std::pair<uint64_t, uint64_t> > ModuleKey;
+    typedef std::map<ModuleKey, std::vector<unsigned> > ModulePcs;
+
+    ModulePcs byModule;
+    for (unsigned i = 0; i < m_pendingDebugInfo.size(); ++i) {
+        const PendingDebugInfo &p = m_pendingDebugInfo[i];
+        ModuleKey key(p.module, std::make_pair(p.loadBase, p.imageBase));
+        byModule[key].push_back(i);
+    }
+
+    AddressInfoList infos(m_pendingDebugInfo.size());
+    ModulePcs::iterator it;
+    for (it = byModule.begin(); it != byModule.end(); ++it) {
+        const ModuleKey &key = (*it).first;
+        const std::vector<unsigned> &indices = (*it).second;
+
+        AddressInfoList moduleInfos;
+        for (unsigned i = 0; i < indices.size(); ++i) {
+            moduleInfos.push_back(AddressInfo(m_pendingDebugInfo[indices[i]].pc));
+        }
+
+        m_library->getInfo(key.first, key.second.first, key.second.second, moduleInfos);
+
+        for (unsigned i = 0; i < indices.size(); ++i) {
+            infos[indices[i]] = moduleInfos[i];
+        }
+    }
+
+    std::string text = m_pending.str();
+    size_t pos = 0;
+    for (unsigned i = 0; i < m_pendingDebugInfo.size(); ++i) {
+        size_t offset = m_pendingDebugInfo[i].offset;
+        m_output.write(text.data() + pos, offset - pos);
+        pos = offset;
+
+        if (!infos[i].found) {
+            continue;
+        }
+
+        std::string file = infos[i].source;
+        size_t slash = file.find_last_of('/');
+        if (slash != std::string::npos) {
+            file = file.substr(slash+1);
+        }
+
+        m_output << " " << file << ":" << std::dec << infos[i].line << " in " << infos[i].function;
+        m_hasDebugInfo = true;
+    }
+    m_output.write(text.data() + pos, text.size() - pos);
+
+    m_pending.str("");
+    m_pendingDebugInfo.clear();
 }
 
 bool TbTrace::parseDisassembly(const std::string &listingFile, Disassembly &out)
@@ -210,7 +269,7 @@ void TbTrace::printDisassembly(const std::string &module, uint64_t relPc, unsign
         BasicBlock bbToFetch(relPc, 1);
         TbTraceBbs::iterator mybb = (*bbit).second.find(bbToFetch);
         if (mybb == (*bbit).second.end()) {
-            m_output << "Could not find basic block 0x" << std::hex << relPc << " in the list" << std::endl;
+            m_pending << "Could not find basic block 0x" << std::hex << relPc << " in the list" << std::endl;
             return;
         }
 
@@ -242,7 +301,7 @@ void TbTrace::printDisassembly(const std::string &module, uint64_t relPc, unsign
             //Print the vector we've got
             for(DisassemblyEntry::const_iterator asmIt = (*it).second.begin();
                 asmIt != (*it).second.end(); ++asmIt) {
-                m_output << "\033[1;33m" << *asmIt << "\033[0m" << std::endl;
+                m_pending << "\033[1;33m" << *asmIt << "\033[0m" << std::endl;
             }
         }
 
@@ -264,28 +323,25 @@ void TbTrace::printDebugInfo(uint64_t pid, uint64_t pc, unsigned tbSize, bool pr
         return;
     }
     uint64_t relPc = pc - mi->LoadBase + mi->ImageBase;
-    m_output << std::hex << "(" << mi->Name;
+    m_pending << std::hex << "(" << mi->Name;
     if (relPc != pc) {
-       m_output << " 0x" << relPc;
+       m_pending << " 0x" << relPc;
     }
-    m_output << ")";
+    m_pending << ")";
 
     m_hasModuleInfo = true;
 
-    std::string file = "?", function="?";
-    uint64_t line=0;
-    if (m_library->getInfo(mi, pc, file, line, function)) {
-        size_t pos = file.find_last_of('/');
-	if (pos != std::string::npos) {
-            file = file.substr(pos+1);
-        }
-
-        m_output << " " << file << std::dec << ":" << line << " in " << function;
-        m_hasDebugInfo = true;
-    }
+    //The debug information is looked up and inserted here by flush()
+    PendingDebugInfo info;
+    info.offset = m_pending.tellp();
+    info.module = mi->Name;
+    info.loadBase = mi->LoadBase;
+    info.imageBase = mi->ImageBase;
+    info.pc = pc;
+    m_pendingDebugInfo.push_back(info);
 
     if (PrintDisassembly && printListing) {
-        m_output << std::endl;
+        m_pending << std::endl;
         printDisassembly(mi->Name, relPc, tbSize);
     }
 }
@@ -295,9 +351,9 @@ void TbTrace::printRegisters(const s2e::plugins::ExecutionTraceTb *te)
     const char *regs[] = {"EAX", "ECX", "EDX", "EBX", "ESP", "EBP", "ESI", "EDI"};
     for (unsigned i=0; i<8; ++i) {
         if (te->symbMask & (1<<i)) {
-            m_output << regs[i] << ": SYMBOLIC ";
+            m_pending << regs[i] << ": SYMBOLIC ";
         }else {
-            m_output << regs[i] << ": 0x" << std::hex << te->registers[i] << " ";
+            m_pending << regs[i] << ": 0x" << std::hex << te->registers[i] << " ";
         }
     }
 }
@@ -314,34 +370,34 @@ void TbTrace::printMemoryChecker(const s2e::plugins::ExecutionTraceMemChecker::S
         return;
     }
 
-    m_output << "\033[1;31mMEMCHECKER\033[0m";
+    m_pending << "\033[1;31mMEMCHECKER\033[0m";
 
     std::string nameHighlightCode;
 
     if (deserializedItem.flags & ExecutionTraceMemChecker::REVOKE) {
         nameHighlightCode = "\033[1;31m";
-        m_output << nameHighlightCode << " REVOKE ";
+        m_pending << nameHighlightCode << " REVOKE ";
 
     }
 
     if (deserializedItem.flags & ExecutionTraceMemChecker::GRANT) {
         nameHighlightCode = "\033[1;32m";
-        m_output << nameHighlightCode << " GRANT  ";
+        m_pending << nameHighlightCode << " GRANT  ";
     }
 
     if (deserializedItem.flags & ExecutionTraceMemChecker::READ) {
-        m_output << " READ   ";
+        m_pending << " READ   ";
     }
 
     if (deserializedItem.flags & ExecutionTraceMemChecker::WRITE) {
-        m_output << " WRITE  ";
+        m_pending << " WRITE  ";
     }
 
 
 
-    m_output << nameHighlightCode << deserializedItem.name << "\033[0m";
+    m_pending << nameHighlightCode << deserializedItem.name << "\033[0m";
 
-    m_output << " address=0x" << std::hex << deserializedItem.start
+    m_pending << " address=0x" << std::hex << deserializedItem.start
              << " size=0x" << deserializedItem.size << std::endl;
 }
 
@@ -349,48 +405,53 @@ void TbTrace::onItem(unsigned traceIndex,
             const s2e::plugins::ExecutionTraceItemHeader &hdr,
             void *item)
 {
-    //m_output << "Trace index " << std::dec << traceIndex << std::endl;
+    if (m_pendingDebugInfo.size() >= MaxPendingDebugInfo ||
+        (size_t) m_pending.tellp() >= MaxPendingBytes) {
+        flush();
+    }
+
+    //m_pending << "Trace index " << std::dec << traceIndex << std::endl;
     if (hdr.type == s2e::plugins::TRACE_MOD_LOAD) {
         const s2e::plugins::ExecutionTraceModuleLoad &load = *(s2e::plugins::ExecutionTraceModuleLoad*)item;
-        m_output << "Loaded module " << load.name
+        m_pending << "Loaded module " << load.name
                  << " at 0x" << std::hex << load.loadBase;
-        m_output << std::endl;
+        m_pending << std::endl;
         return;
     }
 
     if (hdr.type == s2e::plugins::TRACE_MOD_UNLOAD) {
         const s2e::plugins::ExecutionTraceModuleUnload &unload = *(s2e::plugins::ExecutionTraceModuleUnload*)item;
-        m_output << "Unloaded module at 0x" << unload.loadBase;
-        m_output << std::endl;
+        m_pending << "Unloaded module at 0x" << std::hex << unload.loadBase;
+        m_pending << std::endl;
         return;
     }
 
     if (hdr.type == s2e::plugins::TRACE_PAGEFAULT) {
         const s2e::plugins::ExecutionTracePageFault &fault = *(s2e::plugins::ExecutionTracePageFault*)item;
-        m_output << "PF @" << std::hex << fault.pc << " addr=" <<  fault.address << " isWrite=" << (int) fault.isWrite;
-        m_output << std::endl;
+        m_pending << "PF @" << std::hex << fault.pc << " addr=" <<  fault.address << " isWrite=" << (int) fault.isWrite;
+        m_pending << std::endl;
         return;
     }
 
     if (hdr.type == s2e::plugins::TRACE_EXCEPTION) {
         const s2e::plugins::ExecutionTraceException &fault = *(s2e::plugins::ExecutionTraceException*)item;
-        m_output << "EXCP @" << std::hex << fault.pc << " vec=" <<  fault.vector;
-        m_output << std::endl;
+        m_pending << "EXCP @" << std::hex << fault.pc << " vec=" <<  fault.vector;
+        m_pending << std::endl;
         return;
     }
 
     if (hdr.type == s2e::plugins::TRACE_STATE_SWITCH) {
         const s2e::plugins::ExecutionTraceStateSwitch &s = *(s2e::plugins::ExecutionTraceStateSwitch*)item;
-        m_output << "State switch " << hdr.stateId << " => " << s.newStateId;
-        m_output << std::endl;
+        m_pending << "State switch " << std::dec << hdr.stateId << " => " << s.newStateId;
+        m_pending << std::endl;
         return;
     }
 
     if (hdr.type == s2e::plugins::TRACE_FORK) {
         s2e::plugins::ExecutionTraceFork *f = (s2e::plugins::ExecutionTraceFork*)item;
-        m_output << "Forked at 0x" << std::hex << f->pc << " - ";
+        m_pending << "Forked at 0x" << std::hex << f->pc << " - ";
         printDebugInfo(hdr.pid, f->pc, 0, false);
-        m_output << std::endl;
+        m_pending << std::endl;
         return;
     }
 
@@ -398,17 +459,17 @@ void TbTrace::onItem(unsigned traceIndex,
         const s2e::plugins::ExecutionTraceTb *te =
                 (const s2e::plugins::ExecutionTraceTb*) item;
 
-        m_output << "0x" << std::hex << te->pc<< " - ";
+        m_pending << "0x" << std::hex << te->pc<< " - ";
 
         if (PrintRegisters) {
-            m_output << std::endl << "    ";
+            m_pending << std::endl << "    ";
             printRegisters(te);
-            m_output << std::endl << "    ";
+            m_pending << std::endl << "    ";
         }
 
         printDebugInfo(hdr.pid, te->pc, te->size, true);
 
-        m_output << std::endl;
+        m_pending << std::endl;
         m_hasItems = true;
         return;
     }
@@ -422,22 +483,22 @@ void TbTrace::onItem(unsigned traceIndex,
         type += te->flags & EXECTRACE_MEM_SYMBADDR ? "A" : "-";
         type += te->flags & EXECTRACE_MEM_SYMBVAL ? "S" : "-";
         type += te->flags & EXECTRACE_MEM_WRITE   ? "W" : "R";
-        m_output << "S=" << std::dec << hdr.stateId << " P=0x" << std::hex << hdr.pid << " PC=0x" << std::hex << te->pc << " " << type << (int)te->size << "[0x"
+        m_pending << "S=" << std::dec << hdr.stateId << " P=0x" << std::hex << hdr.pid << " PC=0x" << std::hex << te->pc << " " << type << (int)te->size << "[0x"
                 << std::hex << te->address << "]=0x" << std::setw(10) << std::setfill('0') << te->value;
 
         if (te->flags & EXECTRACE_MEM_HASHOSTADDR) {
-           m_output << " hostAddr=0x" << te->hostAddress << " ";
+           m_pending << " hostAddr=0x" << te->hostAddress << " ";
         }
 
         if (te->flags & EXECTRACE_MEM_OBJECTSTATE) {
-           m_output << " cb=0x" << te->concreteBuffer << " ";
+           m_pending << " cb=0x" << te->concreteBuffer << " ";
         }
 
-        m_output << "\t";
+        m_pending << "\t";
 
         printDebugInfo(hdr.pid, te->pc, 0, false);
-        m_output << std::setfill(' ');
-        m_output << std::endl;
+        m_pending << std::setfill(' ');
+        m_pending << std::endl;
        return;
     }
 
@@ -500,6 +561,7 @@ void TbTraceTool::flatTrace()
             continue;
         }
 
+        trace.flush();
         traceFile << "----------------------" << std::endl;
 
         if (trace.hasDebugInfo() == false) {
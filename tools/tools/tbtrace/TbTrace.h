@@ -41,6 +41,8 @@
 
 #include <ostream>
 #include <fstream>
+#include <sstream>
+#include <vector>
 
 #include <lib/BinaryReaders/Library.h>
 #include <lib/Utils/BasicBlockListParser.h>
@@ -66,6 +68,18 @@ public:
     typedef std::map<std::string, TbTraceBbs> ModuleBasicBlocks;
 
 private:
+    //Position in the buffered trace where the debug information
+    //of the given program counter goes
+    struct PendingDebugInfo {
+        size_t offset;
+        std::string module;
+        uint64_t loadBase, imageBase;
+        uint64_t pc;
+    };
+
+    static const unsigned MaxPendingDebugInfo = 4096;
+    static const size_t MaxPendingBytes = 1024 * 1024;
+
     LogEvents *m_events;
     ModuleCache *m_cache;
     Library *m_library;
@@ -73,6 +87,9 @@ private:
     ModuleBasicBlocks m_basicBlocks;
     std::ofstream &m_output;
 
+    std::ostringstream m_pending;
+    std::vector<PendingDebugInfo> m_pendingDebugInfo;
+
     sigc::connection m_connection;
 
     bool m_hasItems;
@@ -94,6 +111,10 @@ public:
     virtual ~TbTrace();
 
     void outputTraces(const std::string &Path) const;
+
+    //Writes the buffered trace to the output file
+    void flush();
+
     bool hasItems() const {
         return m_hasItems;
     }
@@ -0,0 +1,144 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include "gtest/gtest.h"
+
+#include <lib/BinaryReaders/SymbolTable.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+
+using namespace s2etools;
+
+namespace {
+
+void addRange(SymbolTable &table, uint64_t start, unsigned size,
+              const std::string &source, uint64_t line, const std::string &function)
+{
+    for (unsigned i = 0; i < size; ++i) {
+        table.add(start + i, source, line, function);
+    }
+}
+
+//Two blocks, added out of order with a finalize() in between
+void buildTable(SymbolTable &table)
+{
+    addRange(table, 0x2000, 0x10, "b.c", 20, "g");
+    addRange(table, 0x2010, 0x08, "b.c", 21, "g");
+    table.finalize();
+
+    addRange(table, 0x1000, 0x20, "a.c", 10, "f");
+    addRange(table, 0x1030, 0x10, "a.c", 12, "f");
+    table.finalize();
+}
+
+void checkTable(const SymbolTable &table)
+{
+    std::string source, function;
+    uint64_t line;
+
+    ASSERT_EQ(4U, table.getEntries().size());
+
+    EXPECT_TRUE(table.lookup(0x1000, source, line, function));
+    EXPECT_EQ("a.c", source);
+    EXPECT_EQ(10U, line);
+    EXPECT_EQ("f", function);
+
+    EXPECT_TRUE(table.lookup(0x103f, source, line, function));
+    EXPECT_EQ(12U, line);
+
+    EXPECT_FALSE(table.lookup(0x1020, source, line, function));
+    EXPECT_FALSE(table.lookup(0x0fff, source, line, function));
+    EXPECT_FALSE(table.lookup(0x2018, source, line, function));
+
+    EXPECT_TRUE(table.lookup(0x2017, source, line, function));
+    EXPECT_EQ("b.c", source);
+    EXPECT_EQ(21U, line);
+    EXPECT_EQ("g", function);
+
+    AddressInfoList infos;
+    infos.push_back(AddressInfo(0x2005));
+    infos.push_back(AddressInfo(0x1025));
+    infos.push_back(AddressInfo(0x1005));
+    EXPECT_EQ(2U, table.lookup(infos));
+    EXPECT_TRUE(infos[0].found);
+    EXPECT_EQ(20U, infos[0].line);
+    EXPECT_FALSE(infos[1].found);
+    EXPECT_TRUE(infos[2].found);
+    EXPECT_EQ("a.c", infos[2].source);
+}
+
+TEST(SymbolTableTest, Lookup) {
+    SymbolTable table;
+    buildTable(table);
+    checkTable(table);
+}
+
+TEST(SymbolTableTest, SaveLoad) {
+    char dir[] = "/tmp/symtabXXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    std::string module = std::string(dir) + "/module";
+    std::string cache = module + ".symtab";
+
+    {
+        std::ofstream os(module.c_str());
+        os << "module";
+    }
+
+    SymbolTable table;
+    buildTable(table);
+    ASSERT_TRUE(table.save(cache, module));
+
+    SymbolTable loaded;
+    ASSERT_TRUE(loaded.load(cache, module));
+    checkTable(loaded);
+
+    //Tables of modules that changed since are not used
+    {
+        std::ofstream os(module.c_str(), std::ios::app);
+        os << "changed";
+    }
+    SymbolTable stale;
+    EXPECT_FALSE(stale.load(cache, module));
+    EXPECT_TRUE(stale.empty());
+
+    unlink(cache.c_str());
+    unlink(module.c_str());
+    rmdir(dir);
+}
+
+}